@@ -0,0 +1,37 @@
+executable=$1
+bc_dir=$2
+benchmarks_bin_dir=$3
+shift 3
+extra_options="$@"
+
+echo "[INFO] ----------------------------------------------------"
+echo "[INFO] Scaling begins (spec2006)"
+echo "[INFO] ----------------------------------------------------"
+
+for bc in $bc_dir/*.bc;
+do
+  proj=`basename $bc`
+  for nworkers in 0 1 2 4 8;
+  do
+    printf "Running %20s with %2s workers" "$proj" "$nworkers"
+
+    log=$benchmarks_bin_dir/$proj.nworkers$nworkers.log
+    start_time=$(date +%s)
+    $executable $bc -dyckaa-parallel-intra -dyckaa-parallel-unification -nworkers=$nworkers $extra_options >$log 2>$benchmarks_bin_dir/$proj.nworkers$nworkers.err
+    ret=$?
+    end_time=$(date +%s)
+    elapsed=$((end_time - start_time))
+    printf "\t takes %5s seconds. " "$elapsed"
+
+    if [ $ret -ne 0 ]; then
+      printf "\tFail!\n"
+    else
+      printf "\tPass!\n"
+    fi
+    grep -E "(intra-procedural analysis|Generating constraints|Merging constraints|Unifying vertices|Running DyckAA|Running DyckMRA|Building local VFGs|Running DyckVFA) takes" $log | sed 's/^/\t/'
+  done
+done
+
+echo "[INFO] ----------------------------------------------------"
+echo "[INFO] Scaling completes (spec2006)"
+echo "[INFO] ----------------------------------------------------"
@@ -20,6 +20,7 @@
 #define DYCKAA_DYCKALIASANALYSIS_H
 
 #include <llvm/Pass.h>
+#include <llvm/ADT/ArrayRef.h>
 #include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/ADT/SmallVector.h>
 #include <llvm/Support/ErrorHandling.h>
@@ -53,10 +54,13 @@ public:
     /// get alias set of a pointer \p Ptr
     const std::set<Value *> *getAliasSet(Value *Ptr) const;
 
-    /// return true if \p V1 is an alias of \p V2
+    /// return true if \p V1 is an alias of \p V2, it is thread-safe
     bool mayAlias(Value *V1, Value *V2) const;
 
-    /// return true if \p V is an alias of nullptr
+    /// append the results of mayAlias for each pair in \p Queries to \p Results, it is thread-safe
+    void mayAliasBatch(ArrayRef<std::pair<Value *, Value *>> Queries, SmallVectorImpl<bool> &Results) const;
+
+    /// return true if \p V is an alias of nullptr, it is thread-safe
     bool mayNull(Value *V) const;
 
     /// get the call graph based on dyck-aa
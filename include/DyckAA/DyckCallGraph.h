@@ -41,6 +41,7 @@
 
 #include "DyckAA/DyckCallGraphNode.h"
 #include "Support/MapIterators.h"
+#include "Support/ObjectArena.h"
 
 using namespace llvm;
 
@@ -48,6 +49,13 @@ typedef std::map<Function *, DyckCallGraphNode *> FunctionMapTy;
 
 class DyckCallGraph {
 private:
+    /// the memory of the nodes and the calls, which are destroyed with the call graph
+    /// @{
+    ObjectArena<DyckCallGraphNode> NodeArena;
+    ObjectArena<CommonCall> CommonCallArena;
+    ObjectArena<PointerCall> PointerCallArena;
+    /// @}
+
     /// function -> call graph node
     FunctionMapTy FunctionMap;
 
@@ -78,6 +86,25 @@ public:
 
     DyckCallGraphNode *getFunction(Function *) const;
 
+    /// Create the node of a function when the call graph is restored from a saved one.
+    /// Unlike getOrInsertFunction, it does not add the edge from the external calling node,
+    /// because all the edges are restored as they were saved.
+    DyckCallGraphNode *restoreFunction(Function *);
+
+    /// Create a call owned by the call graph, which should then be added to its caller's node
+    /// @{
+    CommonCall *createCommonCall(Instruction *Inst, Function *Func, std::vector<Value *> *Args) {
+        return new(CommonCallArena.allocate()) CommonCall(Inst, Func, Args);
+    }
+
+    PointerCall *createPointerCall(Instruction *Inst, Value *CalledValue, std::vector<Value *> *Args) {
+        return new(PointerCallArena.allocate()) PointerCall(Inst, CalledValue, Args);
+    }
+    /// @}
+
+    /// Print the number and the memory of the nodes and the calls ever allocated
+    void printArenaStatistics(raw_ostream &O) const;
+
     void dotCallGraph(const std::string &ModuleIdentifier);
 
     void printFunctionPointersInformation(const std::string &ModuleIdentifier);
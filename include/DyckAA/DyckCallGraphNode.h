@@ -109,7 +109,8 @@ public:
 
     unsigned size() const { return MayAliasedCallees.size(); }
 
-    void addMayAliasedFunction(Function *F) { MayAliasedCallees.insert(F); }
+    /// Return false if \p F is already a callee
+    bool addMayAliasedFunction(Function *F) { return MayAliasedCallees.insert(F).second; }
 
 public:
     static bool classof(const Call *N) {
@@ -19,26 +19,74 @@
 #ifndef DYCKAA_DYCKHALFGRAPH_H
 #define DYCKAA_DYCKHALFGRAPH_H
 
+#include <map>
 #include <stack>
 #include <unordered_map>
+#include <vector>
 
 #include "DyckAA/DyckGraphNode.h"
+#include "Support/DisjointSet.h"
+#include "Support/MapIterators.h"
+#include "Support/ObjectArena.h"
 
 class DyckGraphEdgeLabel;
 
 /// This class models a dyck-cfl language as a graph, which does not contain the barred edges.
 /// See details in http://dl.acm.org/citation.cfm?id=2491956.2462159&coll=DL&dl=ACM&CFID=379446910&CFTOKEN=65130716 .
 class DyckGraph {
+    friend class DyckGraphNode;
+public:
+    /// Observes the changes of the equivalence classes, see setListener().
+    /// The callbacks must not modify the graph.
+    class Listener {
+    public:
+        virtual ~Listener() = default;
+
+        /// A vertex with the value \p Val is added as the class \p ClassIdx
+        virtual void valueAdded(void *Val, unsigned ClassIdx) = 0;
+
+        /// The class \p Absorbed is merged into the class \p Rep, which represents both of them afterwards
+        virtual void classesMerged(unsigned Rep, unsigned Absorbed) = 0;
+    };
+
 private:
-    std::set<DyckGraphNode *> Vertices;
+    /// the memory of the vertices, a vertex merged away is destroyed with the graph
+    ObjectArena<DyckGraphNode> NodeArena;
+
+    /// vertices indexed by their ids, a vertex merged away leaves a tombstone (nullptr) until compact()
+    std::vector<DyckGraphNode *> Vertices;
+
+    /// the number of tombstones in Vertices
+    unsigned NumTombstones = 0;
+
+    /// equivalence classes
+    /// @{
+    /// each vertex ever created owns an element, merging two vertices unions their elements
+    IndexedDisjointSet Classes;
+    /// the value of each element, null for the vertices created without values
+    std::vector<void *> ClassValues;
+    /// the vertex of each class, valid only for the representative elements
+    std::vector<DyckGraphNode *> ClassVertices;
+    /// value -> its element
+    std::unordered_map<void *, unsigned> ValClassMap;
+    /// @}
+
+    /// the observer of the equivalence classes, not owned
+    Listener *ClassListener = nullptr;
 
-    std::unordered_map<void *, DyckGraphNode *> ValVertexMap;
+    /// a read-only, open-addressing hash table from values to the indices of their vertices, see freeze()
+    /// @{
+    std::vector<std::pair<const void *, unsigned>> FrozenIndex;
+    size_t FrozenMask = 0;
+    /// @}
 
     /// edge labels
     /// @{
     DyckGraphEdgeLabel *DerefEdgeLabel;
     std::map<long, DyckGraphEdgeLabel *> OffsetEdgeLabelMap;
     std::map<long, DyckGraphEdgeLabel *> IndexEdgeLabelMap;
+    /// all the labels indexed by their ids
+    std::vector<DyckGraphEdgeLabel *> EdgeLabels;
     /// @}
 
 public:
@@ -53,8 +101,16 @@ public:
     /// Please use it after you call void qirunAlgorithm().
     unsigned int numEquivalentClasses();
 
-    /// Get the set of vertices in the graph.
-    std::set<DyckGraphNode *> &getVertices();
+    /// Get the vertices in the graph.
+    /// The graph is compacted first, so that there are no tombstones and the index of each vertex is its position.
+    const std::vector<DyckGraphNode *> &getVertices();
+
+    /// Get the vertex by its index, return null if it has been merged into another vertex.
+    DyckGraphNode *getVertex(unsigned Idx) const { return Vertices[Idx]; }
+
+    /// Remove the tombstones left by merging vertices, and renumber the vertices.
+    /// Indices of the vertices are changed, but their relative order is kept.
+    void compact();
 
     /// You are not recommended to use the function when the graph is big,
     /// because it is time-consuming.
@@ -69,8 +125,42 @@ public:
     /// If a new vertex is initialized, it will be added into the graph.
     std::pair<DyckGraphNode *, bool> retrieveDyckVertex(void *Val, const char *Name = nullptr);
 
+    /// Return the vertex of a value, or null if the value is not in the graph.
+    /// After freeze(), looking up a value indexed by freeze() is thread-safe.
     DyckGraphNode *findDyckVertex(void *Val);
 
+    /// Get the equivalence class of a vertex. Unlike the vertex, the class remains valid
+    /// after the vertex is merged into another one, see getClassVertex().
+    unsigned getClassIndex(DyckGraphNode *N) const { return N->ClassIdx; }
+
+    /// Get the vertex that currently represents the equivalence class
+    DyckGraphNode *getClassVertex(unsigned ClassIdx) { return ClassVertices[Classes.findSet(ClassIdx)]; }
+
+    /// Append the values in the equivalent set of \p N to \p Vals.
+    /// Unlike DyckGraphNode::getEquivalentSet(), the order of the values does not depend on their addresses.
+    void getEquivalentValues(DyckGraphNode *N, std::vector<void *> &Vals) const;
+
+    /// Create a vertex whose equivalent set consists of \p Vals, none of which may be in the graph.
+    /// It is used to restore a graph saved before, whose vertices are already unified.
+    DyckGraphNode *restoreVertex(const std::vector<void *> &Vals);
+
+    /// Compact the graph, and index the vertices of the values for getFrozenIndex().
+    /// Vertices must not be merged afterwards. Vertices created later are not indexed.
+    void freeze();
+
+    /// Return true if freeze() has been called
+    bool isFrozen() const { return !FrozenIndex.empty(); }
+
+    /// Return the index of the vertex of \p Val in the frozen graph, or UINT_MAX if the value was not in the graph
+    /// when it was frozen. Unlike findDyckVertex(), the lookup never writes anything, so it is thread-safe.
+    unsigned getFrozenIndex(const void *Val) const;
+
+    /// Set the observer of the equivalence classes, null to remove it
+    void setListener(Listener *L) { ClassListener = L; }
+
+    /// Get all the values in the graph
+    KeyRange<std::unordered_map<void *, unsigned>::const_iterator> getValues() const { return keys(ValClassMap); }
+
     /// Get reachable nodes
     /// @{
     void getReachableVertices(const std::set<DyckGraphNode *> &Sources, std::set<DyckGraphNode *> &Reachable);
@@ -93,10 +183,35 @@ public:
 
     DyckGraphEdgeLabel *getDereferenceEdgeLabel() const { return DerefEdgeLabel; }
 
+    /// Get the label by its id
+    DyckGraphEdgeLabel *getEdgeLabel(unsigned Idx) const { return EdgeLabels[Idx]; }
+
+    /// The number of edge labels
+    unsigned numEdgeLabels() const { return EdgeLabels.size(); }
+
+    /// Print the number and the memory of the vertices ever allocated
+    void printArenaStatistics(llvm::raw_ostream &O) const { NodeArena.print(O, "vertices"); }
+
 private:
-    void removeFromWorkList(std::multimap<DyckGraphNode *, void *> &, DyckGraphNode *, void *);
+    class WorkList;
+
+    DyckGraphEdgeLabel *addEdgeLabel(DyckGraphEdgeLabel *);
+
+    DyckGraphNode *addVertex(void *Val, const char *Name);
+
+    /// add non-null values of the equivalence class \p ClassIdx to \p Set
+    void collectEquivalentSet(unsigned ClassIdx, std::set<void *> &Set) const;
+
+    /// Merge \p Y into \p X, and then release the edges and the values of \p Y.
+    /// If \p WL is not null, it is updated with the (vertex, label) pairs that have more than one target.
+    void merge(DyckGraphNode *X, DyckGraphNode *Y, WorkList *WL);
+
+    /// Merge the equivalence class of \p Y into the one of \p X, and leave a tombstone for \p Y,
+    /// whose edges must have been detached.
+    void absorb(DyckGraphNode *X, DyckGraphNode *Y);
 
-    bool containsInWorkList(std::multimap<DyckGraphNode *, void *> &, DyckGraphNode *, void *);
+    /// The parallel version of qirunAlgorithm(), see -dyckaa-parallel-unification.
+    bool qirunAlgorithmInParallel();
 };
 
 #endif // DYCKAA_DYCKHALFGRAPH_H
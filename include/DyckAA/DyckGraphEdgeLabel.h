@@ -23,6 +23,7 @@
 #include <map>
 
 class DyckGraphEdgeLabel {
+    friend class DyckGraph;
 public:
     enum LabelType {
         LT_Dereference, LT_Offset, LT_Index
@@ -31,9 +32,14 @@ public:
 private:
     std::string Desc;
 
+    /// dense id assigned by the owner graph, used to key the adjacency lists of a DyckGraphNode
+    unsigned ID = 0;
+
 public:
     virtual std::string &getEdgeLabelDescription() { return Desc; }
 
+    unsigned getID() const { return ID; }
+
     virtual bool isLabelTy(LabelType type) { return false; }
 
     virtual ~DyckGraphEdgeLabel() = default;
@@ -19,96 +19,107 @@
 #ifndef DYCKAA_DYCKGRAPHNODE_H
 #define DYCKAA_DYCKGRAPHNODE_H
 
-#include <map>
+#include <llvm/ADT/SmallVector.h>
 #include <set>
 
 class DyckGraph;
+class DyckGraphEdgeLabel;
 
 class DyckGraphNode {
     friend class DyckGraph;
+public:
+    /// All the neighbours connected to a vertex by edges with the same label.
+    /// Labels and vertices are referred to by their dense ids in the owner graph,
+    /// see DyckGraph::getEdgeLabel(unsigned) and DyckGraph::getVertex(unsigned).
+    struct EdgeBucket {
+        unsigned Label;
+        /// sorted ids in out buckets, unordered ids in in buckets
+        llvm::SmallVector<unsigned, 1> Nodes;
+
+        explicit EdgeBucket(unsigned L) : Label(L) {}
+    };
+
+    /// buckets sorted by label id
+    typedef llvm::SmallVector<EdgeBucket, 1> EdgeBucketList;
+
 private:
-    static int GlobalNodeIndex;
-    int NodeIndex;
+    DyckGraph *Graph;
+    unsigned NodeIndex;
     const char *NodeName;
     bool ContainsNull = false;
 
-    std::set<void *> InLables;
-    std::set<void *> OutLables;
+    EdgeBucketList InEdges;
+    EdgeBucketList OutEdges;
+
+    /// number of edges in InEdges and OutEdges
+    /// @{
+    unsigned NumInEdges = 0;
+    unsigned NumOutEdges = 0;
+    /// @}
 
-    std::map<void *, std::set<DyckGraphNode *>> InNodes;
-    std::map<void *, std::set<DyckGraphNode *>> OutNodes;
+    /// the id of the equivalence class of this vertex in DyckGraph, i.e., the representative of a disjoint set
+    unsigned ClassIdx;
 
-    /// only store non-null value
+    /// non-null values in the equivalent set, materialised on demand by getEquivalentSet()
     std::set<void *> EquivClass;
+    bool EquivClassValid = false;
 
-    /// The constructor is not visible. The first argument is the pointer of the value that you want to encapsulate.
-    /// The second argument is the name of the vertex, which will be used in void DyckGraph::printAsDot() function.
+    /// The constructor is not visible. The first argument is the owner graph, the second one is
+    /// the id of the vertex in the graph, and the third one is the id of its equivalence class.
+    /// The last argument is the name of the vertex, which will be used in void DyckGraph::printAsDot() function.
     /// please use DyckGraph::retrieveDyckVertex for initialization.
-    explicit DyckGraphNode(void *V, const char *Name = nullptr);
+    DyckGraphNode(DyckGraph *G, unsigned Idx, unsigned ClassIdx, const char *Name = nullptr);
 
 public:
     ~DyckGraphNode();
 
-    /// Get its index
-    /// The index of the first vertex you create is 0, the second one is 1, ...
-    int getIndex() const;
+    /// Get its index, i.e., the dense id of the vertex in its graph.
+    /// Ids are stable until the graph is compacted, see DyckGraph::compact().
+    unsigned getIndex() const;
 
     /// Get its name
     const char *getName();
 
-    /// Get the source vertices corresponding the label
-    std::set<DyckGraphNode *> *getInVertices(void *Label);
-
-    /// Get the target vertices corresponding the label
-    std::set<DyckGraphNode *> *getOutVertices(void *Label);
-
     /// Get a single source vertex corresponding the label
     /// if there are multiple such vertices or zero, return null
-    DyckGraphNode *getInVertex(void *Label);
+    DyckGraphNode *getInVertex(DyckGraphEdgeLabel *Label);
 
     /// Get a single target vertex corresponding the label
     /// if there are multiple such vertices or zero, return null
-    DyckGraphNode *getOutVertex(void *Label);
+    DyckGraphNode *getOutVertex(DyckGraphEdgeLabel *Label);
+
+    /// Get the first target vertex corresponding the label, return null if there is no such vertex
+    DyckGraphNode *getFirstOutVertex(DyckGraphEdgeLabel *Label);
 
     /// Get the number of vertices that are the targets of this vertex, and have the edge label: label.
-    unsigned int outNumVertices(void *Label);
+    unsigned int outNumVertices(DyckGraphEdgeLabel *Label);
 
     /// Get the number of vertices that are the sources of this vertex, and have the edge label: label.
-    unsigned int inNumVertices(void *Label);
+    unsigned int inNumVertices(DyckGraphEdgeLabel *Label);
 
     /// Total degree of the vertex
-    unsigned int degree();
-
-    /// Get all the labels in the edges that point to the vertex's targets.
-    std::set<void *> &getOutLabels();
+    unsigned int degree() const { return NumInEdges + NumOutEdges; }
 
-    /// Get all the labels in the edges that point to the vertex.
-    std::set<void *> &getInLabels();
+    /// Get all the vertex's targets, grouped by labels.
+    const EdgeBucketList &getOutVertices() const { return OutEdges; }
 
-    /// Get all the vertex's targets.
-    /// The return value is a map which maps labels to a set of vertices.
-    std::map<void *, std::set<DyckGraphNode *>> &getOutVertices();
-
-    /// Get all the vertex's sources.
-    /// The return value is a map which maps labels to a set of vertices.
-    std::map<void *, std::set<DyckGraphNode *>> &getInVertices();
+    /// Get all the vertex's sources, grouped by labels.
+    const EdgeBucketList &getInVertices() const { return InEdges; }
 
     /// Add a target with a label. Meanwhile, this vertex will be a source of ver.
-    void addTarget(DyckGraphNode *Node, void *Label);
+    /// Adding an existing edge does nothing.
+    void addTarget(DyckGraphNode *Node, DyckGraphEdgeLabel *Label);
 
     /// Remove a target. Meanwhile, this vertex will be removed from ver's sources
-    void removeTarget(DyckGraphNode *Node, void *Label);
+    void removeTarget(DyckGraphNode *Node, DyckGraphEdgeLabel *Label);
 
     /// Return true if the vertex contains a target ver, and the edge label is "label"
-    bool containsTarget(DyckGraphNode *Tar, void *Label);
-
-    /// For qirun's algorithm DyckGraph::qirunAlgorithm().
-    /// The representatives of all the vertices in the equivalent set of this vertex
-    /// will be set to be Rep.
-    void mvEquivalentSetTo(DyckGraphNode *RootRep);
+    bool containsTarget(DyckGraphNode *Tar, DyckGraphEdgeLabel *Label);
 
     /// Get the equivalent set of non-null value.
     /// Use it after you call DyckGraph::qirunAlgorithm().
+    /// The set is collected from the union-find of the graph at the first call, and is rebuilt
+    /// if the vertex is merged with others later. It is not thread-safe at the first call.
     std::set<void *> *getEquivalentSet();
 
     /// the equivalent set contains null pointer
@@ -118,10 +129,22 @@ public:
     bool containsNull() const { return ContainsNull; }
 
 private:
-    void addSource(DyckGraphNode *, void *Label);
+    /// id-based versions of the public interfaces, used by DyckGraph
+    /// @{
+    bool addTarget(unsigned NodeIdx, unsigned Label);
+
+    bool removeTarget(unsigned NodeIdx, unsigned Label);
+
+    bool containsTarget(unsigned NodeIdx, unsigned Label) const;
 
-    void removeSource(DyckGraphNode *, void *Label);
+    unsigned outNumVertices(unsigned Label) const;
+    /// @}
+
+    static EdgeBucket *findBucket(EdgeBucketList &Buckets, unsigned Label);
+
+    static const EdgeBucket *findBucket(const EdgeBucketList &Buckets, unsigned Label);
+
+    static EdgeBucket &getOrInsertBucket(EdgeBucketList &Buckets, unsigned Label);
 };
 
 #endif // DYCKAA_DYCKGRAPHNODE_H
-
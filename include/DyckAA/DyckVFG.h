@@ -19,13 +19,16 @@
 #ifndef DyckAA_DYCKVFG_H
 #define DyckAA_DYCKVFG_H
 
+#include <llvm/ADT/iterator_range.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Module.h>
+#include <algorithm>
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <vector>
 #include "Support/CFG.h"
-#include "Support/MapIterators.h"
+#include "Support/ObjectArena.h"
 
 using namespace llvm;
 
@@ -36,11 +39,16 @@ class DyckModRefAnalysis;
 class Call;
 
 class DyckVFGNode {
+    friend class DyckVFG;
 private:
-    /// the value this node represents
+    /// the value this node represents, null for a hub node, see DyckVFG::createHubNode()
     Value *V;
 
+    /// the dense id of the node, see DyckVFG::getNode()
+    unsigned ID;
+
     /// labeled edge, 0 - epsilon, pos - call, neg - return
+    /// they are only used to build the graph, and are released by DyckVFG::freeze()
     /// @{
     using EdgeSetTy = std::set<std::pair<DyckVFGNode *, int>>;
     EdgeSetTy Targets;
@@ -48,7 +56,7 @@ private:
     /// @}
 
 public:
-    explicit DyckVFGNode(Value *V) : V(V) {}
+    DyckVFGNode(Value *V, unsigned ID) : V(V), ID(ID) {}
 
     void addTarget(DyckVFGNode *N, int L = 0) {
         assert(N);
@@ -58,38 +66,150 @@ public:
 
     Value *getValue() const { return V; }
 
+    unsigned getID() const { return ID; }
+
     Function *getFunction() const;
+};
+
+/// Iterates the edges of a node in the frozen graph, which yields (the id of the node at the other end, the label)
+class DyckVFGEdgeIterator {
+private:
+    const unsigned *Node;
+    const int *Label;
+
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::pair<unsigned, int> value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const value_type *pointer;
+    typedef value_type reference;
+
+    DyckVFGEdgeIterator(const unsigned *Node, const int *Label) : Node(Node), Label(Label) {}
+
+    value_type operator*() const { return {*Node, *Label}; }
 
-    EdgeSetTy::const_iterator begin() const { return Targets.begin(); }
+    DyckVFGEdgeIterator &operator++() {
+        ++Node;
+        ++Label;
+        return *this;
+    }
 
-    EdgeSetTy::const_iterator end() const { return Targets.end(); }
+    DyckVFGEdgeIterator operator++(int) {
+        auto Tmp = *this;
+        ++*this;
+        return Tmp;
+    }
 
-    EdgeSetTy::const_iterator in_begin() const { return Sources.begin(); }
+    bool operator==(const DyckVFGEdgeIterator &Other) const { return Node == Other.Node; }
 
-    EdgeSetTy::const_iterator in_end() const { return Sources.end(); }
+    bool operator!=(const DyckVFGEdgeIterator &Other) const { return Node != Other.Node; }
 };
 
 class DyckVFG {
 private:
+    /// the memory of the nodes, which are destroyed with the graph
+    ObjectArena<DyckVFGNode> NodeArena;
+
+    /// the nodes indexed by their ids
+    std::vector<DyckVFGNode *> Nodes;
+
+    /// value -> node, only used to build the graph, and is released by freeze()
     std::unordered_map<Value *, DyckVFGNode *> ValueNodeMap;
 
+    /// the edges in the compressed sparse row format, see freeze()
+    /// @{
+    struct CSRTy {
+        /// the edges of the node with id K are in [Offsets[K], Offsets[K + 1])
+        std::vector<unsigned> Offsets;
+        /// the ids of the nodes at the other ends of the edges, sorted for each node
+        std::vector<unsigned> Nodes;
+        /// the labels of the edges
+        std::vector<int> Labels;
+
+        iterator_range<DyckVFGEdgeIterator> edges(unsigned ID) const {
+            return {DyckVFGEdgeIterator(Nodes.data() + Offsets[ID], Labels.data() + Offsets[ID]),
+                    DyckVFGEdgeIterator(Nodes.data() + Offsets[ID + 1], Labels.data() + Offsets[ID + 1])};
+        }
+    };
+    CSRTy Forward;
+    CSRTy Backward;
+    /// @}
+
+    /// a read-only, open-addressing hash table from values to the ids of their nodes, see freeze()
+    /// @{
+    std::vector<std::pair<const Value *, unsigned>> FrozenIndex;
+    size_t FrozenMask = 0;
+    /// @}
+
 public:
     DyckVFG(DyckAliasAnalysis *DAA, DyckModRefAnalysis *DMRA, Module *M);
 
     ~DyckVFG();
 
+    /// Return the node of a value, or null if the value is not in the graph
     DyckVFGNode *getVFGNode(Value *) const;
 
-    value_iterator<std::unordered_map<Value *, DyckVFGNode *>::iterator> node_begin() { return {ValueNodeMap.begin()}; }
+    /// Return the id of the node of a value, or UINT_MAX if the value is not in the graph
+    unsigned getNodeID(const Value *) const;
+
+    /// Get the node by its id
+    DyckVFGNode *getNode(unsigned ID) const { return Nodes[ID]; }
+
+    /// The number of nodes, whose ids are 0, 1, ..., numNodes() - 1
+    unsigned numNodes() const { return Nodes.size(); }
+
+    std::vector<DyckVFGNode *>::const_iterator node_begin() const { return Nodes.begin(); }
+
+    std::vector<DyckVFGNode *>::const_iterator node_end() const { return Nodes.end(); }
 
-    value_iterator<std::unordered_map<Value *, DyckVFGNode *>::iterator> node_end() { return {ValueNodeMap.end()}; }
+    /// The outgoing edges of a node, (target id, label), in the order of the target ids
+    iterator_range<DyckVFGEdgeIterator> targets(unsigned ID) const { return Forward.edges(ID); }
+
+    /// The incoming edges of a node, (source id, label), in the order of the source ids
+    iterator_range<DyckVFGEdgeIterator> sources(unsigned ID) const { return Backward.edges(ID); }
+
+    unsigned numTargets(unsigned ID) const { return Forward.Offsets[ID + 1] - Forward.Offsets[ID]; }
+
+    unsigned numSources(unsigned ID) const { return Backward.Offsets[ID + 1] - Backward.Offsets[ID]; }
+
+    /// Return true if there is an edge, with any label, from the node \p From to the node \p To
+    bool hasEdge(unsigned From, unsigned To) const {
+        auto *Begin = Forward.Nodes.data() + Forward.Offsets[From];
+        auto *End = Forward.Nodes.data() + Forward.Offsets[From + 1];
+        return std::binary_search(Begin, End, To);
+    }
+
+    /// The number of edges
+    unsigned numEdges() const { return Forward.Nodes.size(); }
+
+    /// Print the number and the memory of the nodes
+    void printArenaStatistics(raw_ostream &O) const { NodeArena.print(O, "nodes"); }
+
+    /// Print the number and the memory of the frozen edges, in both directions
+    void printEdgeStatistics(raw_ostream &O) const;
 
 private:
     DyckVFGNode *getOrCreateVFGNode(Value *);
 
+    /// Move the edges of the nodes to the compressed sparse row arrays, and index the values by a read-only hash
+    /// table. It is called at the end of the constructor, and no nodes or edges can be added afterwards.
+    void freeze();
+
+    /// Create a node without a value, which connects the mod/ref values of a call, see -dyckvfg-hub-nodes
+    DyckVFGNode *createHubNode();
+
     void connect(DyckModRefAnalysis *, Call *, Function *, CFG *);
 
-    void buildLocalVFG(DyckAliasAnalysis *DAA, CFG *DMRA, Function *F) const;
+    /// Let the values in \p From flow to the values in \p To through edges labeled \p L, either directly or
+    /// through a hub node
+    void connect(const std::set<Value *> &From, const std::set<Value *> &To, int L);
+
+    /// epsilon edges (source, target) buffered before they are added to the graph
+    typedef std::vector<std::pair<DyckVFGNode *, DyckVFGNode *>> EdgeVecTy;
+
+    /// Find the value flows from stores to loads, and return the number of the reachability queries.
+    /// It does not modify the graph, so it can run in parallel, and the edges are appended to \p Edges.
+    unsigned buildLocalVFG(DyckAliasAnalysis *DAA, CFG *DMRA, Function *F, EdgeVecTy &Edges) const;
 
     void buildLocalVFG(Function &);
 };
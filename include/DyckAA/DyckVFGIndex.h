@@ -0,0 +1,80 @@
+/*
+ *  Canary features a fast unification-based alias analysis for C programs
+ *  Copyright (C) 2021 Qingkai Shi <qingkaishi@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DYCKAA_DYCKVFGINDEX_H
+#define DYCKAA_DYCKVFGINDEX_H
+
+#include <llvm/Support/raw_ostream.h>
+#include <memory>
+#include <vector>
+
+#include "DyckAA/DyckVFG.h"
+
+using namespace llvm;
+
+class Graph;
+
+class Grail;
+
+/// Answers the context-sensitive reachability queries on a frozen DyckVFG with the CSIndex library,
+/// i.e., whether a value flows to another along a path whose call and return edges are matched, except
+/// for the unmatched returns at the beginning and the unmatched calls at the end.
+/// The graph is converted to a CSIndex Graph in memory, the summary edges are added to get the indexing graph,
+/// whose strongly connected components are condensed and labeled by GRAIL.
+/// The queries are not thread-safe, since GRAIL marks the vertices it visits.
+class DyckVFGIndex {
+private:
+    DyckVFG *VFG;
+
+    /// the indexing graph, which has two copies of each vertex (see Graph::to_indexing_graph()),
+    /// with its strongly connected components condensed
+    std::unique_ptr<Graph> IG;
+
+    /// the GRAIL index of the condensed indexing graph
+    std::unique_ptr<Grail> Index;
+
+    /// vertex in the indexing graph -> its component, i.e., its vertex in the condensed graph
+    std::vector<int> Components;
+
+    /// the number of the vertices in the converted graph, i.e., before it is copied
+    unsigned NumVertices;
+
+    /// statistics
+    /// @{
+    size_t NumSummaryEdges = 0;
+    unsigned NumQueries = 0;
+    /// @}
+
+public:
+    /// Build the index of \p VFG, which must outlive the index. \p Dim is the number of the GRAIL labels.
+    explicit DyckVFGIndex(DyckVFG *VFG, int Dim = 2);
+
+    ~DyckVFGIndex();
+
+    /// Return true if \p From flows to \p To context-sensitively. A value not in the graph only reaches itself.
+    bool reach(Value *From, Value *To);
+
+    /// The same as above, but the nodes are given by their ids in the graph
+    bool reach(unsigned From, unsigned To);
+
+    /// Print the size of the index and the number of the queries
+    void printStatistics(raw_ostream &O) const;
+};
+
+#endif // DYCKAA_DYCKVFGINDEX_H
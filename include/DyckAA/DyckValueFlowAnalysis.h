@@ -23,7 +23,9 @@
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Debug.h>
+#include <memory>
 #include "DyckAA/DyckVFG.h"
+#include "DyckAA/DyckVFGIndex.h"
 
 using namespace llvm;
 
@@ -31,6 +33,9 @@ class DyckValueFlowAnalysis : public ModulePass {
 private:
     DyckVFG *VFG;
 
+    /// the context-sensitive index of VFG, built on demand
+    std::unique_ptr<DyckVFGIndex> VFGIndex;
+
 public:
     static char ID;
 
@@ -43,6 +48,9 @@ public:
     void getAnalysisUsage(AnalysisUsage &AU) const override;
 
     DyckVFG *getDyckVFGraph() const;
+
+    /// Get the context-sensitive reachability index of the graph, which is built at the first call
+    DyckVFGIndex *getDyckVFGIndex();
 };
 
 #endif // DYCKAA_DYCKVALUEFLOWANALYSIS_H
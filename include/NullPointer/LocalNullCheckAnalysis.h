@@ -20,6 +20,7 @@
 #define NULLPOINTER_LOCALNULLCHECKANALYSIS_H
 
 #include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/Dominators.h>
 #include <llvm/IR/Instruction.h>
 #include <llvm/Pass.h>
@@ -36,14 +37,78 @@ typedef std::pair<Instruction *, unsigned> Edge;
 
 class LocalNullCheckAnalysis {
 private:
-    /// Mapping an instruction to a mask, if ith bit of mask is set, it must not be null pointer
-    std::unordered_map<Instruction *, int32_t> InstNonNullMap;
+    /// Mapping an instruction to the offset of its operands in NonNullOperands
+    DenseMap<Instruction *, unsigned> InstOperandOffsets;
+
+    /// The operands of all instructions, if the (offset + i)th bit is set, the ith operand must not be null pointer
+    BitVector NonNullOperands;
 
     /// Ptr -> ID
     std::unordered_map<Value *, size_t> PtrIDMap;
 
-    /// Edge -> a BitVector, in which if IDth bit is set, the corresponding ptr is not null
-    std::map<Edge, BitVector> DataflowFacts;
+    /// the ptrs of the function and the IDs of their groups, a group is non-null once nfa proves any of them non-null
+    std::vector<std::pair<Value *, unsigned>> Ptrs;
+
+    /// A step of the transfer function of a block: the ptr TargetID becomes non-null
+    /// if all the ptrs of Operands[OperandBegin, OperandEnd) are non-null
+    struct TransferStep {
+        Instruction *Inst;
+        unsigned TargetID;
+        unsigned OperandBegin;
+        unsigned OperandEnd;
+    };
+
+    /// The summary of a basic block, facts are BitVectors, in which if IDth bit is set, the corresponding ptr is not null
+    struct BlockSummary {
+        BasicBlock *Block;
+        /// (index of the predecessor, successor number of its terminator)
+        std::vector<std::pair<unsigned, unsigned>> Incoming;
+        /// the steps of the non-terminator instructions, in [StepBegin, StepEnd) of Steps
+        unsigned StepBegin;
+        unsigned StepEnd;
+        /// successor number -> the index of the successor
+        std::vector<unsigned> Successors;
+        /// successor number -> the ptr checked to be non-null along the edge, or UINT_MAX
+        std::vector<unsigned> SuccessorGen;
+        /// successor number -> the fact on the edge, an unreachable edge keeps the fact it had when it was labeled
+        std::vector<BitVector> ExitFacts;
+        /// successor number -> whether the edge is unreachable
+        std::vector<bool> ExitUnreachable;
+        /// whether the non-terminator instructions are unreachable
+        bool BodyUnreachable;
+        /// whether the block is unreachable, i.e., its body is or all its incoming edges are, all ptrs are non-null
+        /// in an unreachable block
+        bool Unreachable;
+    };
+
+    /// the blocks in reverse post-order, followed by the blocks not reachable from the entry
+    std::vector<BlockSummary> Blocks;
+
+    /// block -> its index in Blocks
+    DenseMap<BasicBlock *, unsigned> BlockIDMap;
+
+    /// the ptrs proved non-null by nfa, which are non-null everywhere in the function
+    BitVector Seeds;
+
+    /// the successors of the edges labeled unreachable since the last run
+    std::vector<unsigned> NewUnreachableSuccessors;
+
+    /// the transfer steps of all blocks
+    std::vector<TransferStep> Steps;
+
+    /// the operands of all transfer steps
+    std::vector<unsigned> StepOperands;
+
+    /// the sparse engine, see -nca-sparse
+    /// @{
+    /// ptr ID -> block -> the first instruction in the block after which the ptr is non-null,
+    /// null if the ptr is non-null at the entry of the block
+    std::vector<DenseMap<BasicBlock *, Instruction *>> NonNullPoints;
+    /// ptr ID -> the steps that have it as an operand
+    std::vector<std::vector<unsigned>> StepUsers;
+    /// block index -> the indices of the blocks in its dominance frontier
+    std::vector<std::vector<unsigned>> Frontiers;
+    /// @}
 
     /// unreachable edges collected during nca
     std::set<Edge> UnreachableEdges;
@@ -69,18 +134,44 @@ public:
     /// return true if \p Ptr at \p Inst may be a null pointer
     bool mayNull(Value *Ptr, Instruction *Inst);
 
+    /// analyze the function, a later run resumes from the fixed point of the last run
     void run();
 
 private:
     void nca();
 
-    void merge(std::vector<Edge> &, BitVector &);
+    /// build the block summaries, called once since the ptrs and the cfg never change
+    void summarize();
+
+    /// the ID of the ptr group of \p Ptr, or UINT_MAX if it is not tracked
+    unsigned getPtrID(Value *Ptr);
 
-    void transfer(Edge, const BitVector &, BitVector &);
+    /// intersect the facts on the incoming edges of the block \p BID
+    void merge(unsigned BID, BitVector &);
+
+    /// apply the steps of [Begin, End) to \p Fact
+    void transfer(unsigned Begin, unsigned End, BitVector &Fact);
 
     void tag();
 
-    void init();
+    /// the sparse version of nca(), which places the non-null facts of each ptr on the dominator tree
+    void ncaSparse();
+
+    /// the sparse version of tag()
+    void tagSparse();
+
+    /// build the def-use and dominance frontier information used by ncaSparse()
+    void summarizeSparse();
+
+    /// return true if the ptr \p ID must be non-null right before \p Inst, used by the sparse engine
+    bool nonNullBefore(unsigned ID, Instruction *Inst);
+
+    /// return true if the ptr \p ID must be non-null in the block \p B right after \p After,
+    /// or at the entry of the block if \p After is null
+    bool nonNullAt(unsigned ID, BasicBlock *B, Instruction *After);
+
+    /// init the facts at the first run, return false if nothing has changed since the last run
+    bool init();
 
     void label();
 
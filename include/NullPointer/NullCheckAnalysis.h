@@ -22,17 +22,32 @@
 #include <llvm/IR/Function.h>
 #include <llvm/Pass.h>
 #include <list>
+#include <mutex>
 #include <set>
 #include <unordered_map>
 
 using namespace llvm;
 
 class LocalNullCheckAnalysis;
+class NullFlowAnalysis;
 
 class NullCheckAnalysis : public ModulePass {
 private:
     std::unordered_map<Function *, LocalNullCheckAnalysis *> AnalysisMap;
 
+    /// the demand-driven mode, see -nca-demand
+    /// @{
+    NullFlowAnalysis *NFA = nullptr;
+    /// the functions from which a value flows into each function met by a query, see getSourceFunctions
+    std::unordered_map<Function *, std::set<Function *>> SourceMap;
+    /// the queried functions whose transitive sources have reached a fixed point, cleared when a function turns dirty
+    std::set<Function *> Queried;
+    /// the analyzed functions with new non-null values since their last run, resumed on their next query
+    std::set<Function *> Dirty;
+    /// guards AnalysisMap, NFA, SourceMap, Queried and Dirty, which are updated by the queries
+    std::mutex DemandMutex;
+    /// @}
+
 public:
     static char ID;
 
@@ -48,6 +63,11 @@ public:
     /// \p Ptr must be an operand of \p Inst
     /// return true if \p Ptr at \p Inst may be a null pointer
     bool mayNull(Value *Ptr, Instruction *Inst);
+
+private:
+    /// return the analysis of \p F, analyze or resume \p F and its transitive value-flow predecessors until none
+    /// of them has new non-null values, as the whole-module mode does, DemandMutex must be held
+    LocalNullCheckAnalysis *getOrAnalyze(Function *F);
 };
 
 #endif // NULLPOINTER_NULLCHECKANALYSIS_H
@@ -19,6 +19,8 @@
 #ifndef NULLPOINTER_NULLFLOWANALYSIS_H
 #define NULLPOINTER_NULLFLOWANALYSIS_H
 
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseSet.h>
 #include <llvm/Pass.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/CommandLine.h>
@@ -34,11 +36,19 @@ private:
 
     DyckVFG *VFG;
 
-    std::set<std::pair<DyckVFGNode *, DyckVFGNode *>> NonNullEdges;
+    /// the edges are identified by the ids of their nodes, see DyckVFG::getNodeID()
+    /// @{
+    DenseSet<std::pair<unsigned, unsigned>> NonNullEdges;
+
+    std::map<Function *, std::set<std::pair<unsigned, unsigned>>> NewNonNullEdges;
+    /// @}
 
-    std::map<Function *, std::set<std::pair<DyckVFGNode *, DyckVFGNode *>>> NewNonNullEdges;
+    /// the ids of the non-null nodes
+    BitVector NonNullNodes;
 
-    std::set<DyckVFGNode *> NonNullNodes;
+    /// node id -> the number of its sources that are neither non-null nor connected to it by a non-null edge,
+    /// a node becomes non-null when the number drops to zero
+    std::vector<unsigned> NumMayNullSources;
 
 public:
     static char ID;
@@ -67,6 +77,11 @@ public:
 
     /// return true if the input value is not null
     bool notNull(Value *) const;
+
+    /// add to \p Sources the functions, other than \p F, from which a value flows into a pointer of \p F
+    /// along a single value flow (through hub nodes if any), i.e., the functions whose null checks may
+    /// make a pointer of \p F non-null
+    void getSourceFunctions(Function *F, std::set<Function *> &Sources) const;
 };
 
 #endif // NULLPOINTER_NULLFLOWANALYSIS_H
@@ -20,32 +20,69 @@
 #define SUPPORT_CFG_H
 
 #include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Instruction.h>
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
 
 using namespace llvm;
 
+/// The reachability of the blocks and the instructions of a function.
+/// The strongly connected components of the blocks are condensed into a DAG, whose nodes are numbered so that
+/// a component has a larger number than its successors, and labeled with intervals in the style of GRAIL.
+/// Most negative queries are answered by comparing the numbers and the labels. The other queries look up the
+/// components reachable from the source, which are computed on demand and cached in the memory budget set by
+/// -cfg-reach-cache-limit, evicting the least recently used ones.
+/// The queries are not thread-safe because they fill the cache.
 class CFG {
 private:
-    typedef BitVector ReachableVec;
-    ReachableVec AnalyzedVec;
-    ReachableVec *ReachableVecPtr;
+    /// the component of each block
+    DenseMap<BasicBlock *, unsigned> BlockComponents;
 
-    /// ID mapping
-    std::vector<BasicBlock *> ID2BB;
-    std::map<BasicBlock *, int> BB2ID;
+    /// the position of each instruction in its block
+    DenseMap<Instruction *, unsigned> Ordinals;
+
+    /// successors of each component in the condensed graph, in the CSR layout
+    /// @{
+    std::vector<unsigned> SuccBegin;
+    std::vector<unsigned> Succs;
+    /// @}
+
+    /// the interval labels of the components, (the lowest rank of the descendants, the post-order rank),
+    /// one per traversal, and a component can only reach the ones whose intervals are within its own
+    static const unsigned NumTraversals = 2;
+    std::vector<std::pair<unsigned, unsigned>> Labels[NumTraversals];
+
+    /// the cached components reachable from a component, and the cached components from the most recently used
+    /// @{
+    DenseMap<unsigned, std::pair<BitVector, std::list<unsigned>::iterator>> ReachableCache;
+    std::list<unsigned> LRUList;
+    unsigned MaxCached;
+    /// @}
 
 public:
     explicit CFG(Function *);
 
     ~CFG();
 
-    bool reachable(BasicBlock *, BasicBlock *);
+    /// Return true if \p To is \p From, or it is reachable from \p From via at least one edge
+    bool reachable(BasicBlock *From, BasicBlock *To);
 
-    bool reachable(Instruction *, Instruction *);
+    /// Return true if \p To is \p From, or it is executed after \p From. In the same block, only the
+    /// instructions after \p From are reachable, even if the block is in a loop.
+    bool reachable(Instruction *From, Instruction *To);
 
 private:
-    void analyze(BasicBlock *);
+    unsigned numComponents() const { return SuccBegin.size() - 1; }
+
+    /// Return true if the labels of the component \p To are within the ones of \p From
+    bool mayReach(unsigned From, unsigned To) const;
+
+    /// Get the components reachable from \p Component, computing and caching them if necessary
+    const BitVector &getReachable(unsigned Component);
 };
 
 typedef std::shared_ptr<CFG> CFGRef;
@@ -20,7 +20,11 @@
 #ifndef SUPPORT_DISJOINTSET_H
 #define SUPPORT_DISJOINTSET_H
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 template<typename T>
 struct Node {
@@ -92,4 +96,124 @@ public:
     }
 };
 
+/// A flat disjoint set whose elements are dense ids 0, 1, 2, ...
+/// It uses union by rank and path halving. Besides, the elements of a set are chained in a circular list,
+/// so that the members of a set can be enumerated without keeping a container for each set.
+class IndexedDisjointSet {
+private:
+    std::vector<unsigned> _parent;
+    std::vector<unsigned char> _rank;
+    std::vector<unsigned> _next;
+
+public:
+    IndexedDisjointSet() = default;
+
+    /// create a singleton set and return its id
+    unsigned makeSet() {
+        auto id = (unsigned) _parent.size();
+        _parent.push_back(id);
+        _rank.push_back(0);
+        _next.push_back(id);
+        return id;
+    }
+
+    /// return the id of the representative of the set containing \p id
+    unsigned findSet(unsigned id) {
+        while (_parent[id] != id) {
+            unsigned grandparent = _parent[_parent[id]];
+            // only write if it changes anything, so that a flattened set can be read concurrently
+            if (_parent[id] != grandparent) _parent[id] = grandparent;
+            id = grandparent;
+        }
+        return id;
+    }
+
+    /// return the id of the representative of the set containing \p id without path compression
+    unsigned findSet(unsigned id) const {
+        while (_parent[id] != id) id = _parent[id];
+        return id;
+    }
+
+    /// merge the sets containing \p id1 and \p id2, and return the representative of the merged set
+    unsigned doUnion(unsigned id1, unsigned id2) {
+        unsigned root1 = findSet(id1), root2 = findSet(id2);
+        if (root1 == root2)
+            return root1;
+
+        // splice the two circular member lists
+        std::swap(_next[root1], _next[root2]);
+        if (_rank[root1] >= _rank[root2]) {
+            _rank[root1] += _rank[root1] == _rank[root2];
+            _parent[root2] = root1;
+            return root1;
+        } else {
+            _parent[root1] = root2;
+            return root2;
+        }
+    }
+
+    /// the next member in the set containing \p id, members of a set form a cycle
+    unsigned next(unsigned id) const {
+        return _next[id];
+    }
+
+    /// let each element point to its representative directly
+    void flatten() {
+        for (unsigned id = 0; id < _parent.size(); ++id) {
+            unsigned root = findSet(id);
+            if (_parent[id] != root) _parent[id] = root;
+        }
+    }
+
+    size_t size() const {
+        return _parent.size();
+    }
+};
+
+/// A lock-free disjoint set whose elements are dense ids 0, 1, ..., n - 1, which may be united and found
+/// concurrently. A union links the root with the larger id to the one with the smaller id by a CAS, and
+/// finding a root halves the path by CASes. Hence the representative of a set is always its smallest id,
+/// no matter in which order or by which threads the unions are done.
+class ConcurrentDisjointSet {
+private:
+    std::unique_ptr<std::atomic<unsigned>[]> _parent;
+    unsigned _size;
+
+public:
+    explicit ConcurrentDisjointSet(unsigned size) : _parent(new std::atomic<unsigned>[size]), _size(size) {
+        for (unsigned id = 0; id < size; ++id)
+            _parent[id].store(id, std::memory_order_relaxed);
+    }
+
+    /// return the id of the representative of the set containing \p id
+    unsigned findSet(unsigned id) {
+        while (true) {
+            unsigned parent = _parent[id].load(std::memory_order_acquire);
+            if (parent == id) return id;
+            unsigned grandparent = _parent[parent].load(std::memory_order_acquire);
+            // a failed CAS means another thread has shortened the path, either way we go on from the grandparent
+            if (parent != grandparent)
+                _parent[id].compare_exchange_weak(parent, grandparent, std::memory_order_acq_rel);
+            id = grandparent;
+        }
+    }
+
+    /// merge the sets containing \p id1 and \p id2, return false if they are already in the same set
+    bool doUnion(unsigned id1, unsigned id2) {
+        while (true) {
+            id1 = findSet(id1);
+            id2 = findSet(id2);
+            if (id1 == id2) return false;
+            if (id1 < id2) std::swap(id1, id2);
+            // fails if id1 is no longer a root, then retry from the new roots
+            unsigned expected = id1;
+            if (_parent[id1].compare_exchange_strong(expected, id2, std::memory_order_acq_rel)) return true;
+        }
+    }
+
+    size_t size() const {
+        return _size;
+    }
+};
+
 #endif //SUPPORT_DISJOINTSET_H
@@ -0,0 +1,63 @@
+/*
+ *  Canary features a fast unification-based alias analysis for C programs
+ *  Copyright (C) 2021 Qingkai Shi <qingkaishi@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SUPPORT_OBJECTARENA_H
+#define SUPPORT_OBJECTARENA_H
+
+#include <llvm/Support/Allocator.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstddef>
+
+/// A slab allocator of the objects of a single type. The objects cannot be freed one by one,
+/// they are destroyed together with the arena, which then releases the memory slab by slab.
+template<class T>
+class ObjectArena {
+private:
+    llvm::SpecificBumpPtrAllocator<T> Allocator;
+
+    size_t NumObjects = 0;
+
+public:
+    ObjectArena() = default;
+
+    ObjectArena(const ObjectArena &) = delete;
+
+    ObjectArena &operator=(const ObjectArena &) = delete;
+
+    /// Get the uninitialized memory of an object, which must be constructed by placement new,
+    /// so that the owner of the arena can create objects whose constructors are not public.
+    void *allocate() {
+        ++NumObjects;
+        return Allocator.Allocate();
+    }
+
+    /// The number of objects allocated
+    size_t size() const { return NumObjects; }
+
+    /// The bytes of the objects allocated, which is also the peak since nothing is freed before the arena dies
+    size_t bytes() const { return NumObjects * sizeof(T); }
+
+    /// Print the statistics in the style of RecursiveTimer, e.g., "N vertices, M KB"
+    void print(llvm::raw_ostream &O, const char *Name) const {
+        O << NumObjects << " " << Name << ", " << (bytes() + 1023) / 1024 << " KB";
+    }
+};
+
+#endif //SUPPORT_OBJECTARENA_H
@@ -43,6 +43,9 @@ public:
 
     /// end of the recorder
     ~RecursiveTimer();
+
+    /// print a line indented as the timers, e.g., the statistics of the work being timed
+    static void print(const std::string &Message);
 };
 
 class RecursiveTimerPass : public ModulePass {
@@ -20,6 +20,7 @@
 #include <llvm/IR/InstIterator.h>
 #include "AAAnalyzer.h"
 #include "Support/RecursiveTimer.h"
+#include "Support/ThreadPool.h"
 
 static cl::opt<unsigned> FunctionTypeCheckLevel("function-type-check-level", cl::init(4), cl::Hidden,
                                                 cl::desc("The level of checking the compatability of function types"
@@ -38,6 +39,10 @@ static cl::opt<bool> PrintUnknownPointerCall("print-unknown-ptr-call", cl::init(
 static cl::opt<unsigned> NumInterIteration("dyckaa-inter-iteration", cl::init(UINT_MAX), cl::Hidden,
                                            cl::desc("The max # iterators for fixed-point inter-proc computation."));
 
+static cl::opt<bool> ParallelIntraAnalysis("dyckaa-parallel-intra", cl::init(false), cl::Hidden,
+                                           cl::desc("Generate the constraints of functions in parallel "
+                                                    "(use -nworkers to set the number of threads)."));
+
 AAAnalyzer::AAAnalyzer(Module *M, DyckGraph *DG, DyckCallGraph *CG) {
     Mod = M;
     CFLGraph = DG;
@@ -50,29 +55,203 @@ AAAnalyzer::~AAAnalyzer() {
     destroyFunctionGroups();
 }
 
-void AAAnalyzer::intraProcedureAnalysis() {
+uint64_t AAAnalyzer::getOptionsHash() {
+    return ((uint64_t) FunctionTypeCheckLevel << 33) | ((uint64_t) WithFunctionCastComb << 32) | NumInterIteration;
+}
+
+bool AAAnalyzer::supportsIncrementalAnalysis() {
+    // the function groups combined by casts and the partial fixed point are not saved
+    return !WithFunctionCastComb && NumInterIteration == UINT_MAX;
+}
+
+void AAAnalyzer::intraProcedureAnalysis(const std::set<Function *> *CleanFunctions) {
     RecursiveTimer IntraAA("Running intra-procedural analysis");
     long InstNum = 0;
     long IntrinsicsNum = 0;
+    std::vector<std::pair<Function *, DyckCallGraphNode *>> Functions;
     for (auto &F: *Mod) {
         if (F.isIntrinsic()) {
             // intrinsics are handled as instructions
             IntrinsicsNum++;
             continue;
         }
-        DyckCallGraphNode *DF = DyckCG->getOrInsertFunction(&F);
+        InstNum += F.getInstructionCount();
+        Functions.emplace_back(&F, DyckCG->getOrInsertFunction(&F));
+    }
+
+    auto GenerateConstraints = [this](Function *F, DyckCallGraphNode *DF, ConstraintBuffer &CB) {
         for (auto &I: instructions(F)) {
-            InstNum++;
-            handleInst(&I, DF);
+            handleInst(&I, DF, CB);
+        }
+    };
+    auto Apply = [this, CleanFunctions](Function *F, const ConstraintBuffer &CB, DyckCallGraphNode *DF) {
+        if (CleanFunctions && CleanFunctions->count(F))
+            applyCallConstraints(CB, DF);
+        else
+            applyConstraints(CB, DF);
+    };
+
+    if (ParallelIntraAnalysis) {
+        // constraints of different functions are generated in parallel, and then applied in the order of the
+        // functions, so that the result is the same as the one of the sequential analysis
+        std::vector<ConstraintBuffer> Constraints(Functions.size());
+        {
+            RecursiveTimer GenTimer("Generating constraints");
+            for (unsigned K = 0; K < Functions.size(); ++K) {
+                ThreadPool::get()->enqueue([&GenerateConstraints, &Functions, &Constraints, K]() {
+                    GenerateConstraints(Functions[K].first, Functions[K].second, Constraints[K]);
+                });
+            }
+            ThreadPool::get()->wait();
+        }
+        RecursiveTimer MergeTimer("Merging constraints");
+        for (unsigned K = 0; K < Functions.size(); ++K) {
+            Apply(Functions[K].first, Constraints[K], Functions[K].second);
+            Constraints[K].clear();
+        }
+    } else {
+        ConstraintBuffer CB;
+        for (auto &FuncPair: Functions) {
+            GenerateConstraints(FuncPair.first, FuncPair.second, CB);
+            Apply(FuncPair.first, CB, FuncPair.second);
+            CB.clear();
         }
     }
     DEBUG_WITH_TYPE("dyckaa-stats", errs() << "\n# Instructions: " << InstNum << "\n");
     DEBUG_WITH_TYPE("dyckaa-stats", errs() << "# Functions: " << Mod->size() - IntrinsicsNum << "\n");
 }
 
+/// Each pointer call watches the equivalence class of its called value. A function is matched against the
+/// calls watching its class when it is added to the graph, or when its class is merged with a watched one.
+/// Since classes never split, a (call, function) pair is matched at most once, and a round of the
+/// inter-procedural analysis only handles the pairs produced by the merges of the previous round,
+/// instead of intersecting the equivalent set of every pointer call with its compatible functions.
+class AAAnalyzer::PointerCallResolver : public DyckGraph::Listener {
+private:
+    struct WatcherTy {
+        PointerCall *Call;
+        DyckCallGraphNode *Caller;
+        /// ids of the functions compatible with the called value
+        const SparseBitVector<> *Compatible;
+    };
+
+    AAAnalyzer *Analyzer;
+
+    /// class -> the pointer calls whose called values are in the class
+    DenseMap<unsigned, SmallVector<WatcherTy, 1>> Watchers;
+
+    /// class -> ids of the address-taken functions in the class
+    DenseMap<unsigned, SparseBitVector<>> Functions;
+
+    /// the matched pairs that have not been handled
+    std::vector<std::pair<WatcherTy, Function *>> Pending;
+
+    void match(const WatcherTy &W, const SparseBitVector<> &FuncIds) {
+        if (!W.Compatible->intersects(FuncIds)) return;
+        for (unsigned Id: FuncIds & *W.Compatible) {
+            ++NumMatches;
+            Pending.emplace_back(W, Analyzer->AddressTakenFunctions[Id]);
+        }
+    }
+
+    void match(unsigned WatcherClass, unsigned FunctionClass) {
+        auto WIt = Watchers.find(WatcherClass);
+        auto FIt = Functions.find(FunctionClass);
+        if (WIt == Watchers.end() || FIt == Functions.end()) return;
+        for (auto &W: WIt->second) match(W, FIt->second);
+    }
+
+public:
+    /// # type-compatible (call, function) pairs matched
+    unsigned long NumMatches = 0;
+
+    explicit PointerCallResolver(AAAnalyzer *A) : Analyzer(A) {}
+
+    /// Watch all the functions and pointer calls in the graphs, and then the changes of the classes
+    void start() {
+        auto *G = Analyzer->CFLGraph;
+        G->setListener(this);
+        for (auto *F: Analyzer->AddressTakenFunctions) {
+            if (auto *N = G->findDyckVertex(F)) valueAdded(F, G->getClassIndex(N));
+        }
+        for (auto CGNodeIt = Analyzer->DyckCG->nodes_begin(); CGNodeIt != Analyzer->DyckCG->nodes_end(); ++CGNodeIt) {
+            DyckCallGraphNode *CGNode = *CGNodeIt;
+            for (auto PCIt = CGNode->pointer_call_begin(); PCIt != CGNode->pointer_call_end(); ++PCIt)
+                watch(*PCIt, CGNode);
+        }
+    }
+
+    void stop() { Analyzer->CFLGraph->setListener(nullptr); }
+
+    void watch(PointerCall *PCall, DyckCallGraphNode *Caller) {
+        auto *G = Analyzer->CFLGraph;
+        auto *FTy = (FunctionType *) PCall->getCalledValue()->getType()->getPointerElementType();
+        WatcherTy W = {PCall, Caller, &Analyzer->getCompatibleFunctions(FTy)};
+        unsigned ClassIdx = G->getClassIndex(G->retrieveDyckVertex(PCall->getCalledValue()).first);
+        Watchers[ClassIdx].push_back(W);
+        auto It = Functions.find(ClassIdx);
+        if (It != Functions.end()) match(W, It->second);
+    }
+
+    void valueAdded(void *Val, unsigned ClassIdx) override {
+        auto *F = dyn_cast<Function>((Value *) Val);
+        if (!F) return;
+        // the functions that are not address-taken are not compatible with any pointer call
+        auto IdIt = Analyzer->FunctionIds.find(F);
+        if (IdIt == Analyzer->FunctionIds.end()) return;
+        Functions[ClassIdx].set(IdIt->second);
+        auto It = Watchers.find(ClassIdx);
+        if (It == Watchers.end()) return;
+        for (auto &W: It->second) {
+            if (W.Compatible->test(IdIt->second)) {
+                ++NumMatches;
+                Pending.emplace_back(W, F);
+            }
+        }
+    }
+
+    void classesMerged(unsigned Rep, unsigned Absorbed) override {
+        match(Rep, Absorbed);
+        match(Absorbed, Rep);
+
+        auto WIt = Watchers.find(Absorbed);
+        if (WIt != Watchers.end()) {
+            SmallVector<WatcherTy, 1> Moved(std::move(WIt->second));
+            Watchers.erase(WIt);
+            auto &Dst = Watchers[Rep];
+            if (Dst.size() < Moved.size()) std::swap(Dst, Moved);
+            Dst.append(Moved.begin(), Moved.end());
+        }
+        auto FIt = Functions.find(Absorbed);
+        if (FIt != Functions.end()) {
+            SparseBitVector<> Moved(std::move(FIt->second));
+            Functions.erase(FIt);
+            Functions[Rep] |= Moved;
+        }
+    }
+
+    /// Handle the pending pairs, including the ones matched when handling them.
+    /// Return true if any call gets a new callee.
+    bool resolve() {
+        bool Ret = false;
+        // handling a pair may merge classes and append more pairs
+        for (size_t K = 0; K < Pending.size(); ++K) {
+            WatcherTy W = Pending[K].first;
+            Function *F = Pending[K].second;
+            if (!W.Call->addMayAliasedFunction(F)) continue;
+            Ret = true;
+            Analyzer->handleCommonFunctionCall(W.Call, W.Caller, Analyzer->DyckCG->getOrInsertFunction(F));
+            Analyzer->handleLibInvokeCallInst(W.Call->getInstruction(), F, &(W.Call->getArgs()), W.Caller);
+        }
+        Pending.clear();
+        return Ret;
+    }
+};
+
 void AAAnalyzer::interProcedureAnalysis() {
     RecursiveTimer IntraAA("Running inter-procedural analysis");
 
+    PointerCallResolver PCR(this);
     unsigned IterationCounter = 0;
     while (true) {
         if (IterationCounter++ >= NumInterIteration.getValue())
@@ -80,7 +259,10 @@ void AAAnalyzer::interProcedureAnalysis() {
         RecursiveTimer IterationTimer("Iteration " + std::to_string(IterationCounter));
 
         bool Finished = true;
-        CFLGraph->qirunAlgorithm();
+        {
+            RecursiveTimer UnifyTimer("Unifying vertices");
+            CFLGraph->qirunAlgorithm();
+        }
 
         if (IterationCounter == 1) { // direct calls
             RecursiveTimer DirectCallTimer("Handling direct calls");
@@ -98,25 +280,24 @@ void AAAnalyzer::interProcedureAnalysis() {
                 }
                 ++CGNodeIt;
             }
+
+            // from now on, the pointer calls are matched with the functions when classes are merged
+            PCR.start();
+            Resolver = &PCR;
         }
 
         { // indirect call
             RecursiveTimer DirectCallTimer("Handling indirect calls");
-            int NumProcessedFunctions = 0;
-            auto DFIt = DyckCG->begin();
-            while (DFIt != DyckCG->end()) {
-                DyckCallGraphNode *DF = DFIt->second;
-
-                if (handlePointerFunctionCalls(DF, ++NumProcessedFunctions)) {
-                    Finished = false;
-                }
-
-                ++DFIt;
+            if (PCR.resolve()) {
+                Finished = false;
             }
         }
 
         if (Finished) break;
     }
+    PCR.stop();
+    Resolver = nullptr;
+    DEBUG_WITH_TYPE("dyckaa-stats", errs() << "# Matched pointer calls and functions: " << PCR.NumMatches << "\n");
 
     // finalize the call graph
     for (auto &F: *Mod) {
@@ -276,7 +457,9 @@ void AAAnalyzer::initFunctionGroups() {
             auto *FTy = (FunctionType *) ((PointerType *) Func->getType())->getPointerElementType();
 
             FunctionTypeNode *Root = this->initFunctionGroup(FTy);
-            Root->CompatibleFuncs.insert(Func);
+            Root->CompatibleFuncs.set(AddressTakenFunctions.size());
+            FunctionIds[Func] = AddressTakenFunctions.size();
+            AddressTakenFunctions.push_back(Func);
         }
     }
 }
@@ -300,21 +483,20 @@ void AAAnalyzer::combineFunctionGroups(FunctionType *FTyX, FunctionType *FTyY) {
     DEBUG_WITH_TYPE("combine-function-groups",
                     outs() << "[CANARY] Combining " << *FTyX << " and " << *FTyY << "... \n");
 
-    X->CompatibleFuncs.insert(Y->CompatibleFuncs.begin(), Y->CompatibleFuncs.end());
-    Y->CompatibleFuncs.insert(X->CompatibleFuncs.begin(), X->CompatibleFuncs.end());
+    X->CompatibleFuncs |= Y->CompatibleFuncs;
+    Y->CompatibleFuncs |= X->CompatibleFuncs;
 }
 
 DyckGraphNode *AAAnalyzer::addField(DyckGraphNode *Val, long FieldIndex, DyckGraphNode *Field) {
+    auto *FieldLabel = CFLGraph->getOrInsertIndexEdgeLabel(FieldIndex);
     if (!Field) {
-        auto *ValRepSet = Val->getOutVertices((void *) (CFLGraph->getOrInsertIndexEdgeLabel(FieldIndex)));
-        if (ValRepSet && !ValRepSet->empty()) {
-            Field = *(ValRepSet->begin());
-        } else {
+        Field = Val->getFirstOutVertex(FieldLabel);
+        if (!Field) {
             Field = CFLGraph->retrieveDyckVertex(nullptr).first;
-            Val->addTarget(Field, (void *) (CFLGraph->getOrInsertIndexEdgeLabel(FieldIndex)));
+            Val->addTarget(Field, FieldLabel);
         }
     } else {
-        Val->addTarget(Field, (void *) (CFLGraph->getOrInsertIndexEdgeLabel(FieldIndex)));
+        Val->addTarget(Field, FieldLabel);
     }
     return Field;
 }
@@ -328,10 +510,8 @@ DyckGraphNode *AAAnalyzer::addPtrTo(DyckGraphNode *Address, DyckGraphNode *Val)
         Address->addTarget(Val, DLabel);
         return Address;
     } else if (!Val) {
-        std::set<DyckGraphNode *> *DerefSet = Address->getOutVertices(DLabel);
-        if (DerefSet && !DerefSet->empty()) {
-            Val = *(DerefSet->begin());
-        } else {
+        Val = Address->getFirstOutVertex(DLabel);
+        if (!Val) {
             Val = CFLGraph->retrieveDyckVertex(nullptr).first;
             Address->addTarget(Val, DLabel);
         }
@@ -351,9 +531,9 @@ void AAAnalyzer::makeContentAlias(DyckGraphNode *X, DyckGraphNode *Y) {
     addPtrTo(Y, addPtrTo(X, nullptr));
 }
 
-DyckGraphNode *AAAnalyzer::handleGEP(GEPOperator *GEP) {
+ConstraintBuffer::NodeRef AAAnalyzer::handleGEP(GEPOperator *GEP, ConstraintBuffer &CB) {
     Value *Ptr = GEP->getPointerOperand();
-    DyckGraphNode *Current = wrapValue(Ptr);
+    auto Current = CB.value(Ptr);
 
     auto GTI = gep_type_begin(GEP); // preGTI is the PointerTy of ptr
     Type *AggOrPointerTy = Ptr->getType();
@@ -366,24 +546,24 @@ DyckGraphNode *AAAnalyzer::handleGEP(GEPOperator *GEP) {
         if (AggOrPointerTy->isStructTy()) {
             // example: gep y 0 constIdx
             // s1: y--deref-->?1--(fieldIdx idxLabel)-->?2
-            DyckGraphNode *TheStruct = this->addPtrTo(Current, nullptr);
+            auto TheStruct = CB.deref(Current);
 
             assert(CI && "ERROR: when dealing with gep");
 
             // s2: ?3--deref-->?2
             auto FieldIdx = (unsigned) (*(CI->getValue().getRawData()));
-            DyckGraphNode *Field = this->addField(TheStruct, FieldIdx, nullptr);
-            DyckGraphNode *FieldPtr = this->addPtrTo(nullptr, Field);
+            auto Field = CB.field(TheStruct, FieldIdx);
+            auto FieldPtr = CB.addressOf(Field);
 
             // the label representation and feature impl is temporal.
             // s3: y--(fieldIdx offLabel)-->?3
-            Current->addTarget(FieldPtr, (void *) (CFLGraph->getOrInsertOffsetEdgeLabel(FieldIdx)));
+            CB.offset(Current, FieldIdx, FieldPtr);
 
             // update current
             Current = FieldPtr;
         } else if (AggOrPointerTy->isPointerTy() || AggOrPointerTy->isArrayTy() || AggOrPointerTy->isVectorTy()) {
             if (!CI)
-                wrapValue(Idx);
+                CB.value(Idx);
         } else {
             errs() << "\n";
             errs() << *GEP << "\n";
@@ -402,29 +582,34 @@ DyckGraphNode *AAAnalyzer::handleGEP(GEPOperator *GEP) {
 DyckGraphNode *AAAnalyzer::wrapValue(Value *V) {
     // if the vertex of v exists, return it, otherwise create one
     std::pair<DyckGraphNode *, bool> RetPair = CFLGraph->retrieveDyckVertex(V);
-    if (RetPair.second || !V) {
+    if (RetPair.second || !V || !isa<Constant>(V)) {
         return RetPair.first;
     }
-    DyckGraphNode *VDV = RetPair.first;
 
     // constantTy are handled as below.
+    ConstraintBuffer CB;
+    handleConstant((Constant *) V, CB);
+    if (CB.empty())
+        return RetPair.first;
+    return applyConstraints(CB, nullptr, CB.value(V));
+}
+
+void AAAnalyzer::handleConstant(Constant *V, ConstraintBuffer &CB) {
     if (isa<ConstantExpr>(V)) {
         unsigned Opcode = ((ConstantExpr *) V)->getOpcode();
         if (Opcode >= Instruction::CastOpsBegin && Opcode <= Instruction::CastOpsEnd) {
-            DyckGraphNode *Got = wrapValue(((ConstantExpr *) V)->getOperand(0));
-            VDV = wrapValue(V);
-            VDV = makeAlias(VDV, Got);
+            auto Got = CB.value(((ConstantExpr *) V)->getOperand(0));
+            CB.alias(CB.value(V), Got);
         } else if (Opcode == Instruction::GetElementPtr) {
-            DyckGraphNode *Got = handleGEP((GEPOperator *) V);
-            VDV = wrapValue(V);
-            VDV = makeAlias(VDV, Got);
+            auto Got = handleGEP((GEPOperator *) V, CB);
+            CB.alias(CB.value(V), Got);
         } else if (Opcode == Instruction::Select) {
-            wrapValue(((ConstantExpr *) V)->getOperand(0));
-            DyckGraphNode *Opt0 = wrapValue(((ConstantExpr *) V)->getOperand(1));
-            DyckGraphNode *Opt1 = wrapValue(((ConstantExpr *) V)->getOperand(2));
-            VDV = wrapValue(V);
-            VDV = makeAlias(VDV, Opt0);
-            VDV = makeAlias(VDV, Opt1);
+            CB.value(((ConstantExpr *) V)->getOperand(0));
+            auto Opt0 = CB.value(((ConstantExpr *) V)->getOperand(1));
+            auto Opt1 = CB.value(((ConstantExpr *) V)->getOperand(2));
+            auto VDV = CB.value(V);
+            VDV = CB.alias(VDV, Opt0);
+            CB.alias(VDV, Opt1);
         } else if (Opcode == Instruction::ExtractValue) {
             Value *Agg = ((ConstantExpr *) V)->getOperand(0);
             std::vector<unsigned> IndicesVec;
@@ -433,12 +618,12 @@ DyckGraphNode *AAAnalyzer::wrapValue(Value *V) {
                 IndicesVec.push_back((unsigned) (*(Index->getValue().getRawData())));
             }
             ArrayRef<unsigned> Indices(IndicesVec);
-            this->handleExtractInsertValueInst(Agg, Agg->getType(), Indices, V);
+            this->handleExtractInsertValueInst(Agg, Agg->getType(), Indices, V, CB);
         } else if (Opcode == Instruction::InsertValue) {
-            DyckGraphNode *ResultV = wrapValue(V);
+            auto ResultV = CB.value(V);
             Value *Agg = ((ConstantExpr *) V)->getOperand(0);
             if (!isa<UndefValue>(Agg)) {
-                makeAlias(ResultV, wrapValue(Agg));
+                CB.alias(ResultV, CB.value(Agg));
             }
             std::vector<unsigned> IndicesVec;
             for (unsigned K = 2; K < ((ConstantExpr *) V)->getNumOperands(); K++) {
@@ -446,21 +631,21 @@ DyckGraphNode *AAAnalyzer::wrapValue(Value *V) {
                 IndicesVec.push_back((unsigned) (*(Index->getValue().getRawData())));
             }
             ArrayRef<unsigned> indices(IndicesVec);
-            this->handleExtractInsertValueInst(V, Agg->getType(), indices, ((ConstantExpr *) V)->getOperand(1));
+            this->handleExtractInsertValueInst(V, Agg->getType(), indices, ((ConstantExpr *) V)->getOperand(1), CB);
         } else if (Opcode == Instruction::ExtractElement) {
             Value *Vec = ((ConstantExpr *) V)->getOperand(0);
-            this->handleExtractInsertElmtInst(Vec, V);
+            this->handleExtractInsertElmtInst(Vec, V, CB);
         } else if (Opcode == Instruction::InsertElement) {
             Value *Vec = ((ConstantExpr *) V)->getOperand(0);
             Value *Elmt2Insert = ((ConstantExpr *) V)->getOperand(1);
-            this->handleExtractInsertElmtInst(Vec, Elmt2Insert);
-            this->handleExtractInsertElmtInst(V, Elmt2Insert);
+            this->handleExtractInsertElmtInst(Vec, Elmt2Insert, CB);
+            this->handleExtractInsertElmtInst(V, Elmt2Insert, CB);
         } else if (Opcode == Instruction::ShuffleVector) {
             Value *VecX = ((ConstantExpr *) V)->getOperand(0);
             Value *VecY = ((ConstantExpr *) V)->getOperand(1);
-            Value *VecRet = V;
-            this->makeAlias(wrapValue(VecRet), wrapValue(VecX));
-            this->makeAlias(wrapValue(VecRet), wrapValue(VecY));
+            auto VecRet = CB.value(V);
+            CB.alias(VecRet, CB.value(VecX));
+            CB.alias(VecRet, CB.value(VecY));
         } else {
             // binary constant expr
             // cmp constant expr
@@ -473,46 +658,40 @@ DyckGraphNode *AAAnalyzer::wrapValue(Value *V) {
             for (unsigned K = 0; K < ((ConstantExpr *) V)->getNumOperands(); K++) {
                 // e.g. i1 icmp ne (i8* bitcast (i32 (i32*, void (i8*)*)* @__pthread_key_create to i8*), i8* null)
                 // we should handle op<0>
-                wrapValue(((ConstantExpr *) V)->getOperand(K));
+                CB.value(((ConstantExpr *) V)->getOperand(K));
             }
         }
     } else if (isa<ConstantStruct>(V) || isa<ConstantArray>(V)) {
-        auto *Agg = (Constant *) V;
-        unsigned NumElmt = Agg->getNumOperands();
+        unsigned NumElmt = V->getNumOperands();
         for (unsigned K = 0; K < NumElmt; K++) {
-            Value *ElmtK = Agg->getOperand(K);
+            Value *ElmtK = V->getOperand(K);
 
             std::vector<unsigned> Indices;
             Indices.push_back(K);
             ArrayRef<unsigned> indicesRef(Indices);
-            this->handleExtractInsertValueInst(V, Agg->getType(), indicesRef, ElmtK);
+            this->handleExtractInsertValueInst(V, V->getType(), indicesRef, ElmtK, CB);
         }
-        VDV = wrapValue(V);
     } else if (isa<ConstantVector>(V)) {
-        auto CV = (ConstantVector *) V;
-        unsigned NumElmt = CV->getNumOperands();
+        unsigned NumElmt = V->getNumOperands();
         for (unsigned K = 0; K < NumElmt; K++) {
-            Value *ElmtK = CV->getOperand(K);
-            this->handleExtractInsertElmtInst(CV, ElmtK);
+            Value *ElmtK = V->getOperand(K);
+            this->handleExtractInsertElmtInst(V, ElmtK, CB);
         }
-        VDV = wrapValue(V);
     } else if (isa<GlobalValue>(V)) {
         if (isa<GlobalVariable>(V)) {
             auto *Global = (GlobalVariable *) V;
             if (Global->hasInitializer()) {
                 Value *Initializer = Global->getInitializer();
                 if (!isa<UndefValue>(Initializer)) {
-                    DyckGraphNode *InitNode = wrapValue(Initializer);
-                    VDV = wrapValue(V);
-                    addPtrTo(VDV, InitNode);
+                    auto InitNode = CB.value(Initializer);
+                    CB.ptrTo(CB.value(V), InitNode);
                 }
             }
         } else if (isa<GlobalAlias>(V)) {
             auto *Global = (GlobalAlias *) V;
             Value *Aliasee = Global->getAliasee();
-            auto AliaseeV = wrapValue(Aliasee);
-            VDV = wrapValue(V);
-            VDV = makeAlias(VDV, AliaseeV);
+            auto AliaseeV = CB.value(Aliasee);
+            CB.alias(CB.value(V), AliaseeV);
         } else if (isa<Function>(V)) {
             // do nothing
         } else {
@@ -541,17 +720,79 @@ DyckGraphNode *AAAnalyzer::wrapValue(Value *V) {
         // e.g.
         //    [1 x i8] zeroinitializer
         //    %struct.color_cap zeroinitializer
-    } else if (isa<Constant>(V)) {
+    } else {
         errs() << "ERROR when handle the following constant value\n";
         errs() << *V << "\n";
         errs().flush();
         exit(-1);
     }
+}
+
+DyckGraphNode *AAAnalyzer::applyConstraints(const ConstraintBuffer &CB, DyckCallGraphNode *Parent,
+                                            ConstraintBuffer::NodeRef Result) {
+    // a node defined by a constraint may be merged into another one by the following constraints,
+    // so we record its equivalence class instead of the node itself
+    std::vector<unsigned> NodeClasses(CB.size(), UINT_MAX);
+    auto GetNode = [this, &NodeClasses](ConstraintBuffer::NodeRef Ref) {
+        assert(NodeClasses[Ref] != UINT_MAX && "The constraint does not define a node!");
+        return CFLGraph->getClassVertex(NodeClasses[Ref]);
+    };
+
+    unsigned K = 0;
+    for (auto &C: CB) {
+        DyckGraphNode *N = nullptr;
+        switch (C.Kind) {
+            case ConstraintBuffer::CK_Value:
+                N = wrapValue(C.Val);
+                break;
+            case ConstraintBuffer::CK_Deref:
+                N = addPtrTo(GetNode(C.Op0), nullptr);
+                break;
+            case ConstraintBuffer::CK_AddrOf:
+                N = addPtrTo(nullptr, GetNode(C.Op0));
+                break;
+            case ConstraintBuffer::CK_PtrTo:
+                N = addPtrTo(GetNode(C.Op0), GetNode(C.Op1));
+                break;
+            case ConstraintBuffer::CK_Field:
+                N = addField(GetNode(C.Op0), C.Imm, C.Op1 == ConstraintBuffer::None ? nullptr : GetNode(C.Op1));
+                break;
+            case ConstraintBuffer::CK_Offset:
+                GetNode(C.Op0)->addTarget(GetNode(C.Op1), CFLGraph->getOrInsertOffsetEdgeLabel(C.Imm));
+                break;
+            case ConstraintBuffer::CK_Alias:
+                N = makeAlias(GetNode(C.Op0), GetNode(C.Op1));
+                break;
+            case ConstraintBuffer::CK_FuncCast: {
+                auto *Cast = (Instruction *) C.Val;
+                combineFunctionGroups((FunctionType *) Cast->getOperand(0)->getType()->getPointerElementType(),
+                                      (FunctionType *) Cast->getType()->getPointerElementType());
+            }
+                break;
+            case ConstraintBuffer::CK_Call:
+                handleCallInst((CallInst *) C.Val, Parent);
+                break;
+        }
+        if (N)
+            NodeClasses[K] = CFLGraph->getClassIndex(N);
+        ++K;
+    }
+    return Result == ConstraintBuffer::None ? nullptr : GetNode(Result);
+}
 
-    return VDV;
+void AAAnalyzer::applyCallConstraints(const ConstraintBuffer &CB, DyckCallGraphNode *Parent) {
+    for (auto &C: CB) {
+        if (C.Kind == ConstraintBuffer::CK_FuncCast) {
+            auto *Cast = (Instruction *) C.Val;
+            combineFunctionGroups((FunctionType *) Cast->getOperand(0)->getType()->getPointerElementType(),
+                                  (FunctionType *) Cast->getType()->getPointerElementType());
+        } else if (C.Kind == ConstraintBuffer::CK_Call) {
+            handleCallInst((CallInst *) C.Val, Parent);
+        }
+    }
 }
 
-void AAAnalyzer::handleInstrinsic(Instruction *Inst) {
+void AAAnalyzer::handleInstrinsic(Instruction *Inst, ConstraintBuffer &CB) {
     if (!Inst)
         return;
 
@@ -561,7 +802,7 @@ void AAAnalyzer::handleInstrinsic(Instruction *Inst) {
         // Variable Argument Handling Intrinsics
         case Intrinsic::vastart: {
             Value *VAListPtr = CallI->getArgOperand(0);
-            wrapValue(VAListPtr);
+            CB.value(VAListPtr);
 
             // 0b01
             Mask |= 1;
@@ -578,13 +819,13 @@ void AAAnalyzer::handleInstrinsic(Instruction *Inst) {
             Value *SrcPtr = CallI->getArgOperand(0);
             Value *DstPtr = CallI->getArgOperand(1);
 
-            DyckGraphNode *SrcPtrVer = wrapValue(SrcPtr);
-            DyckGraphNode *DstPtrVer = wrapValue(DstPtr);
+            auto SrcPtrVer = CB.value(SrcPtr);
+            auto DstPtrVer = CB.value(DstPtr);
 
-            DyckGraphNode *SrcVer = addPtrTo(SrcPtrVer, nullptr);
-            DyckGraphNode *DstVer = addPtrTo(DstPtrVer, nullptr);
+            auto SrcVer = CB.deref(SrcPtrVer);
+            auto DstVer = CB.deref(DstPtrVer);
 
-            makeAlias(SrcVer, DstVer);
+            CB.alias(SrcVer, DstVer);
 
             // 0b11
             Mask |= 3;
@@ -593,7 +834,8 @@ void AAAnalyzer::handleInstrinsic(Instruction *Inst) {
         case Intrinsic::memset: {
             Value *Ptr = CallI->getArgOperand(0);
             Value *Val = CallI->getArgOperand(1);
-            addPtrTo(wrapValue(Ptr), wrapValue(Val));
+            auto PtrVer = CB.value(Ptr);
+            CB.ptrTo(PtrVer, CB.value(Val));
             // 0b11
             Mask |= 3;
         }
@@ -607,8 +849,10 @@ void AAAnalyzer::handleInstrinsic(Instruction *Inst) {
             // vec_load = load ptr
             // vec_return = select mask vec_load vec_passthru
 
-            this->makeAlias(wrapValue(VecReturn), wrapValue(VecPassthru));
-            this->addPtrTo(wrapValue(ptr), wrapValue(VecReturn));
+            auto VecReturnVer = CB.value(VecReturn);
+            CB.alias(VecReturnVer, CB.value(VecPassthru));
+            auto PtrVer = CB.value(ptr);
+            CB.ptrTo(PtrVer, CB.value(VecReturn));
 
             // 0b101
             Mask |= 5;
@@ -625,7 +869,8 @@ void AAAnalyzer::handleInstrinsic(Instruction *Inst) {
             Value *Vec = CallI->getArgOperand(0);
             Value *Ptr = CallI->getArgOperand(1);
 
-            this->addPtrTo(wrapValue(Ptr), wrapValue(Vec));
+            auto PtrVer = CB.value(Ptr);
+            CB.ptrTo(PtrVer, CB.value(Vec));
 
             // 0b11
             Mask |= 3;
@@ -651,20 +896,20 @@ void AAAnalyzer::handleInstrinsic(Instruction *Inst) {
     }
 
     // wrap unhandled operand
-    for (unsigned K = 0; K < CallI->getNumArgOperands(); K++) {
+    for (unsigned K = 0; K < CallI->arg_size(); K++) {
         if (!(Mask & (1 << K))) {
-            wrapValue(CallI->getArgOperand(K));
+            CB.value(CallI->getArgOperand(K));
         }
     }
-    wrapValue(CallI->getCalledOperand());
+    CB.value(CallI->getCalledOperand());
 }
 
-std::set<Function *> *AAAnalyzer::getCompatibleFunctions(FunctionType *FTy) {
+const SparseBitVector<> &AAAnalyzer::getCompatibleFunctions(FunctionType *FTy) {
     FunctionTypeNode *FTyNode = this->initFunctionGroup(FTy);
-    return &(FTyNode->Root->CompatibleFuncs);
+    return FTyNode->Root->CompatibleFuncs;
 }
 
-void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
+void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent, ConstraintBuffer &CB) {
     int Mask = 0;
 
     switch (Inst->getOpcode()) {
@@ -686,7 +931,7 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
             // vector operations
         case Instruction::ExtractElement: {
             Value *Vec = ((ExtractElementInst *) Inst)->getVectorOperand();
-            this->handleExtractInsertElmtInst(Vec, Inst);
+            this->handleExtractInsertElmtInst(Vec, Inst, CB);
 
             Mask |= (~0);
         }
@@ -694,8 +939,8 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
         case Instruction::InsertElement: {
             Value *Vec = ((InsertElementInst *) Inst)->getOperand(0);
             Value *Elmt2Insert = ((InsertElementInst *) Inst)->getOperand(1);
-            this->handleExtractInsertElmtInst(Vec, Elmt2Insert);
-            this->handleExtractInsertElmtInst(Inst, Elmt2Insert);
+            this->handleExtractInsertElmtInst(Vec, Elmt2Insert, CB);
+            this->handleExtractInsertElmtInst(Inst, Elmt2Insert, CB);
 
             Mask |= (~0);
         }
@@ -703,10 +948,10 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
         case Instruction::ShuffleVector: {
             Value *Vec1 = ((ShuffleVectorInst *) Inst)->getOperand(0);
             Value *Vec2 = ((ShuffleVectorInst *) Inst)->getOperand(1);
-            Value *VectRet = Inst;
+            auto VectRet = CB.value(Inst);
 
-            this->makeAlias(wrapValue(VectRet), wrapValue(Vec1));
-            this->makeAlias(wrapValue(VectRet), wrapValue(Vec2));
+            CB.alias(VectRet, CB.value(Vec1));
+            CB.alias(VectRet, CB.value(Vec2));
 
             Mask |= (~0);
         }
@@ -717,21 +962,21 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
             Value *Agg = ((ExtractValueInst *) Inst)->getAggregateOperand();
             ArrayRef<unsigned> Indices = ((ExtractValueInst *) Inst)->getIndices();
 
-            this->handleExtractInsertValueInst(Agg, Agg->getType(), Indices, Inst);
+            this->handleExtractInsertValueInst(Agg, Agg->getType(), Indices, Inst, CB);
 
             Mask |= (~0);
         }
             break;
         case Instruction::InsertValue: {
-            DyckGraphNode *ResultV = wrapValue(Inst);
+            auto ResultV = CB.value(Inst);
             Value *Agg = ((InsertValueInst *) Inst)->getAggregateOperand();
             if (!isa<UndefValue>(Agg))
-                makeAlias(ResultV, wrapValue(Agg));
+                CB.alias(ResultV, CB.value(Agg));
 
             ArrayRef<unsigned> Indices = ((InsertValueInst *) Inst)->getIndices();
 
             this->handleExtractInsertValueInst(Inst, Inst->getType(), Indices,
-                                               ((InsertValueInst *) Inst)->getInsertedValueOperand());
+                                               ((InsertValueInst *) Inst)->getInsertedValueOperand(), CB);
 
             Mask |= (~0);
         }
@@ -748,7 +993,8 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
         case Instruction::Load: {
             Value *LVal = Inst;
             Value *LAddress = Inst->getOperand(0);
-            addPtrTo(wrapValue(LAddress), wrapValue(LVal));
+            auto LAddressVer = CB.value(LAddress);
+            CB.ptrTo(LAddressVer, CB.value(LVal));
 
             Mask |= (~0);
         }
@@ -756,15 +1002,15 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
         case Instruction::Store: {
             Value *SVal = Inst->getOperand(0);
             Value *SAddress = Inst->getOperand(1);
-            wrapValue(SAddress);
-            wrapValue(SVal);
-            addPtrTo(wrapValue(SAddress), wrapValue(SVal));
+            auto SAddressVer = CB.value(SAddress);
+            CB.ptrTo(SAddressVer, CB.value(SVal));
 
             Mask |= (~0);
         }
             break;
         case Instruction::GetElementPtr: {
-            makeAlias(wrapValue(Inst), handleGEP((GEPOperator *) Inst));
+            auto GEPVer = CB.value(Inst);
+            CB.alias(GEPVer, handleGEP((GEPOperator *) Inst, CB));
 
             Mask |= (~0);
         }
@@ -785,7 +1031,8 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
         case Instruction::PtrToInt:
         case Instruction::IntToPtr: {
             Value *CastOperand = Inst->getOperand(0);
-            makeAlias(wrapValue(Inst), wrapValue(CastOperand));
+            auto CastVer = CB.value(Inst);
+            CB.alias(CastVer, CB.value(CastOperand));
 
             //  function pointer cast
             Type *OrigTy = CastOperand->getType();
@@ -793,8 +1040,7 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
 
             if (OrigTy->isPointerTy() && OrigTy->getPointerElementType()->isFunctionTy() && CastTy->isPointerTy()
                 && CastTy->getPointerElementType()->isFunctionTy()) {
-                combineFunctionGroups((FunctionType *) OrigTy->getPointerElementType(),
-                                      (FunctionType *) CastTy->getPointerElementType());
+                CB.funcCast(Inst);
             }
 
             Mask |= (~0);
@@ -812,18 +1058,18 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
             auto *CallI = (CallInst *) Inst;
             if (CallI->isInlineAsm()) break;
 
-            Value *CV = CallI->getCalledOperand();
-            std::vector<Value *> Args;
-            for (unsigned K = 0; K < CallI->getNumArgOperands(); K++) {
-                wrapValue(CallI->getArgOperand(K));
-                Args.push_back(CallI->getArgOperand(K));
+            auto *Callee = dyn_cast<Function>(CallI->getCalledOperand());
+            if (Callee && Callee->isIntrinsic()) {
+                for (unsigned K = 0; K < CallI->arg_size(); K++)
+                    CB.value(CallI->getArgOperand(K));
+                handleInstrinsic(CallI, CB);
+                if (!CallI->getType()->isVoidTy())
+                    CB.value(CallI);
+            } else {
+                // other calls update the call graph, and are thus handled when the constraints are applied
+                CB.call(CallI);
             }
 
-            this->handleInvokeCallInst(CallI, CV, &Args, Parent);
-
-            if (!CallI->getType()->isVoidTy())
-                wrapValue(CallI);
-
             Mask |= (~0);
         }
             break;
@@ -832,9 +1078,8 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
             auto Nums = Phi->getNumIncomingValues();
             for (int K = 0; K < Nums; K++) {
                 Value *P = Phi->getIncomingValue(K);
-                wrapValue(Inst);
-                auto *PV = wrapValue(P);
-                makeAlias(wrapValue(Inst), PV);
+                auto PhiVer = CB.value(Inst);
+                CB.alias(PhiVer, CB.value(P));
             }
 
             Mask |= (~0);
@@ -843,20 +1088,20 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
         case Instruction::Select: {
             Value *First = ((SelectInst *) Inst)->getTrueValue();
             Value *Second = ((SelectInst *) Inst)->getFalseValue();
-            makeAlias(wrapValue(Inst), wrapValue(First));
-            wrapValue(Second);
-            makeAlias(wrapValue(Inst), wrapValue(Second));
+            auto SelectVer = CB.value(Inst);
+            SelectVer = CB.alias(SelectVer, CB.value(First));
+            CB.alias(SelectVer, CB.value(Second));
 
-            wrapValue(((SelectInst *) Inst)->getCondition());
+            CB.value(((SelectInst *) Inst)->getCondition());
 
             Mask |= (~0);
         }
             break;
         case Instruction::VAArg: {
             Parent->addVAArg(Inst);
-            DyckGraphNode *VAArg = wrapValue(Inst);
+            auto VAArg = CB.value(Inst);
             Value *PtrVAArg = Inst->getOperand(0);
-            addPtrTo(wrapValue(PtrVAArg), VAArg);
+            CB.ptrTo(CB.value(PtrVAArg), VAArg);
 
             Mask |= (~0);
         }
@@ -870,50 +1115,66 @@ void AAAnalyzer::handleInst(Instruction *Inst, DyckCallGraphNode *Parent) {
     // wrap unhandled operand
     for (unsigned K = 0; K < Inst->getNumOperands(); K++) {
         if (!(Mask & (1 << K))) {
-            wrapValue(Inst->getOperand(K));
+            CB.value(Inst->getOperand(K));
         }
     }
 }
 
 void AAAnalyzer::handleExtractInsertValueInst(Value *AggValue, Type *AggTy, ArrayRef<unsigned> &Indices,
-                                              Value *InsertedOrExtractedValue) {
-    auto ToInOrExVal = wrapValue(InsertedOrExtractedValue);
-    auto CurrentStruct = wrapValue(AggValue);
+                                              Value *InsertedOrExtractedValue, ConstraintBuffer &CB) {
+    auto ToInOrExVal = CB.value(InsertedOrExtractedValue);
+    auto CurrentStruct = CB.value(AggValue);
 
     for (unsigned int K = 0; K < Indices.size(); K++) {
         assert(AggTy->isAggregateType() && "Error in handleExtractInsertValueInst, not an agg (array/struct) type!");
 
         if (AggTy->isArrayTy()) {
             if (K == Indices.size() - 1) {
-                CurrentStruct = this->makeAlias(CurrentStruct, ToInOrExVal);
+                CurrentStruct = CB.alias(CurrentStruct, ToInOrExVal);
             }
             AggTy = ((ArrayType *) AggTy)->getElementType();
         } else {
             assert(AggTy->isStructTy());
             if (K != Indices.size() - 1) {
-                CurrentStruct = this->addField(CurrentStruct, Indices[K], nullptr);
+                CurrentStruct = CB.field(CurrentStruct, Indices[K]);
             } else {
-                CurrentStruct = this->addField(CurrentStruct, Indices[K], ToInOrExVal);
+                CurrentStruct = CB.field(CurrentStruct, Indices[K], ToInOrExVal);
             }
             AggTy = ((StructType *) AggTy)->getTypeAtIndex(Indices[K]);
         }
     }
 }
 
-void AAAnalyzer::handleExtractInsertElmtInst(Value *Vec, Value *Elmt) {
-    auto ElmtVer = wrapValue(Elmt);
-    auto VecVer = wrapValue(Vec);
-    this->makeAlias(VecVer, ElmtVer);
+void AAAnalyzer::handleExtractInsertElmtInst(Value *Vec, Value *Elmt, ConstraintBuffer &CB) {
+    auto ElmtVer = CB.value(Elmt);
+    auto VecVer = CB.value(Vec);
+    CB.alias(VecVer, ElmtVer);
+}
+
+void AAAnalyzer::handleCallInst(CallInst *CallI, DyckCallGraphNode *Parent) {
+    Value *CV = CallI->getCalledOperand();
+    std::vector<Value *> Args;
+    for (unsigned K = 0; K < CallI->arg_size(); K++) {
+        wrapValue(CallI->getArgOperand(K));
+        Args.push_back(CallI->getArgOperand(K));
+    }
+
+    this->handleInvokeCallInst(CallI, CV, &Args, Parent);
+
+    if (!CallI->getType()->isVoidTy())
+        wrapValue(CallI);
 }
 
 void AAAnalyzer::handleInvokeCallInst(Instruction *Ret, Value *CV, std::vector<Value *> *Args,
                                       DyckCallGraphNode *Parent) {
     if (isa<Function>(CV)) {
         if (((Function *) CV)->isIntrinsic()) {
-            handleInstrinsic((Instruction *) Ret);
+            ConstraintBuffer CB;
+            handleInstrinsic((Instruction *) Ret, CB);
+            applyConstraints(CB, Parent);
         } else {
             this->handleLibInvokeCallInst(Ret, (Function *) CV, Args, Parent);
-            Parent->addCommonCall(new CommonCall(Ret, (Function *) CV, Args));
+            Parent->addCommonCall(DyckCG->createCommonCall(Ret, (Function *) CV, Args));
         }
     } else {
         wrapValue(CV);
@@ -925,10 +1186,9 @@ void AAAnalyzer::handleInvokeCallInst(Instruction *Ret, Value *CV, std::vector<V
 
             if (isa<Function>(CVCopy)) {
                 this->handleLibInvokeCallInst(Ret, (Function *) CVCopy, Args, Parent);
-                Parent->addCommonCall(new CommonCall(Ret, (Function *) CVCopy, Args));
+                Parent->addCommonCall(DyckCG->createCommonCall(Ret, (Function *) CVCopy, Args));
             } else {
-                auto *PCall = new PointerCall(Ret, CV, Args);
-                Parent->addPointerCall(PCall);
+                addPointerCall(DyckCG->createPointerCall(Ret, CV, Args), Parent);
             }
         } else if (isa<GlobalAlias>(CV)) {
             Value *CVCopy = CV;
@@ -938,18 +1198,21 @@ void AAAnalyzer::handleInvokeCallInst(Instruction *Ret, Value *CV, std::vector<V
 
             if (isa<Function>(CVCopy)) {
                 this->handleLibInvokeCallInst(Ret, (Function *) CVCopy, Args, Parent);
-                Parent->addCommonCall(new CommonCall(Ret, (Function *) CVCopy, Args));
+                Parent->addCommonCall(DyckCG->createCommonCall(Ret, (Function *) CVCopy, Args));
             } else {
-                auto *PCall = new PointerCall(Ret, CV, Args);
-                Parent->addPointerCall(PCall);
+                addPointerCall(DyckCG->createPointerCall(Ret, CV, Args), Parent);
             }
         } else {
-            auto *PCall = new PointerCall(Ret, CV, Args);
-            Parent->addPointerCall(PCall);
+            addPointerCall(DyckCG->createPointerCall(Ret, CV, Args), Parent);
         }
     }
 }
 
+void AAAnalyzer::addPointerCall(PointerCall *PCall, DyckCallGraphNode *Parent) {
+    Parent->addPointerCall(PCall);
+    if (Resolver) Resolver->watch(PCall, Parent);
+}
+
 void AAAnalyzer::handleCommonFunctionCall(Call *C, DyckCallGraphNode *Caller, DyckCallGraphNode *Callee) {
     // for better precise, if callee is an empty function, we do not match the args and parameters.
     if (Callee->getLLVMFunction()->empty()) return;
@@ -1020,71 +1283,6 @@ void AAAnalyzer::handleCommonFunctionCall(Call *C, DyckCallGraphNode *Caller, Dy
     }
 }
 
-bool AAAnalyzer::handlePointerFunctionCalls(DyckCallGraphNode *Caller, int Counter) {
-    bool Ret = false;
-
-    auto PCIt = Caller->pointer_call_begin();
-
-    // print in console
-    unsigned PCTotal = Caller->pointer_call_size();
-    unsigned PCCount = 0;
-//	if (PTCALL_TOTAL == 0)
-//		outs() << "Handling indirect calls in Function #" << FUNCTION_COUNT << "... 100%, 100%. Done!\r";
-
-    while (PCIt != Caller->pointer_call_end()) {
-        // print in console
-        unsigned Percentage = ((++PCCount) * 100 / PCTotal);
-//		outs() << "Handling indirect calls in Function #" << FUNCTION_COUNT << "... " << percentage << "%, \r";
-
-        PointerCall *PCall = *PCIt;
-        auto *PCalledVal = PCall->getCalledValue();
-        Type *FTy = PCalledVal->getType()->getPointerElementType();
-        assert(FTy->isFunctionTy() && "Error in AAAnalyzer::handlePointerFunctionCalls!");
-
-        // handle each unhandled, possible function
-        std::set<Value *> EquivAndTypeCompSet;
-        auto *EquivSet = (const std::set<Value *> *) CFLGraph->retrieveDyckVertex(PCalledVal).first->getEquivalentSet();
-        std::set<Function *> *Cands = this->getCompatibleFunctions((FunctionType *) FTy);
-        set_intersection(Cands->begin(), Cands->end(), EquivSet->begin(), EquivSet->end(),
-                         inserter(EquivAndTypeCompSet, EquivAndTypeCompSet.begin()));
-
-        std::set<Value *> UnhandledFunction;
-        set_difference(EquivAndTypeCompSet.begin(), EquivAndTypeCompSet.end(), PCall->begin(), PCall->end(),
-                       inserter(UnhandledFunction, UnhandledFunction.begin()));
-
-        // print in console
-        unsigned CandTotal = UnhandledFunction.size();
-        unsigned CandCount = 0;
-        if (CandTotal == 0) {
-//			outs() << "Handling indirect calls in Function #" << FUNCTION_COUNT << "... " << "100%, 100%. Done!\r";
-            PCIt++;
-            continue;
-        }
-
-        auto PFIt = UnhandledFunction.begin();
-        while (PFIt != UnhandledFunction.end()) {
-            auto *MayAliasedFunctioin = (Function *) (*PFIt);
-            // print in console
-//            unsigned Rate = ((100 * (++CandCount)) / CandTotal);
-//            if (Percentage == 100 && Rate == 100) {
-//				outs() << "Handling indirect calls in Function #" << FUNCTION_COUNT << "... " << "100%, 100%. Done!\r";
-//            } else {
-//				outs() << "Handling indirect calls in Function #" << FUNCTION_COUNT << "... " << percentage << "%, " << RATE << "%         \r";
-//            }
-
-            if (!Ret) Ret = true;
-            PCall->addMayAliasedFunction(MayAliasedFunctioin);
-            handleCommonFunctionCall(PCall, Caller, DyckCG->getOrInsertFunction(MayAliasedFunctioin));
-            handleLibInvokeCallInst(PCall->getInstruction(), MayAliasedFunctioin, &(PCall->getArgs()), Caller);
-            PFIt++;
-        }
-
-        PCIt++;
-    }
-
-    return Ret;
-}
-
 void AAAnalyzer::handleLibInvokeCallInst(Value *Ret, Function *F, const std::vector<Value *> *Args,
                                          DyckCallGraphNode *Parent) {
     // args must be the real arguments, not the parameters.
@@ -20,17 +20,21 @@
 #define DYCKAA_AAANALYZER_H
 
 #include <llvm/Pass.h>
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/ADT/SmallPtrSet.h>
 #include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/SparseBitVector.h>
 #include <llvm/Support/ErrorHandling.h>
 #include <llvm/IR/GetElementPtrTypeIterator.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Debug.h>
 #include <llvm/IR/InlineAsm.h>
+#include <climits>
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #include "DyckAA/DyckCallGraph.h"
 #include "DyckAA/DyckGraph.h"
@@ -40,9 +44,108 @@ using namespace llvm;
 typedef struct FunctionTypeNode {
     FunctionType *FuncTy;
     FunctionTypeNode *Root;
-    std::set<Function *> CompatibleFuncs;
+    /// ids of the compatible functions, see AAAnalyzer::AddressTakenFunctions
+    SparseBitVector<> CompatibleFuncs;
 } FunctionTypeNode;
 
+/// The constraints that a function (or a constant) imposes on the dyck graph.
+/// They are recorded without touching the graph, so that the constraints of different functions can be
+/// generated in parallel, and then applied to the graph in a fixed order by AAAnalyzer::applyConstraints.
+/// A constraint may define a node, which is referred to by the index of the constraint.
+class ConstraintBuffer {
+public:
+    typedef unsigned NodeRef;
+
+    static const NodeRef None = UINT_MAX;
+
+    enum ConstraintKind : unsigned char {
+        CK_Value,    ///< the node of Val
+        CK_Deref,    ///< the node pointed to by Op0, created if absent
+        CK_AddrOf,   ///< a new node pointing to Op0
+        CK_PtrTo,    ///< Op0 points to Op1, defines Op0
+        CK_Field,    ///< the Imm-th field of Op0, which is Op1 if Op1 is not None
+        CK_Offset,   ///< Op0 offset by Imm fields is Op1
+        CK_Alias,    ///< Op0 and Op1 are aliases, defines the merged node
+        CK_FuncCast, ///< the cast Val makes its source and destination function types compatible
+        CK_Call,     ///< the call Val, which is handled when applied because it updates the call graph
+    };
+
+    struct Constraint {
+        ConstraintKind Kind;
+        NodeRef Op0;
+        NodeRef Op1;
+        union {
+            Value *Val;
+            long Imm;
+        };
+    };
+
+private:
+    std::vector<Constraint> Constraints;
+
+    /// a value is wrapped only once in a buffer, its later uses refer to the first CK_Value constraint
+    DenseMap<Value *, NodeRef> ValueRefs;
+
+    NodeRef add(ConstraintKind K, NodeRef Op0, NodeRef Op1, Value *Val) {
+        Constraint C;
+        C.Kind = K;
+        C.Op0 = Op0;
+        C.Op1 = Op1;
+        C.Val = Val;
+        Constraints.push_back(C);
+        return Constraints.size() - 1;
+    }
+
+    NodeRef add(ConstraintKind K, NodeRef Op0, NodeRef Op1, long Imm) {
+        Constraint C;
+        C.Kind = K;
+        C.Op0 = Op0;
+        C.Op1 = Op1;
+        C.Imm = Imm;
+        Constraints.push_back(C);
+        return Constraints.size() - 1;
+    }
+
+public:
+    NodeRef value(Value *V) {
+        auto It = ValueRefs.find(V);
+        if (It != ValueRefs.end())
+            return It->second;
+        return ValueRefs[V] = add(CK_Value, None, None, V);
+    }
+
+    NodeRef deref(NodeRef Address) { return add(CK_Deref, Address, None, nullptr); }
+
+    NodeRef addressOf(NodeRef Val) { return add(CK_AddrOf, Val, None, nullptr); }
+
+    NodeRef ptrTo(NodeRef Address, NodeRef Val) { return add(CK_PtrTo, Address, Val, nullptr); }
+
+    NodeRef field(NodeRef Struct, long FieldIndex, NodeRef Field = None) {
+        return add(CK_Field, Struct, Field, FieldIndex);
+    }
+
+    void offset(NodeRef Ptr, long FieldIndex, NodeRef FieldPtr) { add(CK_Offset, Ptr, FieldPtr, FieldIndex); }
+
+    NodeRef alias(NodeRef X, NodeRef Y) { return add(CK_Alias, X, Y, nullptr); }
+
+    void funcCast(Instruction *Cast) { add(CK_FuncCast, None, None, Cast); }
+
+    void call(CallInst *CallI) { add(CK_Call, None, None, CallI); }
+
+    std::vector<Constraint>::const_iterator begin() const { return Constraints.begin(); }
+
+    std::vector<Constraint>::const_iterator end() const { return Constraints.end(); }
+
+    size_t size() const { return Constraints.size(); }
+
+    bool empty() const { return Constraints.empty(); }
+
+    void clear() {
+        std::vector<Constraint>().swap(Constraints);
+        ValueRefs.clear();
+    }
+};
+
 class AAAnalyzer {
 private:
     Module *Mod;
@@ -54,43 +157,78 @@ private:
     /// @{
     std::map<Type *, FunctionTypeNode *> FunctionTyNodeMap;
     std::set<FunctionTypeNode *> TyRoots;
+    /// the functions that may be called indirectly, numbered densely in the order of the module
+    std::vector<Function *> AddressTakenFunctions;
+    DenseMap<Function *, unsigned> FunctionIds;
     /// @}
 
+    /// Resolves the pointer calls when the classes of their called values change
+    class PointerCallResolver;
+
+    /// non-null only during the inter-procedural analysis
+    PointerCallResolver *Resolver = nullptr;
+
 public:
     AAAnalyzer(Module *, DyckGraph *, DyckCallGraph *);
 
     ~AAAnalyzer();
 
-    void intraProcedureAnalysis();
+    /// If \p CleanFunctions is not null, the constraints of the functions in it are assumed to have been
+    /// applied to the graph already, e.g., by DyckAAState::restore(), only their calls are handled.
+    void intraProcedureAnalysis(const std::set<Function *> *CleanFunctions = nullptr);
 
     void interProcedureAnalysis();
 
+    /// Return a hash of the options that affect the result of the analysis
+    static uint64_t getOptionsHash();
+
+    /// Return false if the options do not support updating a saved result incrementally
+    static bool supportsIncrementalAnalysis();
+
 private:
     void printNoAliasedPointerCalls();
 
-    void handleInst(Instruction *Inst, DyckCallGraphNode *Parent);
+    /// Constraint generation, which does not touch the dyck graph and the call graph
+    /// except for the returns and var args of \p Parent, so that it is safe to run them
+    /// in parallel for different functions.
+    /// @{
+    void handleInst(Instruction *Inst, DyckCallGraphNode *Parent, ConstraintBuffer &CB);
 
-    void handleInstrinsic(Instruction *Inst);
+    void handleInstrinsic(Instruction *Inst, ConstraintBuffer &CB);
 
     void handleExtractInsertValueInst(Value *AggValue, Type *AggTy, ArrayRef<unsigned> &Indices,
-                                      Value *InsertedOrExtractedValue);
+                                      Value *InsertedOrExtractedValue, ConstraintBuffer &CB);
+
+    ConstraintBuffer::NodeRef handleGEP(GEPOperator *, ConstraintBuffer &CB);
+
+    void handleExtractInsertElmtInst(Value *Vec, Value *Elmt, ConstraintBuffer &CB);
+
+    void handleConstant(Constant *C, ConstraintBuffer &CB);
+    /// @}
+
+    /// Apply the constraints to the dyck graph, return the node of \p Result if it is not None
+    DyckGraphNode *applyConstraints(const ConstraintBuffer &CB, DyckCallGraphNode *Parent,
+                                    ConstraintBuffer::NodeRef Result = ConstraintBuffer::None);
 
-    DyckGraphNode *handleGEP(GEPOperator *);
+    /// Apply only the constraints that do not touch the dyck graph, i.e., calls and function casts
+    void applyCallConstraints(const ConstraintBuffer &CB, DyckCallGraphNode *Parent);
 
-    void handleExtractInsertElmtInst(Value *Vec, Value *Elmt);
+    void handleCallInst(CallInst *CallI, DyckCallGraphNode *Parent);
 
     void handleInvokeCallInst(Instruction *Ret, Value *CV, std::vector<Value *> *Args, DyckCallGraphNode *Parent);
 
     void handleLibInvokeCallInst(Value *Ret, Function *F, const std::vector<Value *> *Args, DyckCallGraphNode *Parent);
 
-    bool handlePointerFunctionCalls(DyckCallGraphNode *Caller, int Counter);
+    /// Add \p PCall to \p Parent, and watch it if the indirect calls are being resolved
+    void addPointerCall(PointerCall *PCall, DyckCallGraphNode *Parent);
 
     void handleCommonFunctionCall(Call *, DyckCallGraphNode *Caller, DyckCallGraphNode *Callee);
 
 private:
     int isCompatible(FunctionType *, FunctionType *);
 
-    std::set<Function *> *getCompatibleFunctions(FunctionType *);
+    /// Return the ids of the address-taken functions compatible with \p FTy
+    const SparseBitVector<> &getCompatibleFunctions(FunctionType *FTy);
 
     FunctionTypeNode *initFunctionGroup(FunctionType *);
 
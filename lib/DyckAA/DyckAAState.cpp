@@ -0,0 +1,958 @@
+/*
+ *  Canary features a fast unification-based alias analysis for C programs
+ *  Copyright (C) 2021 Qingkai Shi <qingkaishi@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Metadata.h>
+#include <llvm/Support/Endian.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+#include <algorithm>
+
+#include "DyckAAState.h"
+#include "DyckAA/DyckGraphEdgeLabel.h"
+#include "Support/DisjointSet.h"
+
+using namespace llvm::support;
+
+namespace {
+/// The file is made up of a header, the headers of sections, and the sections. All the integers are
+/// little-endian, and each section is an array of fixed-size entries starting at an 8-byte boundary,
+/// so that the file can be mapped into memory and read in place. Values are referred to by their ids,
+/// i.e., indices of their keys (see DyckValueKeys) in SK_Keys.
+const char FileMagic[8] = {'D', 'Y', 'C', 'K', 'A', 'A', 'S', 'T'};
+const uint32_t FileVersion = 2;
+const uint32_t NoIndex = UINT32_MAX;
+
+enum SectionKind {
+    SK_Strings,            ///< NUL-terminated strings
+    SK_Keys,               ///< offsets of the keys of values in SK_Strings, indexed by value ids
+    SK_Labels,             ///< LabelEntry
+    SK_Vertices,           ///< VertexEntry
+    SK_VertexValues,       ///< value ids, grouped by vertices
+    SK_Edges,              ///< EdgeEntry, grouped by source vertices
+    SK_Functions,          ///< FunctionEntry
+    SK_FunctionComponents, ///< components, grouped by functions
+    SK_CallGraphNodes,     ///< CallGraphNodeEntry
+    SK_Calls,              ///< CallEntry, in the order of their creation
+    SK_CallValues,         ///< value ids of returns, var args, call arguments and callees
+    SK_CallRecords,        ///< CallRecordEntry, grouped by callers
+    SK_NumSections
+};
+
+struct FileHeader {
+    char Magic[8];
+    ulittle32_t Version;
+    ulittle32_t NumSections;
+    ulittle64_t ModuleHash;
+    ulittle32_t NumComponents;
+    ulittle32_t Reserved;
+};
+
+struct SectionHeader {
+    ulittle64_t Offset;
+    ulittle64_t Size;
+};
+
+struct LabelEntry {
+    ulittle32_t Kind;
+    ulittle32_t Reserved;
+    little64_t Value;
+};
+
+struct VertexEntry {
+    ulittle32_t FirstValue;
+    ulittle32_t NumValues;
+    ulittle32_t FirstEdge;
+    ulittle32_t NumEdges;
+    ulittle32_t Component;
+};
+
+struct EdgeEntry {
+    ulittle32_t Label;
+    ulittle32_t Target;
+};
+
+struct FunctionEntry {
+    ulittle64_t Hash;
+    ulittle32_t Name;
+    ulittle32_t FirstComponent;
+    ulittle32_t NumComponents;
+    ulittle32_t Reserved;
+};
+
+struct CallGraphNodeEntry {
+    ulittle32_t Function; ///< NoIndex for the external calling node
+    ulittle32_t FirstRet;
+    ulittle32_t NumRets;
+    ulittle32_t FirstVAArg;
+    ulittle32_t NumVAArgs;
+    ulittle32_t FirstRecord;
+    ulittle32_t NumRecords;
+    ulittle32_t Reserved;
+};
+
+struct CallEntry {
+    ulittle32_t Kind;
+    ulittle32_t Caller;
+    ulittle32_t Inst; ///< NoIndex for implicit calls
+    ulittle32_t CalledValue;
+    ulittle32_t FirstArg;
+    ulittle32_t NumArgs;
+    ulittle32_t FirstCallee; ///< may-aliased callees of pointer calls
+    ulittle32_t NumCallees;
+};
+
+struct CallRecordEntry {
+    ulittle32_t Call; ///< NoIndex for the calls from the external calling node
+    ulittle32_t Callee;
+};
+
+const FileHeader *getHeader(const MemoryBuffer &Buf) {
+    return reinterpret_cast<const FileHeader *>(Buf.getBufferStart());
+}
+
+template<class EntryTy>
+ArrayRef<EntryTy> getSection(const MemoryBuffer &Buf, SectionKind K) {
+    auto *Sections = reinterpret_cast<const SectionHeader *>(Buf.getBufferStart() + sizeof(FileHeader));
+    return {reinterpret_cast<const EntryTy *>(Buf.getBufferStart() + Sections[K].Offset),
+            (size_t) (Sections[K].Size / sizeof(EntryTy))};
+}
+
+bool inRange(uint64_t First, uint64_t Num, uint64_t Bound) { return First + Num <= Bound; }
+
+bool isIndexOrNone(uint32_t Idx, uint64_t Bound) { return Idx == NoIndex || Idx < Bound; }
+
+/// check that the file is not truncated and that all the indices in the file are in range
+bool validate(const MemoryBuffer &Buf) {
+    if (Buf.getBufferSize() < sizeof(FileHeader) + SK_NumSections * sizeof(SectionHeader)) return false;
+    auto *Header = getHeader(Buf);
+    if (memcmp(Header->Magic, FileMagic, sizeof(FileMagic)) != 0 || Header->Version != FileVersion ||
+        Header->NumSections != SK_NumSections)
+        return false;
+
+    static const size_t EntrySizes[SK_NumSections] = {
+            1, sizeof(ulittle32_t), sizeof(LabelEntry), sizeof(VertexEntry), sizeof(ulittle32_t), sizeof(EdgeEntry),
+            sizeof(FunctionEntry), sizeof(ulittle32_t), sizeof(CallGraphNodeEntry), sizeof(CallEntry),
+            sizeof(ulittle32_t), sizeof(CallRecordEntry)
+    };
+    auto *Sections = reinterpret_cast<const SectionHeader *>(Buf.getBufferStart() + sizeof(FileHeader));
+    for (unsigned K = 0; K < SK_NumSections; ++K) {
+        uint64_t Offset = Sections[K].Offset, Size = Sections[K].Size;
+        if (Offset % 8 || Offset > Buf.getBufferSize() || Size > Buf.getBufferSize() - Offset ||
+            Size % EntrySizes[K])
+            return false;
+    }
+
+    auto Strings = getSection<char>(Buf, SK_Strings);
+    auto Keys = getSection<ulittle32_t>(Buf, SK_Keys);
+    auto Labels = getSection<LabelEntry>(Buf, SK_Labels);
+    auto Vertices = getSection<VertexEntry>(Buf, SK_Vertices);
+    auto VertexValues = getSection<ulittle32_t>(Buf, SK_VertexValues);
+    auto Edges = getSection<EdgeEntry>(Buf, SK_Edges);
+    auto Functions = getSection<FunctionEntry>(Buf, SK_Functions);
+    auto Components = getSection<ulittle32_t>(Buf, SK_FunctionComponents);
+    auto Nodes = getSection<CallGraphNodeEntry>(Buf, SK_CallGraphNodes);
+    auto Calls = getSection<CallEntry>(Buf, SK_Calls);
+    auto CallValues = getSection<ulittle32_t>(Buf, SK_CallValues);
+    auto Records = getSection<CallRecordEntry>(Buf, SK_CallRecords);
+    if (!Strings.empty() && Strings.back() != '\0') return false;
+    for (auto &Str: Keys)
+        if (Str >= Strings.size()) return false;
+    for (auto &L: Labels)
+        if (L.Kind > DyckGraphEdgeLabel::LT_Index) return false;
+    for (auto &V: Vertices)
+        if (V.Component >= Header->NumComponents || !inRange(V.FirstValue, V.NumValues, VertexValues.size()) ||
+            !inRange(V.FirstEdge, V.NumEdges, Edges.size()))
+            return false;
+    for (auto &Val: VertexValues)
+        if (Val >= Keys.size()) return false;
+    for (auto &E: Edges)
+        if (E.Label >= Labels.size() || E.Target >= Vertices.size()) return false;
+    for (auto &F: Functions)
+        if (F.Name >= Strings.size() || !inRange(F.FirstComponent, F.NumComponents, Components.size())) return false;
+    for (auto &C: Components)
+        if (C >= Header->NumComponents) return false;
+    for (auto &N: Nodes)
+        if (!isIndexOrNone(N.Function, Keys.size()) || !inRange(N.FirstRet, N.NumRets, CallValues.size()) ||
+            !inRange(N.FirstVAArg, N.NumVAArgs, CallValues.size()) ||
+            !inRange(N.FirstRecord, N.NumRecords, Records.size()))
+            return false;
+    for (auto &C: Calls)
+        if (C.Kind > Call::CK_Pointer || C.Caller >= Nodes.size() || !isIndexOrNone(C.Inst, Keys.size()) ||
+            C.CalledValue >= Keys.size() || !inRange(C.FirstArg, C.NumArgs, CallValues.size()) ||
+            !inRange(C.FirstCallee, C.NumCallees, CallValues.size()))
+            return false;
+    for (auto &Val: CallValues)
+        if (Val >= Keys.size()) return false;
+    for (auto &R: Records)
+        if (!isIndexOrNone(R.Call, Calls.size()) || R.Callee >= Nodes.size()) return false;
+    return true;
+}
+
+/// append an entry to a section
+template<class EntryTy>
+void append(std::string &Section, const EntryTy &Entry) {
+    Section.append(reinterpret_cast<const char *>(&Entry), sizeof(EntryTy));
+}
+
+/// append a string to the string section, and return its offset
+uint32_t appendString(std::string &Strings, StringRef Str) {
+    uint32_t Offset = Strings.size();
+    Strings.append(Str.data(), Str.size());
+    Strings.push_back('\0');
+    return Offset;
+}
+
+/// append the bytes of an integer to the data to hash
+template<class IntTy>
+void appendBytes(std::string &Data, IntTy Val) {
+    static_assert(std::is_integral<IntTy>::value || std::is_enum<IntTy>::value, "Not an integer!");
+    Data.append(reinterpret_cast<const char *>(&Val), sizeof(IntTy));
+}
+
+/// append a string to the data to hash
+void appendStr(std::string &Data, StringRef Str) {
+    appendBytes(Data, (uint32_t) Str.size());
+    Data.append(Str.data(), Str.size());
+}
+} // end of anonymous namespace
+
+DyckValueKeys::DyckValueKeys(Module *M) : M(M), MST(M) {
+    for (auto &GV: M->global_values()) {
+        if (GV.hasName()) continue;
+        UnnamedGlobalIndices[&GV] = UnnamedGlobals.size();
+        UnnamedGlobals.push_back(&GV);
+    }
+}
+
+const std::vector<Value *> &DyckValueKeys::getLocals(const Function *F) {
+    auto It = Locals.find(F);
+    if (It != Locals.end()) return It->second;
+
+    std::vector<Value *> Values;
+    for (auto &Arg: F->args()) Values.push_back(const_cast<Argument *>(&Arg));
+    for (auto &BB: *F) {
+        Values.push_back(const_cast<BasicBlock *>(&BB));
+        for (auto &I: BB) Values.push_back(const_cast<Instruction *>(&I));
+    }
+    for (unsigned K = 0; K < Values.size(); ++K) LocalIndices[Values[K]] = K;
+    return Locals[F] = std::move(Values);
+}
+
+uint64_t DyckValueKeys::hashType(Type *Ty) {
+    auto It = TypeHashes.find(Ty);
+    if (It != TypeHashes.end()) return It->second;
+
+    std::string Name;
+    raw_string_ostream OS(Name);
+    Ty->print(OS, false, true);
+    OS.flush();
+    return TypeHashes[Ty] = xxHash64(Name);
+}
+
+uint64_t DyckValueKeys::hashConstant(Constant *C) {
+    auto It = ConstantHashes.find(C);
+    if (It != ConstantHashes.end()) return It->second;
+
+    std::string Data;
+    appendBytes(Data, (uint32_t) C->getValueID());
+    appendBytes(Data, hashType(C->getType()));
+    if (isa<GlobalValue>(C)) {
+        appendStr(Data, getKey(C));
+    } else if (auto *CI = dyn_cast<ConstantInt>(C)) {
+        auto &Val = CI->getValue();
+        for (unsigned K = 0; K < Val.getNumWords(); ++K) appendBytes(Data, Val.getRawData()[K]);
+    } else if (auto *CFP = dyn_cast<ConstantFP>(C)) {
+        auto Val = CFP->getValueAPF().bitcastToAPInt();
+        for (unsigned K = 0; K < Val.getNumWords(); ++K) appendBytes(Data, Val.getRawData()[K]);
+    } else if (auto *CDS = dyn_cast<ConstantDataSequential>(C)) {
+        appendStr(Data, CDS->getRawDataValues());
+    } else {
+        if (auto *CE = dyn_cast<ConstantExpr>(C)) {
+            appendBytes(Data, CE->getOpcode());
+            if (CE->isCompare()) appendBytes(Data, CE->getPredicate());
+            if (CE->hasIndices())
+                for (auto Idx: CE->getIndices()) appendBytes(Data, Idx);
+            if (auto *GEP = dyn_cast<GEPOperator>(CE)) appendBytes(Data, hashType(GEP->getSourceElementType()));
+        }
+        for (auto &Op: C->operands()) {
+            if (auto *OpC = dyn_cast<Constant>(Op)) appendBytes(Data, hashConstant(OpC));
+            else appendStr(Data, getKey(Op)); // e.g., the block of a block address
+        }
+    }
+    return ConstantHashes[C] = xxHash64(Data);
+}
+
+const std::string &DyckValueKeys::getOtherKey(Value *V) {
+    auto It = OtherKeys.find(V);
+    if (It != OtherKeys.end()) return It->second;
+
+    std::string Key("$");
+    raw_string_ostream OS(Key);
+    V->printAsOperand(OS, true, MST);
+    OS.flush();
+    return OtherKeys[V] = std::move(Key);
+}
+
+unsigned DyckValueKeys::getLocalIndex(Value *V) {
+    const Function *F = nullptr;
+    if (auto *Arg = dyn_cast<Argument>(V)) F = Arg->getParent();
+    else if (auto *BB = dyn_cast<BasicBlock>(V)) F = BB->getParent();
+    else if (auto *Inst = dyn_cast<Instruction>(V)) F = Inst->getFunction();
+    assert(F && "Not a local value!");
+    getLocals(F);
+    return LocalIndices.lookup(V);
+}
+
+void DyckValueKeys::writeKey(raw_ostream &OS, Value *V) {
+    if (auto *GV = dyn_cast<GlobalValue>(V)) {
+        if (GV->hasName()) OS << '@' << GV->getName();
+        else OS << "@#" << UnnamedGlobalIndices.lookup(GV);
+        return;
+    }
+
+    const Function *F = nullptr;
+    if (auto *Arg = dyn_cast<Argument>(V)) F = Arg->getParent();
+    else if (auto *BB = dyn_cast<BasicBlock>(V)) F = BB->getParent();
+    else if (auto *Inst = dyn_cast<Instruction>(V)) F = Inst->getFunction();
+    if (F) {
+        getLocals(F);
+        OS << '%' << LocalIndices.lookup(V);
+        writeKey(OS, const_cast<Function *>(F));
+        return;
+    }
+    if (auto *MV = dyn_cast<MetadataAsValue>(V)) {
+        // the names of local values in metadata are not unique in a module
+        if (auto *LM = dyn_cast<LocalAsMetadata>(MV->getMetadata())) {
+            OS << '!';
+            writeKey(OS, LM->getValue());
+            return;
+        }
+    }
+    // constants are keyed by hashes, because printing them with a slot tracker of the module is slow
+    if (auto *C = dyn_cast<Constant>(V)) {
+        OS << '#' << format_hex_no_prefix(hashConstant(C), 16);
+        return;
+    }
+    OS << getOtherKey(V);
+}
+
+std::string DyckValueKeys::getKey(Value *V) {
+    std::string Key;
+    raw_string_ostream OS(Key);
+    writeKey(OS, V);
+    return OS.str();
+}
+
+void DyckValueKeys::collectOtherValues(Value *V) {
+    if (isa<GlobalValue>(V) || isa<Argument>(V) || isa<BasicBlock>(V) || isa<Instruction>(V)) return;
+    if (!CollectedValues.insert(V).second) return;
+    if (auto *MV = dyn_cast<MetadataAsValue>(V)) {
+        if (isa<LocalAsMetadata>(MV->getMetadata())) return;
+    }
+
+    if (auto *C = dyn_cast<Constant>(V)) {
+        // two hashes are reserved by the map, with which the constants cannot be found
+        uint64_t Hash = hashConstant(C);
+        if (Hash < UINT64_MAX - 1) {
+            auto Ret = Constants.insert(std::make_pair(Hash, C));
+            if (!Ret.second && Ret.first->second != C) Ret.first->second = nullptr;
+        }
+        for (auto &Op: C->operands()) collectOtherValues(Op);
+    } else {
+        auto Ret = OtherValues.insert(std::make_pair(getOtherKey(V), V));
+        if (!Ret.second && Ret.first->second != V) Ret.first->second = nullptr;
+    }
+}
+
+Value *DyckValueKeys::getValue(StringRef Key) {
+    if (Key.empty()) return nullptr;
+    switch (Key[0]) {
+        case '@': {
+            unsigned Idx;
+            if (Key.startswith("@#") && !Key.drop_front(2).getAsInteger(10, Idx))
+                return Idx < UnnamedGlobals.size() ? UnnamedGlobals[Idx] : nullptr;
+            return M->getNamedValue(Key.drop_front());
+        }
+        case '%': {
+            auto Pos = Key.find('@');
+            unsigned Idx;
+            if (Pos == StringRef::npos || Key.slice(1, Pos).getAsInteger(10, Idx)) return nullptr;
+            auto *F = dyn_cast_or_null<Function>(getValue(Key.drop_front(Pos)));
+            if (!F) return nullptr;
+            auto &Values = getLocals(F);
+            return Idx < Values.size() ? Values[Idx] : nullptr;
+        }
+        case '!': {
+            auto *Local = getValue(Key.drop_front());
+            if (!Local) return nullptr;
+            if (auto *LM = LocalAsMetadata::getIfExists(Local))
+                return MetadataAsValue::getIfExists(M->getContext(), LM);
+            return nullptr;
+        }
+        case '#':
+        case '$': {
+            if (!OtherValuesCollected) {
+                OtherValuesCollected = true;
+                for (auto &GV: M->globals())
+                    if (GV.hasInitializer()) collectOtherValues(GV.getInitializer());
+                for (auto &GA: M->aliases())
+                    collectOtherValues(GA.getAliasee());
+                for (auto &F: *M)
+                    for (auto &BB: F)
+                        for (auto &I: BB)
+                            for (auto &Op: I.operands()) collectOtherValues(Op);
+            }
+            if (Key[0] == '#') {
+                uint64_t Hash;
+                if (Key.drop_front().getAsInteger(16, Hash) || Hash >= UINT64_MAX - 1) return nullptr;
+                return Constants.lookup(Hash);
+            }
+            auto It = OtherValues.find(Key);
+            return It == OtherValues.end() ? nullptr : It->second;
+        }
+        default:
+            return nullptr;
+    }
+}
+
+DyckAAState::DyckAAState(Module *M, uint64_t OptionsHash) : M(M), Keys(M) {
+    ModuleHash = hashModule(OptionsHash);
+    for (auto &F: *M) FunctionHashes.push_back(hashFunction(F));
+}
+
+uint64_t DyckAAState::hashModule(uint64_t OptionsHash) {
+    // everything but the function bodies
+    std::string Data;
+    appendBytes(Data, FileVersion);
+    appendBytes(Data, OptionsHash);
+    appendStr(Data, M->getDataLayoutStr());
+    for (auto *STy: M->getIdentifiedStructTypes()) {
+        std::string Body;
+        raw_string_ostream OS(Body);
+        STy->print(OS);
+        appendStr(Data, OS.str());
+    }
+    for (auto &GV: M->globals()) {
+        appendBytes(Data, Keys.hashConstant(&GV));
+        appendBytes(Data, Keys.hashType(GV.getValueType()));
+        appendBytes(Data, (uint32_t) GV.getLinkage());
+        appendBytes(Data, (uint8_t) GV.isConstant());
+        appendBytes(Data, GV.hasInitializer() ? Keys.hashConstant(GV.getInitializer()) : 0);
+    }
+    for (auto &GA: M->aliases()) {
+        appendBytes(Data, Keys.hashConstant(&GA));
+        appendBytes(Data, Keys.hashConstant(GA.getAliasee()));
+    }
+    return xxHash64(Data);
+}
+
+uint64_t DyckAAState::hashFunction(Function &F) {
+    std::string Data;
+    auto AppendOperand = [this, &Data](Value *Op) {
+        if (auto *C = dyn_cast<Constant>(Op)) {
+            appendBytes(Data, Keys.hashConstant(C));
+            return;
+        }
+        if (auto *MV = dyn_cast<MetadataAsValue>(Op)) {
+            // only the local values wrapped in metadata matter
+            if (auto *LM = dyn_cast<LocalAsMetadata>(MV->getMetadata())) Op = LM->getValue();
+            else return appendBytes(Data, (uint32_t) UINT32_MAX);
+        }
+        if (isa<Argument>(Op) || isa<BasicBlock>(Op) || isa<Instruction>(Op))
+            appendBytes(Data, Keys.getLocalIndex(Op));
+        else
+            appendStr(Data, Keys.getKey(Op)); // e.g., inline asm
+    };
+
+    appendBytes(Data, Keys.hashConstant(&F));
+    appendBytes(Data, (uint8_t) F.isDeclaration());
+    for (auto &BB: F) {
+        appendBytes(Data, (uint32_t) BB.size());
+        for (auto &I: BB) {
+            appendBytes(Data, I.getOpcode());
+            appendBytes(Data, Keys.hashType(I.getType()));
+            appendBytes(Data, I.getNumOperands());
+            for (auto &Op: I.operands()) AppendOperand(Op);
+
+            // the information not in operands
+            if (auto *Phi = dyn_cast<PHINode>(&I)) {
+                for (auto *Incoming: Phi->blocks()) AppendOperand(Incoming);
+            } else if (auto *EV = dyn_cast<ExtractValueInst>(&I)) {
+                for (auto Idx: EV->indices()) appendBytes(Data, Idx);
+            } else if (auto *IV = dyn_cast<InsertValueInst>(&I)) {
+                for (auto Idx: IV->indices()) appendBytes(Data, Idx);
+            } else if (auto *Alloca = dyn_cast<AllocaInst>(&I)) {
+                appendBytes(Data, Keys.hashType(Alloca->getAllocatedType()));
+            } else if (auto *GEP = dyn_cast<GetElementPtrInst>(&I)) {
+                appendBytes(Data, Keys.hashType(GEP->getSourceElementType()));
+            } else if (auto *CB = dyn_cast<CallBase>(&I)) {
+                appendBytes(Data, Keys.hashType(CB->getFunctionType()));
+            } else if (auto *Cmp = dyn_cast<CmpInst>(&I)) {
+                appendBytes(Data, Cmp->getPredicate());
+            }
+        }
+    }
+    return xxHash64(Data);
+}
+
+bool DyckAAState::read(StringRef File) {
+    auto BufOrErr = MemoryBuffer::getFile(File, false, false);
+    if (!BufOrErr) return false;
+    Buffer = std::move(BufOrErr.get());
+    if (!validate(*Buffer) || getHeader(*Buffer)->ModuleHash != ModuleHash) {
+        Buffer.reset();
+        return false;
+    }
+    auto KeyOffsets = getSection<ulittle32_t>(*Buffer, SK_Keys);
+    ResolvedValues.assign(KeyOffsets.size(), nullptr);
+    Resolved.clear();
+    Resolved.resize(KeyOffsets.size());
+    return true;
+}
+
+Value *DyckAAState::resolve(uint32_t Id) {
+    if (!Resolved.test(Id)) {
+        auto Strings = getSection<char>(*Buffer, SK_Strings);
+        auto KeyOffsets = getSection<ulittle32_t>(*Buffer, SK_Keys);
+        ResolvedValues[Id] = Keys.getValue(StringRef(Strings.data() + KeyOffsets[Id]));
+        Resolved.set(Id);
+    }
+    return ResolvedValues[Id];
+}
+
+void DyckAAState::restoreGraph(DyckGraph *G, const BitVector &Invalid) {
+    auto Labels = getSection<LabelEntry>(*Buffer, SK_Labels);
+    auto Vertices = getSection<VertexEntry>(*Buffer, SK_Vertices);
+    auto VertexValues = getSection<ulittle32_t>(*Buffer, SK_VertexValues);
+    auto Edges = getSection<EdgeEntry>(*Buffer, SK_Edges);
+
+    std::vector<DyckGraphEdgeLabel *> RestoredLabels;
+    for (auto &L: Labels) {
+        switch (L.Kind) {
+            case DyckGraphEdgeLabel::LT_Dereference:
+                RestoredLabels.push_back(G->getDereferenceEdgeLabel());
+                break;
+            case DyckGraphEdgeLabel::LT_Offset:
+                RestoredLabels.push_back(G->getOrInsertOffsetEdgeLabel(L.Value));
+                break;
+            default:
+                RestoredLabels.push_back(G->getOrInsertIndexEdgeLabel(L.Value));
+                break;
+        }
+    }
+
+    std::vector<DyckGraphNode *> RestoredVertices(Vertices.size(), nullptr);
+    std::vector<void *> Vals;
+    for (unsigned K = 0; K < Vertices.size(); ++K) {
+        auto &V = Vertices[K];
+        if (Invalid.test(V.Component)) continue;
+        Vals.clear();
+        for (unsigned J = V.FirstValue; J < V.FirstValue + V.NumValues; ++J) Vals.push_back(resolve(VertexValues[J]));
+        RestoredVertices[K] = G->restoreVertex(Vals);
+    }
+    for (unsigned K = 0; K < Vertices.size(); ++K) {
+        auto *Source = RestoredVertices[K];
+        if (!Source) continue;
+        for (unsigned J = Vertices[K].FirstEdge; J < Vertices[K].FirstEdge + Vertices[K].NumEdges; ++J) {
+            // the source and the target of an edge are always in the same component
+            if (auto *Target = RestoredVertices[Edges[J].Target])
+                Source->addTarget(Target, RestoredLabels[Edges[J].Label]);
+        }
+    }
+}
+
+void DyckAAState::restore(DyckGraph *G, std::set<Function *> &CleanFunctions) {
+    assert(Buffer && "The state has not been read!");
+    auto Strings = getSection<char>(*Buffer, SK_Strings);
+    auto Vertices = getSection<VertexEntry>(*Buffer, SK_Vertices);
+    auto VertexValues = getSection<ulittle32_t>(*Buffer, SK_VertexValues);
+    auto Functions = getSection<FunctionEntry>(*Buffer, SK_Functions);
+    auto Components = getSection<ulittle32_t>(*Buffer, SK_FunctionComponents);
+
+    // the components touched by the changed (including the new and the deleted) functions are invalid
+    BitVector Invalid(getHeader(*Buffer)->NumComponents);
+    auto Invalidate = [&Invalid, &Components](const FunctionEntry &Entry) {
+        for (unsigned K = 0; K < Entry.NumComponents; ++K) Invalid.set(Components[Entry.FirstComponent + K]);
+    };
+    StringMap<unsigned> SavedFunctions;
+    for (unsigned K = 0; K < Functions.size(); ++K) SavedFunctions[Strings.data() + Functions[K].Name] = K;
+    BitVector Matched(Functions.size());
+    std::vector<std::pair<Function *, const FunctionEntry *>> Unchanged;
+    unsigned NumChanged = 0;
+    unsigned FIdx = 0;
+    for (auto &F: *M) {
+        uint64_t Hash = FunctionHashes[FIdx++];
+        auto It = SavedFunctions.find(Keys.getKey(&F));
+        if (It != SavedFunctions.end()) {
+            Matched.set(It->second);
+            if (Functions[It->second].Hash == Hash) {
+                Unchanged.emplace_back(&F, &Functions[It->second]);
+                continue;
+            }
+            Invalidate(Functions[It->second]);
+        }
+        ++NumChanged;
+    }
+    for (unsigned K = 0; K < Functions.size(); ++K) {
+        if (!Matched.test(K)) Invalidate(Functions[K]);
+    }
+
+    // a component is also invalid if any of its values is not found in the module
+    DenseMap<Value *, unsigned> ValueComponents;
+    for (auto &V: Vertices) {
+        if (Invalid.test(V.Component)) continue;
+        for (unsigned K = V.FirstValue; K < V.FirstValue + V.NumValues; ++K) {
+            auto *Val = resolve(VertexValues[K]);
+            if (!Val) {
+                Invalid.set(V.Component);
+                break;
+            }
+            auto Ret = ValueComponents.insert(std::make_pair(Val, V.Component));
+            if (!Ret.second) {
+                // the same value for two keys, which is not expected
+                Invalid.set(V.Component);
+                Invalid.set(Ret.first->second);
+                break;
+            }
+        }
+    }
+    restoreGraph(G, Invalid);
+
+    for (auto &FuncPair: Unchanged) {
+        auto &Entry = *FuncPair.second;
+        bool Clean = true;
+        for (unsigned K = 0; K < Entry.NumComponents && Clean; ++K)
+            Clean = !Invalid.test(Components[Entry.FirstComponent + K]);
+        if (Clean) CleanFunctions.insert(FuncPair.first);
+    }
+
+    DEBUG_WITH_TYPE("dyckaa-stats", errs() << "# Changed functions: " << NumChanged << "\n");
+    DEBUG_WITH_TYPE("dyckaa-stats", errs() << "# Clean functions: " << CleanFunctions.size() << "\n");
+    DEBUG_WITH_TYPE("dyckaa-stats", errs() << "# Restored components: " << Invalid.size() - Invalid.count()
+                                           << "/" << Invalid.size() << "\n");
+    Buffer.reset();
+}
+
+bool DyckAAState::load(DyckGraph *G, DyckCallGraph *CG) {
+    assert(Buffer && "The state has not been read!");
+    auto Strings = getSection<char>(*Buffer, SK_Strings);
+    auto KeyOffsets = getSection<ulittle32_t>(*Buffer, SK_Keys);
+    auto Functions = getSection<FunctionEntry>(*Buffer, SK_Functions);
+    auto Nodes = getSection<CallGraphNodeEntry>(*Buffer, SK_CallGraphNodes);
+    auto Calls = getSection<CallEntry>(*Buffer, SK_Calls);
+    auto CallValues = getSection<ulittle32_t>(*Buffer, SK_CallValues);
+    auto Records = getSection<CallRecordEntry>(*Buffer, SK_CallRecords);
+
+    // the state must be saved for exactly the same module, and every value must be found,
+    // which are checked before the graphs are touched
+    bool Loadable = Functions.size() == M->size();
+    unsigned FIdx = 0;
+    for (auto &F: *M) {
+        if (!Loadable) break;
+        auto &Entry = Functions[FIdx];
+        Loadable = Entry.Hash == FunctionHashes[FIdx++] && Strings.data() + Entry.Name == Keys.getKey(&F);
+    }
+    for (unsigned K = 0; K < KeyOffsets.size() && Loadable; ++K) Loadable = resolve(K);
+    if (!Loadable) {
+        Buffer.reset();
+        return false;
+    }
+
+    restoreGraph(G, BitVector(getHeader(*Buffer)->NumComponents));
+
+    std::vector<DyckCallGraphNode *> RestoredNodes;
+    for (auto &N: Nodes) {
+        auto *F = N.Function == NoIndex ? nullptr : cast<Function>(resolve(N.Function));
+        auto *Node = F ? CG->restoreFunction(F) : CG->getFunction(nullptr);
+        for (unsigned K = N.FirstRet; K < N.FirstRet + N.NumRets; ++K) Node->addRet(resolve(CallValues[K]));
+        for (unsigned K = N.FirstVAArg; K < N.FirstVAArg + N.NumVAArgs; ++K) Node->addVAArg(resolve(CallValues[K]));
+        RestoredNodes.push_back(Node);
+    }
+
+    // calls are created in the original order, so that their ids are the same as before
+    std::vector<Call *> RestoredCalls;
+    std::vector<Value *> Args;
+    for (auto &C: Calls) {
+        auto *Inst = C.Inst == NoIndex ? nullptr : cast<Instruction>(resolve(C.Inst));
+        Args.clear();
+        for (unsigned K = C.FirstArg; K < C.FirstArg + C.NumArgs; ++K) Args.push_back(resolve(CallValues[K]));
+        if (C.Kind == Call::CK_Common) {
+            auto *CC = CG->createCommonCall(Inst, cast<Function>(resolve(C.CalledValue)), &Args);
+            RestoredNodes[C.Caller]->addCommonCall(CC);
+            RestoredCalls.push_back(CC);
+        } else {
+            auto *PC = CG->createPointerCall(Inst, resolve(C.CalledValue), &Args);
+            for (unsigned K = C.FirstCallee; K < C.FirstCallee + C.NumCallees; ++K)
+                PC->addMayAliasedFunction(cast<Function>(resolve(CallValues[K])));
+            RestoredNodes[C.Caller]->addPointerCall(PC);
+            RestoredCalls.push_back(PC);
+        }
+    }
+
+    for (unsigned K = 0; K < Nodes.size(); ++K) {
+        for (unsigned J = Nodes[K].FirstRecord; J < Nodes[K].FirstRecord + Nodes[K].NumRecords; ++J) {
+            auto &R = Records[J];
+            RestoredNodes[K]->addCalledFunction(R.Call == NoIndex ? nullptr : RestoredCalls[R.Call],
+                                                RestoredNodes[R.Callee]);
+        }
+    }
+
+    DEBUG_WITH_TYPE("dyckaa-stats", errs() << "# Loaded vertices: " << getSection<VertexEntry>(*Buffer, SK_Vertices).size()
+                                           << "\n");
+    DEBUG_WITH_TYPE("dyckaa-stats", errs() << "# Loaded calls: " << Calls.size() << "\n");
+    Buffer.reset();
+    return true;
+}
+
+bool DyckAAState::write(StringRef File, DyckGraph *G, DyckCallGraph *CG) {
+    auto &Vertices = G->getVertices();
+
+    // components
+    IndexedDisjointSet ComponentSet;
+    for (unsigned K = 0; K < Vertices.size(); ++K) ComponentSet.makeSet();
+    for (auto *N: Vertices) {
+        for (auto &Out: N->getOutVertices())
+            for (auto Target: Out.Nodes) ComponentSet.doUnion(N->getIndex(), Target);
+    }
+    auto Union = [G, &ComponentSet](Value *X, Value *Y) {
+        auto *NX = G->findDyckVertex(X);
+        auto *NY = G->findDyckVertex(Y);
+        if (NX && NY) ComponentSet.doUnion(NX->getIndex(), NY->getIndex());
+    };
+    for (auto *CGNode: make_range(CG->nodes_begin(), CG->nodes_end())) {
+        for (auto *PC: make_range(CGNode->pointer_call_begin(), CGNode->pointer_call_end())) {
+            for (auto *Arg: PC->getArgs()) Union(PC->getCalledValue(), Arg);
+            if (PC->getInstruction()) Union(PC->getCalledValue(), PC->getInstruction());
+        }
+    }
+    for (auto *Val: G->getValues()) {
+        if (auto *GV = dyn_cast<GlobalVariable>((Value *) Val)) {
+            if (GV->hasInitializer()) Union(GV, GV->getInitializer());
+        } else if (auto *GA = dyn_cast<GlobalAlias>((Value *) Val)) {
+            Union(GA, GA->getAliasee());
+        } else if (auto *C = dyn_cast<Constant>((Value *) Val)) {
+            if (isa<GlobalValue>(C)) continue;
+            for (auto &Op: C->operands()) Union(C, Op);
+        }
+    }
+    std::vector<uint32_t> ComponentIds(Vertices.size(), NoIndex);
+    uint32_t NumComponents = 0;
+    for (unsigned K = 0; K < Vertices.size(); ++K) {
+        auto &Id = ComponentIds[ComponentSet.findSet(K)];
+        if (Id == NoIndex) Id = NumComponents++;
+        ComponentIds[K] = Id;
+    }
+
+    std::string Sections[SK_NumSections];
+    DenseMap<Value *, uint32_t> ValueIds;
+    auto GetId = [this, &Sections, &ValueIds](Value *V) -> uint32_t {
+        auto It = ValueIds.find(V);
+        if (It != ValueIds.end()) return It->second;
+        append(Sections[SK_Keys], ulittle32_t(appendString(Sections[SK_Strings], Keys.getKey(V))));
+        uint32_t Id = ValueIds.size();
+        return ValueIds[V] = Id;
+    };
+
+    for (unsigned K = 0; K < G->numEdgeLabels(); ++K) {
+        auto *Label = G->getEdgeLabel(K);
+        LabelEntry Entry;
+        Entry.Reserved = 0;
+        if (Label->isLabelTy(DyckGraphEdgeLabel::LT_Offset)) {
+            Entry.Kind = DyckGraphEdgeLabel::LT_Offset;
+            Entry.Value = ((PointerOffsetEdgeLabel *) Label)->getOffsetBytes();
+        } else if (Label->isLabelTy(DyckGraphEdgeLabel::LT_Index)) {
+            Entry.Kind = DyckGraphEdgeLabel::LT_Index;
+            Entry.Value = ((FieldIndexEdgeLabel *) Label)->getFieldIndex();
+        } else {
+            Entry.Kind = DyckGraphEdgeLabel::LT_Dereference;
+            Entry.Value = 0;
+        }
+        append(Sections[SK_Labels], Entry);
+    }
+
+    uint32_t NumValues = 0, NumEdges = 0;
+    std::vector<void *> Vals;
+    for (auto *N: Vertices) {
+        Vals.clear();
+        G->getEquivalentValues(N, Vals);
+        VertexEntry Entry;
+        Entry.FirstValue = NumValues;
+        Entry.NumValues = Vals.size();
+        Entry.FirstEdge = NumEdges;
+        Entry.Component = ComponentIds[N->getIndex()];
+        for (auto *Val: Vals) append(Sections[SK_VertexValues], ulittle32_t(GetId((Value *) Val)));
+        for (auto &Out: N->getOutVertices()) {
+            for (auto Target: Out.Nodes) {
+                EdgeEntry Edge;
+                Edge.Label = Out.Label;
+                Edge.Target = Target;
+                append(Sections[SK_Edges], Edge);
+            }
+            NumEdges += Out.Nodes.size();
+        }
+        NumValues += Vals.size();
+        Entry.NumEdges = NumEdges - Entry.FirstEdge;
+        append(Sections[SK_Vertices], Entry);
+    }
+
+    // the components touched by each function
+    uint32_t NumFunctionComponents = 0;
+    std::vector<uint32_t> Touched;
+    auto Touch = [G, &ComponentIds, &Touched](Value *V) {
+        if (auto *N = G->findDyckVertex(V)) Touched.push_back(ComponentIds[N->getIndex()]);
+    };
+    unsigned FIdx = 0;
+    for (auto &F: *M) {
+        Touched.clear();
+        Touch(&F);
+        for (auto &Arg: F.args()) Touch(&Arg);
+        for (auto &BB: F) {
+            Touch(&BB);
+            for (auto &I: BB) {
+                Touch(&I);
+                for (auto &Op: I.operands()) Touch(Op);
+            }
+        }
+        std::sort(Touched.begin(), Touched.end());
+        Touched.erase(std::unique(Touched.begin(), Touched.end()), Touched.end());
+
+        FunctionEntry Entry;
+        Entry.Hash = FunctionHashes[FIdx++];
+        Entry.Name = appendString(Sections[SK_Strings], Keys.getKey(&F));
+        Entry.FirstComponent = NumFunctionComponents;
+        Entry.NumComponents = Touched.size();
+        Entry.Reserved = 0;
+        append(Sections[SK_Functions], Entry);
+        for (auto Component: Touched) append(Sections[SK_FunctionComponents], ulittle32_t(Component));
+        NumFunctionComponents += Touched.size();
+    }
+
+    // the call graph, whose nodes are ordered as in the module, and calls are ordered by their ids
+    uint32_t NumCallValues = 0;
+    auto AppendCallValue = [&Sections, &NumCallValues, &GetId](Value *V) {
+        append(Sections[SK_CallValues], ulittle32_t(GetId(V)));
+        ++NumCallValues;
+    };
+    std::vector<DyckCallGraphNode *> Nodes;
+    DenseMap<DyckCallGraphNode *, uint32_t> NodeIds;
+    NodeIds[CG->getFunction(nullptr)] = 0;
+    Nodes.push_back(CG->getFunction(nullptr));
+    for (auto &F: *M) {
+        if (auto *Node = CG->getFunction(&F)) {
+            NodeIds[Node] = Nodes.size();
+            Nodes.push_back(Node);
+        }
+    }
+    std::vector<std::pair<Call *, uint32_t>> Calls;
+    for (unsigned K = 0; K < Nodes.size(); ++K) {
+        for (auto *CC: make_range(Nodes[K]->common_call_begin(), Nodes[K]->common_call_end()))
+            Calls.emplace_back(CC, K);
+        for (auto *PC: make_range(Nodes[K]->pointer_call_begin(), Nodes[K]->pointer_call_end()))
+            Calls.emplace_back(PC, K);
+    }
+    std::sort(Calls.begin(), Calls.end(), [](const std::pair<Call *, uint32_t> &X,
+                                             const std::pair<Call *, uint32_t> &Y) {
+        return X.first->id() < Y.first->id();
+    });
+    DenseMap<Call *, uint32_t> CallIds;
+    for (auto &CallPair: Calls) {
+        auto *C = CallPair.first;
+        uint32_t Id = CallIds.size();
+        CallIds[C] = Id;
+        CallEntry Entry;
+        Entry.Kind = C->getKind();
+        Entry.Caller = CallPair.second;
+        Entry.Inst = C->getInstruction() ? GetId(C->getInstruction()) : NoIndex;
+        Entry.CalledValue = GetId(C->getCalledValue());
+        Entry.FirstArg = NumCallValues;
+        for (auto *Arg: C->getArgs()) AppendCallValue(Arg);
+        Entry.NumArgs = NumCallValues - Entry.FirstArg;
+        Entry.FirstCallee = NumCallValues;
+        if (auto *PC = dyn_cast<PointerCall>(C)) {
+            for (auto *Callee: *PC) AppendCallValue(Callee);
+        }
+        Entry.NumCallees = NumCallValues - Entry.FirstCallee;
+        append(Sections[SK_Calls], Entry);
+    }
+    uint32_t NumRecords = 0;
+    for (auto *Node: Nodes) {
+        CallGraphNodeEntry Entry;
+        auto *F = Node->getLLVMFunction();
+        Entry.Function = F ? GetId(F) : NoIndex;
+        Entry.FirstRet = NumCallValues;
+        for (auto *Ret: Node->getReturns()) AppendCallValue(Ret);
+        Entry.NumRets = NumCallValues - Entry.FirstRet;
+        Entry.FirstVAArg = NumCallValues;
+        for (auto *VAArg: Node->getVAArgs()) AppendCallValue(VAArg);
+        Entry.NumVAArgs = NumCallValues - Entry.FirstVAArg;
+        Entry.FirstRecord = NumRecords;
+        for (auto &Record: make_range(Node->child_edge_begin(), Node->child_edge_end())) {
+            CallRecordEntry R;
+            R.Call = Record.first ? CallIds.lookup(Record.first) : NoIndex;
+            R.Callee = NodeIds.lookup(Record.second);
+            append(Sections[SK_CallRecords], R);
+            ++NumRecords;
+        }
+        Entry.NumRecords = NumRecords - Entry.FirstRecord;
+        Entry.Reserved = 0;
+        append(Sections[SK_CallGraphNodes], Entry);
+    }
+
+    // layout
+    FileHeader Header;
+    memcpy(Header.Magic, FileMagic, sizeof(FileMagic));
+    Header.Version = FileVersion;
+    Header.NumSections = SK_NumSections;
+    Header.ModuleHash = ModuleHash;
+    Header.NumComponents = NumComponents;
+    Header.Reserved = 0;
+    std::string Content;
+    append(Content, Header);
+    uint64_t Offset = alignTo(sizeof(FileHeader) + SK_NumSections * sizeof(SectionHeader), 8);
+    for (auto &Section: Sections) {
+        SectionHeader SH;
+        SH.Offset = Offset;
+        SH.Size = Section.size();
+        append(Content, SH);
+        Offset = alignTo(Offset + Section.size(), 8);
+    }
+    for (auto &Section: Sections) {
+        Content.resize(alignTo(Content.size(), 8), '\0');
+        Content.append(Section);
+    }
+
+    // write to a temporary file first, so that a failed run does not break the saved state
+    std::string TempFile = (File + ".tmp").str();
+    {
+        std::error_code EC;
+        raw_fd_ostream OS(TempFile, EC, sys::fs::OF_None);
+        if (EC) return false;
+        OS << Content;
+        OS.close();
+        if (OS.has_error()) {
+            OS.clear_error();
+            return false;
+        }
+    }
+    return !sys::fs::rename(TempFile, File);
+}
@@ -0,0 +1,166 @@
+/*
+ *  Canary features a fast unification-based alias analysis for C programs
+ *  Copyright (C) 2021 Qingkai Shi <qingkaishi@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DYCKAA_DYCKAASTATE_H
+#define DYCKAA_DYCKAASTATE_H
+
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/ModuleSlotTracker.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "DyckAA/DyckCallGraph.h"
+#include "DyckAA/DyckGraph.h"
+
+using namespace llvm;
+
+/// Keys of values, which do not change when the module is reloaded from the same bitcode,
+/// or when the other functions of the module are changed.
+///  - "@name" for a named global value, and "@#n" for the n-th unnamed global value;
+///  - "%n@name" for the n-th local value of a function, where the arguments are followed by the basic blocks,
+///    each of which is followed by its instructions;
+///  - "!key" for the metadata wrapping a local value, where key is the key of the local value;
+///  - "#hash" for a constant, where hash is the hash of the constant in hex;
+///  - "$text" for other values (e.g., inline asm), where text is the value printed as an operand.
+class DyckValueKeys {
+private:
+    Module *M;
+    ModuleSlotTracker MST;
+
+    std::vector<GlobalValue *> UnnamedGlobals;
+    DenseMap<const GlobalValue *, unsigned> UnnamedGlobalIndices;
+
+    /// local values of functions, and the indices of local values in their functions
+    /// @{
+    DenseMap<const Function *, std::vector<Value *>> Locals;
+    DenseMap<const Value *, unsigned> LocalIndices;
+    /// @}
+
+    /// keys of other values, and the values of the keys (or the hashes of constants), which are collected
+    /// on demand and are null if a key is shared by different values
+    /// @{
+    DenseMap<const Value *, std::string> OtherKeys;
+    StringMap<Value *> OtherValues;
+    DenseMap<uint64_t, Constant *> Constants;
+    DenseSet<const Value *> CollectedValues;
+    bool OtherValuesCollected = false;
+    /// @}
+
+    /// hashes of types and constants, which do not depend on the addresses of the objects
+    /// @{
+    DenseMap<Type *, uint64_t> TypeHashes;
+    DenseMap<Constant *, uint64_t> ConstantHashes;
+    /// @}
+
+public:
+    explicit DyckValueKeys(Module *M);
+
+    std::string getKey(Value *V);
+
+    void writeKey(raw_ostream &OS, Value *V);
+
+    /// Return the position of an argument, a basic block or an instruction in its function
+    unsigned getLocalIndex(Value *V);
+
+    /// Return the value of the key, or null if there is no such value
+    Value *getValue(StringRef Key);
+
+    uint64_t hashType(Type *Ty);
+
+    uint64_t hashConstant(Constant *C);
+
+private:
+    const std::vector<Value *> &getLocals(const Function *F);
+
+    const std::string &getOtherKey(Value *V);
+
+    void collectOtherValues(Value *V);
+};
+
+/// The state of DyckAA saved in a file, with which the analysis of a module can be skipped (see load()),
+/// or be updated incrementally after the module is changed (see restore()).
+/// Besides the unified dyck graph, the state records a hash of each function, and the components of the
+/// graph that the constraints of each function touch. A component is a set of vertices connected by edges,
+/// by indirect calls (the called value, the arguments and the return value), or by constants (a constant
+/// and its operands, a global variable and its initializer), so that every unification ever done is inside
+/// a component, and a component does not depend on the constraints of the functions that do not touch it.
+///
+/// Unification cannot be undone. Thus, when the state is restored, the components touched by the changed
+/// functions are dropped, and the others are restored as they are. The changed functions and the unchanged
+/// functions touching the dropped components need to be analyzed again, while the constraints of the other
+/// functions are entailed by the restored graph.
+class DyckAAState {
+private:
+    Module *M;
+    DyckValueKeys Keys;
+
+    /// hash of the module-level entities (types, globals, options), and the hash of each function
+    /// @{
+    uint64_t ModuleHash;
+    std::vector<uint64_t> FunctionHashes;
+    /// @}
+
+    /// the file read
+    std::unique_ptr<MemoryBuffer> Buffer;
+
+    /// values of the ids in the file read, which are resolved on demand
+    /// @{
+    std::vector<Value *> ResolvedValues;
+    BitVector Resolved;
+    /// @}
+
+public:
+    /// \p OptionsHash summarizes the options that affect the result of the analysis.
+    DyckAAState(Module *M, uint64_t OptionsHash);
+
+    /// Read the state saved by a previous run. Return false if the file does not exist, is broken,
+    /// or is saved for a module with different module-level entities or with different options.
+    bool read(StringRef File);
+
+    /// Restore the graph from the state read, and collect the functions whose constraints are all entailed
+    /// by the restored graph. It should be called before any constraint is added to the graph.
+    void restore(DyckGraph *G, std::set<Function *> &CleanFunctions);
+
+    /// Load the graph and the call graph from the state read, without running the analysis.
+    /// Return false and leave the graphs untouched if the state is not saved for exactly the same module.
+    bool load(DyckGraph *G, DyckCallGraph *CG);
+
+    /// Save the state of the unified graph \p G and the call graph \p CG, return false if it fails.
+    bool write(StringRef File, DyckGraph *G, DyckCallGraph *CG);
+
+private:
+    /// return the value of an id in the file read, or null if it is not found
+    Value *resolve(uint32_t Id);
+
+    /// restore the vertices and the edges not in the \p Invalid components
+    void restoreGraph(DyckGraph *G, const BitVector &Invalid);
+
+    uint64_t hashModule(uint64_t OptionsHash);
+
+    uint64_t hashFunction(Function &F);
+};
+
+#endif // DYCKAA_DYCKAASTATE_H
@@ -22,6 +22,7 @@
 #include <stack>
 
 #include "AAAnalyzer.h"
+#include "DyckAAState.h"
 #include "DyckAA/DyckAliasAnalysis.h"
 #include "DyckAA/DyckCallGraph.h"
 #include "Support/RecursiveTimer.h"
@@ -35,6 +36,18 @@ static cl::opt<bool> DotCallGraph("dot-dyck-callgraph", cl::init(false), cl::Hid
 static cl::opt<bool> CountFP("count-fp", cl::init(false), cl::Hidden,
                              cl::desc("Calculate how many functions a function pointer may point to."));
 
+static cl::opt<std::string> IncrementalState("dyckaa-incremental", cl::init(""), cl::Hidden,
+                                             cl::value_desc("filename"),
+                                             cl::desc("Reuse the dyck graph saved in the file by a previous run, "
+                                                      "and save the new one to it."));
+
+static cl::opt<std::string> SaveState("dyckaa-save", cl::init(""), cl::Hidden, cl::value_desc("filename"),
+                                      cl::desc("Save the dyck graph and the call graph to the file."));
+
+static cl::opt<std::string> LoadState("dyckaa-load", cl::init(""), cl::Hidden, cl::value_desc("filename"),
+                                      cl::desc("Load the dyck graph and the call graph saved in the file "
+                                               "instead of running the analysis."));
+
 char DyckAliasAnalysis::ID = 0;
 static RegisterPass<DyckAliasAnalysis> X("dyckaa", "a unification based alias analysis");
 
@@ -58,13 +71,21 @@ const std::set<Value *> *DyckAliasAnalysis::getAliasSet(Value *Ptr) const {
 }
 
 bool DyckAliasAnalysis::mayAlias(Value *V1, Value *V2) const {
-    return getAliasSet(V1)->count(V2);
+    unsigned Idx = DyckPTG->getFrozenIndex(V1);
+    if (Idx == UINT_MAX) return V1 == V2;
+    return Idx == DyckPTG->getFrozenIndex(V2);
+}
+
+void DyckAliasAnalysis::mayAliasBatch(ArrayRef<std::pair<Value *, Value *>> Queries,
+                                      SmallVectorImpl<bool> &Results) const {
+    Results.reserve(Results.size() + Queries.size());
+    for (auto &Query: Queries) Results.push_back(mayAlias(Query.first, Query.second));
 }
 
 bool DyckAliasAnalysis::mayNull(Value *V) const {
-    auto *DyckNode = DyckPTG->findDyckVertex(V);
-    if (!DyckNode) return false;
-    return DyckNode->containsNull();
+    unsigned Idx = DyckPTG->getFrozenIndex(V);
+    if (Idx == UINT_MAX) return false;
+    return DyckPTG->getVertex(Idx)->containsNull();
 }
 
 DyckCallGraph *DyckAliasAnalysis::getDyckCallGraph() const {
@@ -79,19 +100,62 @@ bool DyckAliasAnalysis::runOnModule(Module &M) {
     RecursiveTimer DyckAA("Running DyckAA");
 
     // alias analysis
-    AAAnalyzer AA(&M, DyckPTG, DyckCG);
-    AA.intraProcedureAnalysis();
-    AA.interProcedureAnalysis();
+    std::unique_ptr<DyckAAState> State;
+    if (!LoadState.empty() || !SaveState.empty() || !IncrementalState.empty()) {
+        RecursiveTimer HashTimer("Hashing the module");
+        State = std::make_unique<DyckAAState>(&M, AAAnalyzer::getOptionsHash());
+    }
 
-    // a post-processing procedure
-    for (auto *DyckNode: DyckPTG->getVertices()) {
-        auto *AliasSet = (const std::set<Value *> *) DyckNode->getEquivalentSet();
-        if (!AliasSet) continue;
-        for (auto *V: *AliasSet) {
-            if (!isa<ConstantPointerNull>(V)) continue;
-            DyckNode->setContainsNull();
-            break;
+    bool Loaded = false;
+    if (!LoadState.empty()) {
+        RecursiveTimer LoadTimer("Loading DyckAA state");
+        Loaded = State->read(LoadState) && State->load(DyckPTG, DyckCG);
+        if (!Loaded) errs() << "Cannot load the DyckAA state in " << LoadState << ", analyzing from scratch.\n";
+    }
+
+    if (!Loaded) {
+        std::set<Function *> CleanFunctions;
+        bool Incremental = false;
+        if (!IncrementalState.empty()) {
+            if (AAAnalyzer::supportsIncrementalAnalysis()) {
+                RecursiveTimer RestoreTimer("Restoring DyckAA state");
+                Incremental = State->read(IncrementalState);
+                if (Incremental)
+                    State->restore(DyckPTG, CleanFunctions);
+                else
+                    errs() << "Cannot reuse the DyckAA state in " << IncrementalState << ", analyzing from scratch.\n";
+            } else {
+                errs() << "The DyckAA options do not support -dyckaa-incremental, analyzing from scratch.\n";
+            }
         }
+        AAAnalyzer AA(&M, DyckPTG, DyckCG);
+        AA.intraProcedureAnalysis(Incremental ? &CleanFunctions : nullptr);
+        AA.interProcedureAnalysis();
+    }
+
+    for (auto *File: {&SaveState, &IncrementalState}) {
+        if (File->empty()) continue;
+        RecursiveTimer SaveTimer("Saving DyckAA state");
+        if (!State->write(*File, DyckPTG, DyckCG)) errs() << "Cannot save the DyckAA state to " << *File << "\n";
+    }
+
+    // a post-processing procedure
+    for (auto *V: DyckPTG->getValues()) {
+        if (!isa<ConstantPointerNull>((Value *) V)) continue;
+        DyckPTG->findDyckVertex(V)->setContainsNull();
+    }
+
+    // the graph is not changed any more, index it for the queries
+    DyckPTG->freeze();
+
+    {
+        std::string Stats;
+        raw_string_ostream StatsOS(Stats);
+        StatsOS << "DyckAA arenas: ";
+        DyckPTG->printArenaStatistics(StatsOS);
+        StatsOS << "; ";
+        DyckCG->printArenaStatistics(StatsOS);
+        RecursiveTimer::print(StatsOS.str());
     }
 
     /* call graph */
@@ -121,7 +185,7 @@ bool DyckAliasAnalysis::runOnModule(Module &M) {
 void DyckAliasAnalysis::printAliasSetInformation() {
     /*if (InterAAEval)*/
     {
-        std::set<DyckGraphNode *> &AllReps = DyckPTG->getVertices();
+        auto &AllReps = DyckPTG->getVertices();
 
         outs() << "Printing distribution.log... ";
         outs().flush();
@@ -183,7 +247,7 @@ void DyckAliasAnalysis::printAliasSetInformation() {
 
         std::map<DyckGraphNode *, int> TheMap;
         int Idx = 0;
-        std::set<DyckGraphNode *> &Reps = DyckPTG->getVertices();
+        auto &Reps = DyckPTG->getVertices();
         auto RepIt = Reps.begin();
         while (RepIt != Reps.end()) {
             Idx++;
@@ -195,17 +259,17 @@ void DyckAliasAnalysis::printAliasSetInformation() {
         RepIt = Reps.begin();
         while (RepIt != Reps.end()) {
             DyckGraphNode *DGN = *RepIt;
-            std::map<void *, std::set<DyckGraphNode *>> &OutVs = DGN->getOutVertices();
+            auto &OutVs = DGN->getOutVertices();
 
             auto OvIt = OutVs.begin();
             while (OvIt != OutVs.end()) {
-                auto *Label = (DyckGraphEdgeLabel *) OvIt->first;
-                std::set<DyckGraphNode *> *oVs = &OvIt->second;
+                auto *Label = DyckPTG->getEdgeLabel(OvIt->Label);
+                auto *oVs = &OvIt->Nodes;
 
                 auto OIt = oVs->begin();
                 while (OIt != oVs->end()) {
                     DyckGraphNode *Rep1 = DGN;
-                    DyckGraphNode *Rep2 = (*OIt);
+                    DyckGraphNode *Rep2 = DyckPTG->getVertex(*OIt);
 
                     assert(TheMap.count(Rep1) && "ERROR in DotAliasSet (1)\n");
                     assert(TheMap.count(Rep2) && "ERROR in DotAliasSet (2)\n");
@@ -241,7 +305,7 @@ void DyckAliasAnalysis::printAliasSetInformation() {
         Log << "===== {.} means pthread escaped alias set =====\n";
 
         int Idx = 0;
-        std::set<DyckGraphNode *> &Reps = DyckPTG->getVertices();
+        auto &Reps = DyckPTG->getVertices();
         auto RepsIt = Reps.begin();
         while (RepsIt != Reps.end()) {
             Idx++;
@@ -24,19 +24,12 @@ static cl::opt<bool> WithEdgeLabels("with-labels", cl::init(false), cl::Hidden,
 DyckCallGraph::DyckCallGraph() : ExternalCallingNode(getOrInsertFunction(nullptr)) {
 }
 
-DyckCallGraph::~DyckCallGraph() {
-    auto It = FunctionMap.begin();
-    while (It != FunctionMap.end()) {
-        delete (It->second);
-        It++;
-    }
-    FunctionMapTy().swap(FunctionMap);
-}
+DyckCallGraph::~DyckCallGraph() = default;
 
 DyckCallGraphNode *DyckCallGraph::getOrInsertFunction(Function *Func) {
     auto It = FunctionMap.find(Func);
     if (It == FunctionMap.end()) {
-        auto *Ret = new DyckCallGraphNode(Func);
+        auto *Ret = new(NodeArena.allocate()) DyckCallGraphNode(Func);
 
         // The following if-statement is copied from llvm's call graph implementation
         // If this function has external linkage or has its address taken and
@@ -50,12 +43,27 @@ DyckCallGraphNode *DyckCallGraph::getOrInsertFunction(Function *Func) {
     return It->second;
 }
 
+DyckCallGraphNode *DyckCallGraph::restoreFunction(Function *Func) {
+    assert(!FunctionMap.count(Func) && "The function has been in the call graph!");
+    auto *Ret = new(NodeArena.allocate()) DyckCallGraphNode(Func);
+    FunctionMap.emplace(Func, Ret);
+    return Ret;
+}
+
 DyckCallGraphNode *DyckCallGraph::getFunction(Function *Func) const {
     auto It = FunctionMap.find(Func);
     if (It == FunctionMap.end()) return nullptr;
     return It->second;
 }
 
+void DyckCallGraph::printArenaStatistics(raw_ostream &O) const {
+    NodeArena.print(O, "nodes");
+    O << "; ";
+    CommonCallArena.print(O, "common calls");
+    O << "; ";
+    PointerCallArena.print(O, "pointer calls");
+}
+
 void DyckCallGraph::dotCallGraph(const std::string &ModuleIdentifier) {
     std::string DotFileName;
     DotFileName.append(ModuleIdentifier);
@@ -16,37 +16,106 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/MathExtras.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <climits>
 #include <cstdio>
+#include <deque>
 #include <stack>
 #include "DyckAA/DyckGraphEdgeLabel.h"
 #include "DyckAA/DyckGraph.h"
+#include "Support/ThreadPool.h"
+
+using namespace llvm;
+
+enum WorkListPolicy {
+    WLP_FIFO, WLP_LIFO
+};
+
+static cl::opt<WorkListPolicy> UnificationOrder("dyckaa-worklist-policy", cl::init(WLP_FIFO), cl::Hidden,
+                                                cl::desc("The order of merging vertices in qirun's algorithm"),
+                                                cl::values(clEnumValN(WLP_FIFO, "fifo", "first in, first out"),
+                                                           clEnumValN(WLP_LIFO, "lifo", "last in, first out")));
+
+static cl::opt<bool> ParallelUnification("dyckaa-parallel-unification", cl::init(false), cl::Hidden,
+                                         cl::desc("Unify vertices in rounds with a concurrent union-find "
+                                                  "(use -nworkers to set the number of threads)."));
+
+static cl::opt<bool> PrintWorkListStatistics("print-dyckaa-worklist-stats", cl::init(false), cl::Hidden,
+                                             cl::desc("Print the statistics of the worklist in qirun's algorithm"));
+
+/// The worklist of qirun's algorithm, i.e., the (vertex, label) pairs such that the vertex has
+/// more than one target via the label. A pair is queued at most once. Removing a pair only drops it from
+/// the membership index, and the queued entry becomes stale and is skipped when popped.
+class DyckGraph::WorkList {
+private:
+    std::deque<std::pair<unsigned, unsigned>> Queue;
+    DenseSet<std::pair<unsigned, unsigned>> Members;
+    bool LIFO;
+
+    static std::pair<unsigned, unsigned> key(unsigned NodeIdx, unsigned Label) { return {NodeIdx, Label}; }
+
+public:
+    /// counters
+    /// @{
+    unsigned long NumPushes = 0;
+    unsigned long NumPops = 0;
+    unsigned long NumStales = 0;
+    /// @}
+
+    explicit WorkList(bool LIFO) : LIFO(LIFO) {}
+
+    void push(unsigned NodeIdx, unsigned Label) {
+        if (!Members.insert(key(NodeIdx, Label)).second) return;
+        Queue.emplace_back(NodeIdx, Label);
+        ++NumPushes;
+    }
+
+    void remove(unsigned NodeIdx, unsigned Label) { Members.erase(key(NodeIdx, Label)); }
+
+    /// get the next pair in the list, return false if the list is empty
+    bool pop(unsigned &NodeIdx, unsigned &Label) {
+        while (!Queue.empty()) {
+            auto Next = LIFO ? Queue.back() : Queue.front();
+            if (LIFO) Queue.pop_back();
+            else Queue.pop_front();
+            if (!Members.erase(Next)) {
+                ++NumStales;
+                continue;
+            }
+            ++NumPops;
+            NodeIdx = Next.first;
+            Label = Next.second;
+            return true;
+        }
+        return false;
+    }
+};
 
 DyckGraph::DyckGraph() {
-    DerefEdgeLabel = new DereferenceEdgeLabel;
+    DerefEdgeLabel = addEdgeLabel(new DereferenceEdgeLabel);
 }
 
 DyckGraph::~DyckGraph() {
-    for (auto &V: Vertices) delete V;
+    for (auto *L: EdgeLabels) delete L;
+}
 
-    delete DerefEdgeLabel;
-    auto OIt = OffsetEdgeLabelMap.begin();
-    while (OIt != OffsetEdgeLabelMap.end()) {
-        delete OIt->second;
-        OIt++;
-    }
-    auto IIt = IndexEdgeLabelMap.begin();
-    while (IIt != IndexEdgeLabelMap.end()) {
-        delete IIt->second;
-        IIt++;
-    }
+DyckGraphEdgeLabel *DyckGraph::addEdgeLabel(DyckGraphEdgeLabel *Label) {
+    Label->ID = EdgeLabels.size();
+    EdgeLabels.push_back(Label);
+    return Label;
 }
 
 DyckGraphEdgeLabel *DyckGraph::getOrInsertOffsetEdgeLabel(long Offset) {
     if (OffsetEdgeLabelMap.count(Offset)) {
         return OffsetEdgeLabelMap[Offset];
     } else {
-        DyckGraphEdgeLabel *Ret = new PointerOffsetEdgeLabel(Offset);
+        DyckGraphEdgeLabel *Ret = addEdgeLabel(new PointerOffsetEdgeLabel(Offset));
         OffsetEdgeLabelMap.insert(std::pair<long, DyckGraphEdgeLabel *>(Offset, Ret));
         return Ret;
     }
@@ -56,7 +125,7 @@ DyckGraphEdgeLabel *DyckGraph::getOrInsertIndexEdgeLabel(long Offset) {
     if (IndexEdgeLabelMap.count(Offset)) {
         return IndexEdgeLabelMap[Offset];
     } else {
-        DyckGraphEdgeLabel *Ret = new FieldIndexEdgeLabel(Offset);
+        DyckGraphEdgeLabel *Ret = addEdgeLabel(new FieldIndexEdgeLabel(Offset));
         IndexEdgeLabelMap.insert(std::pair<long, DyckGraphEdgeLabel *>(Offset, Ret));
         return Ret;
     }
@@ -66,63 +135,93 @@ void DyckGraph::printAsDot(const char *FileName) const {
     FILE *FileDesc = fopen(FileName, "w+");
     fprintf(FileDesc, "digraph ptg {\n");
 
-    auto VIt = Vertices.begin();
-    while (VIt != Vertices.end()) {
-        if ((*VIt)->getName() != nullptr)
-            fprintf(FileDesc, "\ta%d[label=\"%s\"];\n", (*VIt)->getIndex(), (*VIt)->getName());
+    for (auto *Node: Vertices) {
+        if (!Node) continue;
+        if (Node->getName() != nullptr)
+            fprintf(FileDesc, "\ta%u[label=\"%s\"];\n", Node->getIndex(), Node->getName());
         else
-            fprintf(FileDesc, "\ta%d;\n", (*VIt)->getIndex());
-
-        std::map<void *, std::set<DyckGraphNode *>> &Outs = (*VIt)->getOutVertices();
-        auto OIt = Outs.begin();
-        while (OIt != Outs.end()) {
-            long Label = (long) (OIt->first);
-            std::set<DyckGraphNode *> *Tars = &OIt->second;
-            auto TarIt = Tars->begin();
-            while (TarIt != Tars->end()) {
-                fprintf(FileDesc, "\ta%d->a%d [label=\"%ld\"];\n", (*VIt)->getIndex(), (*TarIt)->getIndex(), Label);
-                TarIt++;
-            }
-            OIt++;
+            fprintf(FileDesc, "\ta%u;\n", Node->getIndex());
+
+        for (auto &Out: Node->getOutVertices()) {
+            const char *Label = EdgeLabels[Out.Label]->getEdgeLabelDescription().c_str();
+            for (auto Tar: Out.Nodes)
+                fprintf(FileDesc, "\ta%u->a%u [label=\"%s\"];\n", Node->getIndex(), Tar, Label);
         }
-        ++VIt;
     }
 
     fprintf(FileDesc, "}\n");
     fclose(FileDesc);
 }
 
-void DyckGraph::removeFromWorkList(std::multimap<DyckGraphNode *, void *> &List, DyckGraphNode *Node, void *Label) {
-    typedef std::multimap<DyckGraphNode *, void *>::iterator CIT;
-    typedef std::pair<CIT, CIT> Range;
-    Range NodeRange = List.equal_range(Node);
-    auto Next = NodeRange.first;
-    while (Next != NodeRange.second) {
-        if ((Next)->second == Label) {
-            List.erase(Next);
-            return;
+void DyckGraph::merge(DyckGraphNode *X, DyckGraphNode *Y, WorkList *WL) {
+    assert(X != Y);
+    assert(!isFrozen() && "Cannot merge vertices of a frozen graph!");
+    unsigned XIdx = X->getIndex();
+    unsigned YIdx = Y->getIndex();
+
+    // detach all the edges of y, the sources of y are updated below,
+    // and the targets of y keep a stale entry in their in buckets, which will be skipped since y becomes a tombstone
+    DyckGraphNode::EdgeBucketList YOuts(std::move(Y->OutEdges));
+    DyckGraphNode::EdgeBucketList YIns(std::move(Y->InEdges));
+    Y->OutEdges.clear();
+    Y->InEdges.clear();
+    Y->NumOutEdges = 0;
+    Y->NumInEdges = 0;
+
+    for (auto &Out: YOuts) {
+        for (auto W: Out.Nodes) {
+            auto *WNode = Vertices[W];
+            // y->y becomes x->x
+            if (W == YIdx) W = XIdx;
+            else --WNode->NumInEdges;
+            if (X->addTarget(W, Out.Label) && WL && X->outNumVertices(Out.Label) > 1) {
+                WL->push(XIdx, Out.Label);
+            }
+        }
+    }
+
+    for (auto &In: YIns) {
+        for (auto W: In.Nodes) {
+            auto *WNode = Vertices[W];
+            // skip self loops that have been handled above, and stale sources
+            if (W == YIdx || !WNode) continue;
+            auto &WOuts = *DyckGraphNode::findBucket(WNode->OutEdges, In.Label);
+            WOuts.Nodes.erase(std::lower_bound(WOuts.Nodes.begin(), WOuts.Nodes.end(), YIdx));
+            --WNode->NumOutEdges;
+            if (WOuts.Nodes.empty()) WNode->OutEdges.erase(&WOuts);
+            WNode->addTarget(XIdx, In.Label);
+            if (WL && WNode->outNumVertices(In.Label) < 2) {
+                WL->remove(W, In.Label);
+            }
         }
-        Next++;
     }
+
+    absorb(X, Y);
 }
 
-bool DyckGraph::containsInWorkList(std::multimap<DyckGraphNode *, void *> &List, DyckGraphNode *v, void *l) {
-    typedef std::multimap<DyckGraphNode *, void *>::iterator CIT;
-    typedef std::pair<CIT, CIT> Range;
-    Range NodeRange = List.equal_range(v);
-    auto Next = NodeRange.first;
-    while (Next != NodeRange.second) {
-        if ((Next)->second == l) {
-            return true;
-        }
-        Next++;
+void DyckGraph::absorb(DyckGraphNode *X, DyckGraphNode *Y) {
+    // keep the equivalent set up to date if it has been materialised
+    if (X->EquivClassValid) {
+        collectEquivalentSet(Y->ClassIdx, X->EquivClass);
+    } else if (Y->EquivClassValid) {
+        X->EquivClass = std::move(Y->EquivClass);
+        X->EquivClassValid = true;
+        collectEquivalentSet(X->ClassIdx, X->EquivClass);
     }
-    return false;
+    unsigned XClass = X->ClassIdx;
+    X->ClassIdx = Classes.doUnion(XClass, Y->ClassIdx);
+    ClassVertices[X->ClassIdx] = X;
+
+    Vertices[Y->getIndex()] = nullptr;
+    ++NumTombstones;
+    if (ClassListener) ClassListener->classesMerged(X->ClassIdx, X->ClassIdx == XClass ? Y->ClassIdx : XClass);
+    // y lives in the arena until the graph is destroyed
+    std::set<void *>().swap(Y->EquivClass);
 }
 
 DyckGraphNode *DyckGraph::combine(DyckGraphNode *NodeX, DyckGraphNode *NodeY) {
-    assert(Vertices.count(NodeX));
-    assert(Vertices.count(NodeY));
+    assert(Vertices[NodeX->getIndex()] == NodeX);
+    assert(Vertices[NodeY->getIndex()] == NodeY);
     if (NodeX == NodeY) return NodeX;
 
     if (NodeX->degree() < NodeY->degree()) {
@@ -131,224 +230,366 @@ DyckGraphNode *DyckGraph::combine(DyckGraphNode *NodeX, DyckGraphNode *NodeY) {
         NodeY = Temp;
     }
 
-    std::set<void *> &YOutLabels = NodeY->getOutLabels();
-    auto YOIt = YOutLabels.begin();
-    while (YOIt != YOutLabels.end()) {
-        if (NodeY->containsTarget(NodeY, *YOIt)) {
-            if (!NodeX->containsTarget(NodeX, *YOIt)) {
-                NodeX->addTarget(NodeX, *YOIt);
-            }
-            NodeY->removeTarget(NodeY, *YOIt);
-
-        }
-        YOIt++;
-    }
-
-    YOIt = YOutLabels.begin();
-    while (YOIt != YOutLabels.end()) {
-        std::set<DyckGraphNode *> *Ws = &NodeY->getOutVertices()[*YOIt];
-        auto W = Ws->begin();
-        while (W != Ws->end()) {
-            if (!NodeX->containsTarget(*W, *YOIt)) {
-                NodeX->addTarget(*W, *YOIt);
-            }
-            // cannot use removeTarget function, which will affect iterator
-            // y remove target *w
-            DyckGraphNode *WTemp = *W;
-            Ws->erase(W++);
-            // *w remove src y
-            ((WTemp)->getInVertices())[*YOIt].erase(NodeY);
-        }
-        YOIt++;
-    }
-
-    std::set<void *> &YInLabels = NodeY->getInLabels();
-    auto YIIt = YInLabels.begin();
-    while (YIIt != YInLabels.end()) {
-        std::set<DyckGraphNode *> *Ws = &NodeY->getInVertices()[*YIIt];
-        auto W = Ws->begin();
-        while (W != Ws->end()) {
-            if (!(*W)->containsTarget(NodeX, *YIIt)) {
-                (*W)->addTarget(NodeX, *YIIt);
-            }
-
-            // cannot use removeTarget function, which will affect iterator
-            DyckGraphNode *WTemp = *W;
-            Ws->erase(W++);
-            ((WTemp)->getOutVertices())[*YIIt].erase(NodeY);
-        }
-
-        YIIt++;
-    }
-    auto Vals = NodeY->getEquivalentSet();
-    for (auto &Val: *Vals) {
-        ValVertexMap[Val] = NodeX;
-    }
-    NodeY->mvEquivalentSetTo(NodeX);
-    Vertices.erase(NodeY);
-    delete NodeY;
+    merge(NodeX, NodeY, nullptr);
     return NodeX;
 }
 
 bool DyckGraph::qirunAlgorithm() {
-    bool Ret = true;
-    std::multimap<DyckGraphNode *, void *> Worklist;
-    auto VIt = Vertices.begin();
-    while (VIt != Vertices.end()) {
-        std::set<void *> &OutLabels = (*VIt)->getOutLabels();
-        auto LabelIt = OutLabels.begin();
-        while (LabelIt != OutLabels.end()) {
-            if ((*VIt)->outNumVertices(*LabelIt) > 1) {
-                Worklist.insert(std::pair<DyckGraphNode *, void *>(*VIt, *LabelIt));
+    if (ParallelUnification) return qirunAlgorithmInParallel();
+
+    WorkList WL(UnificationOrder == WLP_LIFO);
+    for (auto *Node: Vertices) {
+        if (!Node) continue;
+        for (auto &Out: Node->getOutVertices()) {
+            if (Out.Nodes.size() > 1) {
+                WL.push(Node->getIndex(), Out.Label);
             }
-            LabelIt++;
         }
-        VIt++;
     }
 
-    if (!Worklist.empty()) Ret = false;
-
-    while (!Worklist.empty()) {
-        //outs()<<"HERE0\n"; outs().flush();
-        auto ZIt = Worklist.begin();
-        //outs()<<"HERE0.1\n"; outs().flush();
-        std::set<DyckGraphNode *> *Nodes = &ZIt->first->getOutVertices()[ZIt->second];
-        auto NodeIt = Nodes->begin();
-        DyckGraphNode *X = *(NodeIt);
-        NodeIt++;
-        //outs()<<"HERE0.2\n"; outs().flush();
-        DyckGraphNode *Y = *(NodeIt);
+    bool Ret = WL.NumPushes == 0;
+
+    unsigned ZIdx, Label;
+    while (WL.pop(ZIdx, Label)) {
+        // entries of the vertices merged away are not removed from the list
+        auto *Z = Vertices[ZIdx];
+        if (!Z || Z->outNumVertices(Label) < 2) {
+            ++WL.NumStales;
+            continue;
+        }
+        auto &Nodes = DyckGraphNode::findBucket(Z->OutEdges, Label)->Nodes;
+        DyckGraphNode *X = Vertices[Nodes[0]];
+        DyckGraphNode *Y = Vertices[Nodes[1]];
         if (X->degree() < Y->degree()) {
             DyckGraphNode *Temp = X;
             X = Y;
             Y = Temp;
         }
-        //outs()<<"HERE0.3\n"; outs().flush();
-        assert(X != Y);
-        Vertices.erase(Y);
-        auto Vals = Y->getEquivalentSet();
-        for (auto &Val: *Vals) {
-            ValVertexMap[Val] = X;
+        merge(X, Y, &WL);
+        // z may be merged into x
+        if (Vertices[ZIdx] && Z->outNumVertices(Label) > 1) WL.push(ZIdx, Label);
+    }
+
+    if (PrintWorkListStatistics) {
+        outs() << "[DyckAA] Unification worklist: " << WL.NumPushes << " pushes, " << WL.NumPops << " pops, "
+               << WL.NumStales << " stale entries\n";
+    }
+
+    compact();
+    return Ret;
+}
+
+namespace {
+/// An edge of the dyck graph, ordered by its source, label and target
+struct DyckEdge {
+    unsigned Src;
+    unsigned Label;
+    unsigned Dst;
+
+    bool operator<(const DyckEdge &E) const {
+        if (Src != E.Src) return Src < E.Src;
+        if (Label != E.Label) return Label < E.Label;
+        return Dst < E.Dst;
+    }
+
+    bool operator==(const DyckEdge &E) const { return Src == E.Src && Label == E.Label && Dst == E.Dst; }
+};
+
+/// the partition of a vertex when the vertices are distributed to \p NumParts tasks
+inline unsigned partitionOf(unsigned Vertex, unsigned NumParts) {
+    return (unsigned) (((uint64_t) (Vertex * 2654435761u) * NumParts) >> 32);
+}
+} // namespace
+
+bool DyckGraph::qirunAlgorithmInParallel() {
+    // Each round maps the edges to the representatives of their endpoints in parallel, distributes them
+    // to partitions by their sources, and then unites the targets sharing a (source, label) pair in each
+    // partition in parallel. The rounds stop when every (source, label) pair has a single target, and
+    // then the graph is rebuilt once from the edges left. The representative of a class is the vertex
+    // with the smallest index, so the result does not depend on the number of threads.
+    compact();
+    unsigned NumVertices = Vertices.size();
+    std::vector<DyckEdge> Edges;
+    bool Ret = true;
+    for (auto *Node: Vertices) {
+        for (auto &Out: Node->OutEdges) {
+            if (Out.Nodes.size() > 1) Ret = false;
+            for (auto Tar: Out.Nodes) Edges.push_back({Node->NodeIndex, Out.Label, Tar});
         }
-        //outs()<<"HERE0.4\n"; outs().flush();
-        Y->mvEquivalentSetTo(X/*->getRepresentative()*/);
-        //outs()<<"HERE1\n"; outs().flush();
-        std::set<void *> &YOutLabels = Y->getOutLabels();
-        auto YOIt = YOutLabels.begin();
-        while (YOIt != YOutLabels.end()) {
-            if (Y->containsTarget(Y, *YOIt)) {
-                if (!X->containsTarget(X, *YOIt)) {
-                    X->addTarget(X, *YOIt);
-                    if (X->outNumVertices(*YOIt) > 1 && !containsInWorkList(Worklist, X, *YOIt)) {
-                        Worklist.insert(std::pair<DyckGraphNode *, void *>(X, *YOIt));
-                    }
-                }
-                Y->removeTarget(Y, *YOIt);
-                if (Y->outNumVertices(*YOIt) < 2) {
-                    removeFromWorkList(Worklist, Y, *YOIt);
+    }
+    if (Ret) return true;
+
+    auto *Pool = ThreadPool::get();
+    unsigned NumTasks = std::max<size_t>(1, Pool->Workers.size());
+    ConcurrentDisjointSet UF(NumVertices);
+    // Buckets[T][P]: the edges distributed by task T to partition P
+    std::vector<std::vector<std::vector<DyckEdge>>> Buckets(NumTasks, std::vector<std::vector<DyckEdge>>(NumTasks));
+    // the sorted, deduplicated edges of each partition
+    std::vector<std::vector<DyckEdge>> Parts(NumTasks);
+    std::atomic<unsigned long> NumConflicts(0);
+    unsigned NumRounds = 0;
+    do {
+        ++NumRounds;
+        NumConflicts = 0;
+        size_t ChunkSize = (Edges.size() + NumTasks - 1) / NumTasks;
+        for (unsigned T = 0; T < NumTasks; ++T) {
+            Pool->enqueue([&, T]() {
+                for (auto &Bucket: Buckets[T]) Bucket.clear();
+                size_t End = std::min(Edges.size(), (T + 1) * ChunkSize);
+                for (size_t K = T * ChunkSize; K < End; ++K) {
+                    DyckEdge E = {UF.findSet(Edges[K].Src), Edges[K].Label, UF.findSet(Edges[K].Dst)};
+                    Buckets[T][partitionOf(E.Src, NumTasks)].push_back(E);
                 }
-            }
-            YOIt++;
+            });
         }
-        //outs()<<"HERE2\n"; outs().flush();
-        YOIt = YOutLabels.begin();
-        while (YOIt != YOutLabels.end()) {
-            std::set<DyckGraphNode *> *Ws = &Y->getOutVertices()[*YOIt];
-            auto W = Ws->begin();
-            while (W != Ws->end()) {
-                if (!X->containsTarget(*W, *YOIt)) {
-                    X->addTarget(*W, *YOIt);
-                    if (X->outNumVertices(*YOIt) > 1 && !containsInWorkList(Worklist, X, *YOIt)) {
-                        Worklist.insert(std::pair<DyckGraphNode *, void *>(X, *YOIt));
-                    }
-                }
-                // cannot use removeTarget function, which will affect iterator
-                // y remove target *w
-                DyckGraphNode *WTemp = *W;
-                Ws->erase(W++);
-                // *w remove src y
-                ((WTemp)->getInVertices())[*YOIt].erase(Y);
-                if (Y->outNumVertices(*YOIt) < 2) {
-                    removeFromWorkList(Worklist, Y, *YOIt);
+        Pool->wait();
+        for (unsigned P = 0; P < NumTasks; ++P) {
+            Pool->enqueue([&, P]() {
+                auto &Part = Parts[P];
+                Part.clear();
+                for (unsigned T = 0; T < NumTasks; ++T) Part.insert(Part.end(), Buckets[T][P].begin(), Buckets[T][P].end());
+                std::sort(Part.begin(), Part.end());
+                Part.erase(std::unique(Part.begin(), Part.end()), Part.end());
+                // targets of the same (source, label) pair are adjacent, and distinct after deduplication
+                unsigned long Conflicts = 0;
+                for (size_t K = 1; K < Part.size(); ++K) {
+                    if (Part[K].Src != Part[K - 1].Src || Part[K].Label != Part[K - 1].Label) continue;
+                    UF.doUnion(Part[K - 1].Dst, Part[K].Dst);
+                    ++Conflicts;
                 }
-            }
-            YOIt++;
+                NumConflicts += Conflicts;
+            });
         }
-        //outs()<<"HERE3\n"; outs().flush();
-        std::set<void *> &YInLabels = Y->getInLabels();
-        auto YIIt = YInLabels.begin();
-        while (YIIt != YInLabels.end()) {
-            std::set<DyckGraphNode *> *Ws = &Y->getInVertices()[*YIIt];
-            auto W = Ws->begin();
-            while (W != Ws->end()) {
-                if (!(*W)->containsTarget(X, *YIIt)) {
-                    (*W)->addTarget(X, *YIIt);
-                }
+        Pool->wait();
+        Edges.clear();
+        for (auto &Part: Parts) Edges.insert(Edges.end(), Part.begin(), Part.end());
+    } while (NumConflicts);
+
+    // merge each vertex into the representative of its class, whose index is smaller
+    for (unsigned K = 0; K < NumVertices; ++K) {
+        unsigned Rep = UF.findSet(K);
+        if (Rep == K) continue;
+        auto *Y = Vertices[K];
+        DyckGraphNode::EdgeBucketList().swap(Y->OutEdges);
+        DyckGraphNode::EdgeBucketList().swap(Y->InEdges);
+        Y->NumOutEdges = 0;
+        Y->NumInEdges = 0;
+        absorb(Vertices[Rep], Y);
+    }
 
-                // cannot use removeTarget function, which will affect iterator
-                DyckGraphNode *WTemp = *W;
-                Ws->erase(W++);
-                ((WTemp)->getOutVertices())[*YIIt].erase(Y);
-                if ((WTemp)->outNumVertices(*YIIt) < 2) {
-                    removeFromWorkList(Worklist, WTemp, *YIIt);
+    // rebuild the out edges of each partition from its sorted edges, and distribute the edges by their targets.
+    // a representative with stale edges always has edges left, because edges are only mapped, never dropped,
+    // so its buckets are reset when its first edge is met
+    for (unsigned P = 0; P < NumTasks; ++P) {
+        Pool->enqueue([&, P]() {
+            for (auto &Bucket: Buckets[P]) Bucket.clear();
+            DyckGraphNode *Node = nullptr;
+            for (auto &E: Parts[P]) {
+                if (!Node || Node->NodeIndex != E.Src) {
+                    Node = Vertices[E.Src];
+                    Node->OutEdges.clear();
+                    Node->NumOutEdges = 0;
+                }
+                if (Node->OutEdges.empty() || Node->OutEdges.back().Label != E.Label)
+                    Node->OutEdges.emplace_back(E.Label);
+                Node->OutEdges.back().Nodes.push_back(E.Dst);
+                ++Node->NumOutEdges;
+                Buckets[P][partitionOf(E.Dst, NumTasks)].push_back({E.Dst, E.Label, E.Src});
+            }
+        });
+    }
+    Pool->wait();
+    // rebuild the in edges of each partition
+    for (unsigned P = 0; P < NumTasks; ++P) {
+        Pool->enqueue([&, P]() {
+            auto &Part = Parts[P];
+            Part.clear();
+            for (unsigned T = 0; T < NumTasks; ++T) Part.insert(Part.end(), Buckets[T][P].begin(), Buckets[T][P].end());
+            std::sort(Part.begin(), Part.end());
+            DyckGraphNode *Node = nullptr;
+            for (auto &E: Part) {
+                if (!Node || Node->NodeIndex != E.Src) {
+                    Node = Vertices[E.Src];
+                    Node->InEdges.clear();
+                    Node->NumInEdges = 0;
                 }
+                if (Node->InEdges.empty() || Node->InEdges.back().Label != E.Label)
+                    Node->InEdges.emplace_back(E.Label);
+                Node->InEdges.back().Nodes.push_back(E.Dst);
+                ++Node->NumInEdges;
             }
+        });
+    }
+    Pool->wait();
+
+    if (PrintWorkListStatistics) {
+        outs() << "[DyckAA] Parallel unification: " << NumRounds << " rounds, " << NumTasks << " tasks, "
+               << Edges.size() << " edges left\n";
+    }
+
+    compact();
+    return false;
+}
 
-            YIIt++;
+void DyckGraph::compact() {
+    if (!NumTombstones) return;
+
+    std::vector<unsigned> NewIndices(Vertices.size(), UINT_MAX);
+    unsigned NumLive = 0;
+    for (unsigned K = 0; K < Vertices.size(); ++K) {
+        if (Vertices[K]) NewIndices[K] = NumLive++;
+    }
+
+    for (unsigned K = 0; K < Vertices.size(); ++K) {
+        auto *Node = Vertices[K];
+        if (!Node) continue;
+        // the renumbering is monotonic, so out buckets are still sorted
+        for (auto &Out: Node->OutEdges)
+            for (auto &Tar: Out.Nodes) Tar = NewIndices[Tar];
+        for (auto &In: Node->InEdges) {
+            auto End = std::remove_if(In.Nodes.begin(), In.Nodes.end(),
+                                      [&NewIndices](unsigned Src) { return NewIndices[Src] == UINT_MAX; });
+            In.Nodes.erase(End, In.Nodes.end());
+            for (auto &Src: In.Nodes) Src = NewIndices[Src];
         }
-        delete Y;
+        Node->NodeIndex = NewIndices[K];
+        Vertices[NewIndices[K]] = Node;
     }
-    return Ret;
+    Vertices.resize(NumLive);
+    Vertices.shrink_to_fit();
+    NumTombstones = 0;
+
+    // after flattening, finding a class does not write anything unless more vertices are merged
+    Classes.flatten();
+}
+
+static inline size_t hashFrozenKey(const void *Val) {
+    return DenseMapInfo<const void *>::getHashValue(Val);
+}
+
+void DyckGraph::freeze() {
+    compact();
+    // keep the load factor at most 1/2, so that probing sequences are short
+    size_t Capacity = NextPowerOf2(ValClassMap.size() * 2);
+    FrozenIndex.assign(Capacity, std::make_pair(nullptr, UINT_MAX));
+    FrozenMask = Capacity - 1;
+    for (auto &It: ValClassMap) {
+        size_t Slot = hashFrozenKey(It.first) & FrozenMask;
+        while (FrozenIndex[Slot].first) Slot = (Slot + 1) & FrozenMask;
+        FrozenIndex[Slot] = std::make_pair(It.first, ClassVertices[Classes.findSet(It.second)]->getIndex());
+    }
+}
+
+unsigned DyckGraph::getFrozenIndex(const void *Val) const {
+    assert(isFrozen() && "The graph has not been frozen!");
+    for (size_t Slot = hashFrozenKey(Val) & FrozenMask;; Slot = (Slot + 1) & FrozenMask) {
+        auto &Entry = FrozenIndex[Slot];
+        if (Entry.first == Val || !Entry.first) return Entry.second;
+    }
+}
+
+DyckGraphNode *DyckGraph::addVertex(void *Val, const char *Name) {
+    unsigned ClassIdx = Classes.makeSet();
+    auto *Node = new(NodeArena.allocate()) DyckGraphNode(this, Vertices.size(), ClassIdx, Name);
+    Vertices.push_back(Node);
+    ClassValues.push_back(Val);
+    ClassVertices.push_back(Node);
+    if (Val) {
+        ValClassMap.insert(std::make_pair(Val, ClassIdx));
+        if (ClassListener) ClassListener->valueAdded(Val, ClassIdx);
+    }
+    return Node;
 }
 
 std::pair<DyckGraphNode *, bool> DyckGraph::retrieveDyckVertex(void *Val, const char *Name) {
     if (Val == nullptr) {
-        auto *Node = new DyckGraphNode(nullptr);
-        Vertices.insert(Node);
-        return std::make_pair(Node, false);
+        return std::make_pair(addVertex(nullptr, nullptr), false);
     }
 
-    auto It = ValVertexMap.find(Val);
-    if (It != ValVertexMap.end()) {
-        return std::make_pair(It->second, true);
+    auto It = ValClassMap.find(Val);
+    if (It != ValClassMap.end()) {
+        return std::make_pair(ClassVertices[Classes.findSet(It->second)], true);
     } else {
-        auto *Node = new DyckGraphNode(Val, Name);
-        Vertices.insert(Node);
-        ValVertexMap.insert(std::pair<void *, DyckGraphNode *>(Val, Node));
-        return std::make_pair(Node, false);
+        return std::make_pair(addVertex(Val, Name), false);
     }
 }
 
 DyckGraphNode *DyckGraph::findDyckVertex(void *Val) {
-    auto It = ValVertexMap.find(Val);
-    if (It != ValVertexMap.end()) {
-        return It->second;
+    if (isFrozen()) {
+        // the frozen index does not write anything, e.g., path compression, so it is safe for concurrent queries
+        unsigned Idx = getFrozenIndex(Val);
+        if (Idx != UINT_MAX) return Vertices[Idx];
+    }
+    auto It = ValClassMap.find(Val);
+    if (It != ValClassMap.end()) {
+        return ClassVertices[Classes.findSet(It->second)];
     }
     return nullptr;
 }
 
+void DyckGraph::collectEquivalentSet(unsigned ClassIdx, std::set<void *> &Set) const {
+    unsigned Member = ClassIdx;
+    do {
+        if (auto *Val = ClassValues[Member]) Set.insert(Val);
+        Member = Classes.next(Member);
+    } while (Member != ClassIdx);
+}
+
+void DyckGraph::getEquivalentValues(DyckGraphNode *N, std::vector<void *> &Vals) const {
+    unsigned Member = N->ClassIdx;
+    do {
+        if (auto *Val = ClassValues[Member]) Vals.push_back(Val);
+        Member = Classes.next(Member);
+    } while (Member != N->ClassIdx);
+}
+
+DyckGraphNode *DyckGraph::restoreVertex(const std::vector<void *> &Vals) {
+    auto *Node = addVertex(Vals.empty() ? nullptr : Vals[0], nullptr);
+    for (unsigned K = 1; K < Vals.size(); ++K) {
+        assert(Vals[K] && !ValClassMap.count(Vals[K]));
+        unsigned ClassIdx = Classes.makeSet();
+        ClassValues.push_back(Vals[K]);
+        ClassVertices.push_back(nullptr);
+        ValClassMap.insert(std::make_pair(Vals[K], ClassIdx));
+        Node->ClassIdx = Classes.doUnion(Node->ClassIdx, ClassIdx);
+    }
+    ClassVertices[Node->ClassIdx] = Node;
+    return Node;
+}
+
 unsigned int DyckGraph::numVertices() {
-    return Vertices.size();
+    return Vertices.size() - NumTombstones;
 }
 
 unsigned int DyckGraph::numEquivalentClasses() {
-    return Vertices.size();
+    return Vertices.size() - NumTombstones;
 }
 
-std::set<DyckGraphNode *> &DyckGraph::getVertices() {
+const std::vector<DyckGraphNode *> &DyckGraph::getVertices() {
+    compact();
     return Vertices;
 }
 
 void DyckGraph::validation(const char *File, int Line) {
     printf("Start validation... ");
-    std::set<DyckGraphNode *> &Reps = this->getVertices();
-    auto RepsIt = Reps.begin();
-    while (RepsIt != Reps.end()) {
-        DyckGraphNode *Rep = *RepsIt;
+    for (auto *Rep: getVertices()) {
+        assert(Vertices[Rep->getIndex()] == Rep);
+        assert(Classes.findSet(Rep->ClassIdx) == Rep->ClassIdx);
+        assert(ClassVertices[Rep->ClassIdx] == Rep);
         auto RepVal = Rep->getEquivalentSet();
         for (auto Val: *RepVal)
-            assert(ValVertexMap[Val] == Rep);
-        RepsIt++;
+            assert(findDyckVertex(Val) == Rep);
+
+        unsigned NumOuts = 0;
+        for (auto &Out: Rep->getOutVertices()) {
+            assert(!Out.Nodes.empty());
+            assert(std::is_sorted(Out.Nodes.begin(), Out.Nodes.end()));
+            for (auto Tar: Out.Nodes) {
+                assert(DyckGraphNode::findBucket(Vertices[Tar]->InEdges, Out.Label));
+                ++NumOuts;
+            }
+        }
+        assert(NumOuts == Rep->NumOutEdges);
     }
     printf("Done!\n\n");
 }
@@ -356,21 +597,17 @@ void DyckGraph::validation(const char *File, int Line) {
 void DyckGraph::getReachableVertices(const std::set<DyckGraphNode *> &Sources, std::set<DyckGraphNode *> &Reachable) {
     std::stack<DyckGraphNode *> WorkStack;
     for (auto *N: Sources) if (N) WorkStack.push(N);
-    std::set<DyckGraphNode *> Visited;
     while (!WorkStack.empty()) {
         DyckGraphNode *Top = WorkStack.top();
         WorkStack.pop();
-        if (Visited.count(Top)) continue;
-        Visited.insert(Top);
-
-        std::set<DyckGraphNode *> Tars;
-        Top->getOutVertices(&Tars);
-        auto TIt = Tars.begin();
-        while (TIt != Tars.end()) {
-            DyckGraphNode *DGN = (*TIt);
-            if (Visited.find(DGN) == Visited.end())
-                WorkStack.push(DGN);
-            TIt++;
+        if (!Reachable.insert(Top).second) continue;
+
+        for (auto &Out: Top->getOutVertices()) {
+            for (auto Tar: Out.Nodes) {
+                DyckGraphNode *DGN = Vertices[Tar];
+                if (!Reachable.count(DGN))
+                    WorkStack.push(DGN);
+            }
         }
     }
 }
@@ -380,4 +617,4 @@ void DyckGraph::getReachableVertices(DyckGraphNode *Source, std::set<DyckGraphNo
     std::set<DyckGraphNode *> Srcs;
     Srcs.insert(Source);
     getReachableVertices(Srcs, Reachable);
-}
\ No newline at end of file
+}
@@ -16,14 +16,17 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cassert>
+#include "DyckAA/DyckGraph.h"
+#include "DyckAA/DyckGraphEdgeLabel.h"
 #include "DyckAA/DyckGraphNode.h"
 
-int DyckGraphNode::GlobalNodeIndex = 0;
-
-DyckGraphNode::DyckGraphNode(void *V, const char *Name) {
+DyckGraphNode::DyckGraphNode(DyckGraph *G, unsigned Idx, unsigned CIdx, const char *Name) {
+    Graph = G;
+    NodeIndex = Idx;
+    ClassIdx = CIdx;
     NodeName = Name;
-    NodeIndex = GlobalNodeIndex++;
-    if (V) EquivClass.insert(V);
 }
 
 DyckGraphNode::~DyckGraphNode() = default;
@@ -32,123 +35,129 @@ const char *DyckGraphNode::getName() {
     return NodeName;
 }
 
-unsigned int DyckGraphNode::outNumVertices(void *Label) {
-    auto It = OutNodes.find(Label);
-    if (It != OutNodes.end()) {
-        return It->second.size();
-    }
-    return 0;
+unsigned DyckGraphNode::getIndex() const {
+    return NodeIndex;
 }
 
-unsigned int DyckGraphNode::inNumVertices(void *Label) {
-    auto It = InNodes.find(Label);
-    if (It != InNodes.end()) {
-        return It->second.size();
-    }
-    return 0;
+DyckGraphNode::EdgeBucket *DyckGraphNode::findBucket(EdgeBucketList &Buckets, unsigned Label) {
+    auto It = std::lower_bound(Buckets.begin(), Buckets.end(), Label,
+                               [](const EdgeBucket &B, unsigned L) { return B.Label < L; });
+    if (It != Buckets.end() && It->Label == Label) return &*It;
+    return nullptr;
 }
 
-unsigned int DyckGraphNode::degree() {
-    unsigned int Ret = 0;
-
-    auto IIt = InNodes.begin();
-    while (IIt != InNodes.end()) {
-        Ret = Ret + IIt->second.size();
-        IIt++;
-    }
-
-    auto OIt = OutNodes.begin();
-    while (OIt != OutNodes.end()) {
-        Ret = Ret + OIt->second.size();
-        OIt++;
-    }
-
-    return Ret;
+const DyckGraphNode::EdgeBucket *DyckGraphNode::findBucket(const EdgeBucketList &Buckets, unsigned Label) {
+    return findBucket(const_cast<EdgeBucketList &>(Buckets), Label);
 }
 
-std::set<void *> *DyckGraphNode::getEquivalentSet() {
-    return &this->EquivClass;
+DyckGraphNode::EdgeBucket &DyckGraphNode::getOrInsertBucket(EdgeBucketList &Buckets, unsigned Label) {
+    auto It = std::lower_bound(Buckets.begin(), Buckets.end(), Label,
+                               [](const EdgeBucket &B, unsigned L) { return B.Label < L; });
+    if (It != Buckets.end() && It->Label == Label) return *It;
+    return *Buckets.insert(It, EdgeBucket(Label));
 }
 
-void DyckGraphNode::mvEquivalentSetTo(DyckGraphNode *RootRep) {
-    if (RootRep == this) return;
-
-    std::set<void *> *RootEC = RootRep->getEquivalentSet();
-    std::set<void *> *ThisEC = this->getEquivalentSet();
-    RootEC->insert(ThisEC->begin(), ThisEC->end());
+unsigned int DyckGraphNode::outNumVertices(DyckGraphEdgeLabel *Label) {
+    return outNumVertices(Label->getID());
 }
 
-std::set<void *> &DyckGraphNode::getOutLabels() {
-    return OutLables;
+unsigned DyckGraphNode::outNumVertices(unsigned Label) const {
+    auto *B = findBucket(OutEdges, Label);
+    return B ? B->Nodes.size() : 0;
 }
 
-std::map<void *, std::set<DyckGraphNode *>> &DyckGraphNode::getOutVertices() {
-    return OutNodes;
+unsigned int DyckGraphNode::inNumVertices(DyckGraphEdgeLabel *Label) {
+    auto *B = findBucket(InEdges, Label->getID());
+    if (!B) return 0;
+    // in buckets may still refer to vertices that have been merged away
+    unsigned Ret = 0;
+    for (auto Src: B->Nodes)
+        if (Graph->getVertex(Src)) ++Ret;
+    return Ret;
 }
 
-std::set<void *> &DyckGraphNode::getInLabels() {
-    return InLables;
+std::set<void *> *DyckGraphNode::getEquivalentSet() {
+    if (!EquivClassValid) {
+        Graph->collectEquivalentSet(ClassIdx, EquivClass);
+        EquivClassValid = true;
+    }
+    return &this->EquivClass;
 }
 
-std::map<void *, std::set<DyckGraphNode *>> &DyckGraphNode::getInVertices() {
-    return InNodes;
+void DyckGraphNode::addTarget(DyckGraphNode *Node, DyckGraphEdgeLabel *Label) {
+    assert(Node->Graph == Graph);
+    addTarget(Node->getIndex(), Label->getID());
 }
 
-int DyckGraphNode::getIndex() const {
-    return NodeIndex;
-}
+bool DyckGraphNode::addTarget(unsigned NodeIdx, unsigned Label) {
+    auto &Tars = getOrInsertBucket(OutEdges, Label).Nodes;
+    auto It = std::lower_bound(Tars.begin(), Tars.end(), NodeIdx);
+    if (It != Tars.end() && *It == NodeIdx) return false;
+    Tars.insert(It, NodeIdx);
+    ++NumOutEdges;
 
-void DyckGraphNode::addTarget(DyckGraphNode *Node, void *Label) {
-    OutLables.insert(Label);
-    OutNodes[Label].insert(Node);
-    Node->addSource(this, Label);
+    auto *Node = Graph->getVertex(NodeIdx);
+    getOrInsertBucket(Node->InEdges, Label).Nodes.push_back(NodeIndex);
+    ++Node->NumInEdges;
+    return true;
 }
 
-void DyckGraphNode::removeTarget(DyckGraphNode *Node, void *Label) {
-    auto It = OutNodes.find(Label);
-    if (It != OutNodes.end())
-        It->second.erase(Node);
-    Node->removeSource(this, Label);
+void DyckGraphNode::removeTarget(DyckGraphNode *Node, DyckGraphEdgeLabel *Label) {
+    removeTarget(Node->getIndex(), Label->getID());
 }
 
-bool DyckGraphNode::containsTarget(DyckGraphNode *Tar, void *Label) {
-    auto It = OutNodes.find(Label);
-    if (It != OutNodes.end()) return It->second.count(Tar);
-    return false;
-}
+bool DyckGraphNode::removeTarget(unsigned NodeIdx, unsigned Label) {
+    auto *Out = findBucket(OutEdges, Label);
+    if (!Out) return false;
+    auto It = std::lower_bound(Out->Nodes.begin(), Out->Nodes.end(), NodeIdx);
+    if (It == Out->Nodes.end() || *It != NodeIdx) return false;
+    Out->Nodes.erase(It);
+    --NumOutEdges;
+    if (Out->Nodes.empty()) OutEdges.erase(Out);
 
-std::set<DyckGraphNode *> *DyckGraphNode::getInVertices(void *Label) {
-    auto It = InNodes.find(Label);
-    if (It != InNodes.end()) return &It->second;
-    return nullptr;
+    auto *Node = Graph->getVertex(NodeIdx);
+    auto *In = findBucket(Node->InEdges, Label);
+    assert(In);
+    auto SrcIt = std::find(In->Nodes.begin(), In->Nodes.end(), NodeIndex);
+    assert(SrcIt != In->Nodes.end());
+    *SrcIt = In->Nodes.back();
+    In->Nodes.pop_back();
+    --Node->NumInEdges;
+    if (In->Nodes.empty()) Node->InEdges.erase(In);
+    return true;
 }
 
-std::set<DyckGraphNode *> *DyckGraphNode::getOutVertices(void *Label) {
-    auto It = OutNodes.find(Label);
-    if (It != OutNodes.end()) return &It->second;
-    return nullptr;
+bool DyckGraphNode::containsTarget(DyckGraphNode *Tar, DyckGraphEdgeLabel *Label) {
+    return containsTarget(Tar->getIndex(), Label->getID());
 }
 
-DyckGraphNode *DyckGraphNode::getInVertex(void *Label) {
-    auto *Set = getInVertices(Label);
-    if (Set && Set->size() == 1) return *Set->begin();
-    return nullptr;
+bool DyckGraphNode::containsTarget(unsigned NodeIdx, unsigned Label) const {
+    auto *Out = findBucket(OutEdges, Label);
+    if (!Out) return false;
+    return std::binary_search(Out->Nodes.begin(), Out->Nodes.end(), NodeIdx);
 }
 
-DyckGraphNode *DyckGraphNode::getOutVertex(void *Label) {
-    auto *Set = getOutVertices(Label);
-    if (Set && Set->size() == 1) return *Set->begin();
-    return nullptr;
+DyckGraphNode *DyckGraphNode::getInVertex(DyckGraphEdgeLabel *Label) {
+    auto *In = findBucket(InEdges, Label->getID());
+    if (!In) return nullptr;
+    DyckGraphNode *Ret = nullptr;
+    for (auto Src: In->Nodes) {
+        auto *SrcNode = Graph->getVertex(Src);
+        if (!SrcNode) continue;
+        if (Ret) return nullptr;
+        Ret = SrcNode;
+    }
+    return Ret;
 }
 
-// the followings are private functions
-
-void DyckGraphNode::addSource(DyckGraphNode *Node, void *Label) {
-    InLables.insert(Label);
-    InNodes[Label].insert(Node);
+DyckGraphNode *DyckGraphNode::getOutVertex(DyckGraphEdgeLabel *Label) {
+    auto *Out = findBucket(OutEdges, Label->getID());
+    if (Out && Out->Nodes.size() == 1) return Graph->getVertex(Out->Nodes[0]);
+    return nullptr;
 }
 
-void DyckGraphNode::removeSource(DyckGraphNode *Node, void *Label) {
-    auto It = InNodes.find(Label);
-    if (It != InNodes.end()) It->second.erase(Node);
+DyckGraphNode *DyckGraphNode::getFirstOutVertex(DyckGraphEdgeLabel *Label) {
+    auto *Out = findBucket(OutEdges, Label->getID());
+    if (Out) return Graph->getVertex(Out->Nodes[0]);
+    return nullptr;
 }
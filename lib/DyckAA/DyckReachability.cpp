@@ -0,0 +1,165 @@
+/*
+ *  Canary features a fast unification-based alias analysis for C programs
+ *  Copyright (C) 2021 Qingkai Shi <qingkaishi@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <climits>
+#include "DyckReachability.h"
+
+static cl::opt<unsigned> ReachCacheLimit("dyckaa-reach-cache-limit", cl::init(512), cl::Hidden,
+                                         cl::desc("The memory (MB) of the cached reachable sets of the points-to graph"));
+
+/// the estimated memory of a bitset, i.e., the elements of its linked list
+static size_t estimateBytes(const SparseBitVector<> &BV) {
+    size_t NumElements = 0;
+    unsigned LastElement = UINT_MAX;
+    for (unsigned Bit: BV) {
+        unsigned Element = Bit / SparseBitVectorElement<128>::BITS_PER_ELEMENT;
+        if (Element != LastElement) {
+            ++NumElements;
+            LastElement = Element;
+        }
+    }
+    return NumElements * (sizeof(SparseBitVectorElement<128>) + 2 * sizeof(void *));
+}
+
+DyckReachability::DyckReachability(DyckGraph *DG) : DG(DG) {
+    auto &Vertices = DG->getVertices();
+    unsigned NumVertices = Vertices.size();
+
+    // tarjan's algorithm without recursion, which numbers a component after all its successors
+    Components.assign(NumVertices, UINT_MAX);
+    std::vector<unsigned> DFN(NumVertices, UINT_MAX), Low(NumVertices);
+    std::vector<unsigned> SCCStack, CallStack;
+    std::vector<std::pair<unsigned, unsigned>> OutEdges; // the edges of the vertices on the call stack
+    std::vector<unsigned> EdgeBegin(NumVertices), EdgeCursor(NumVertices);
+    unsigned NumComponents = 0, Counter = 0;
+    auto Visit = [&](unsigned V) {
+        DFN[V] = Low[V] = Counter++;
+        SCCStack.push_back(V);
+        CallStack.push_back(V);
+        EdgeBegin[V] = EdgeCursor[V] = OutEdges.size();
+        for (auto &Out: Vertices[V]->getOutVertices())
+            for (auto Tar: Out.Nodes) OutEdges.emplace_back(V, Tar);
+    };
+    for (unsigned Root = 0; Root < NumVertices; ++Root) {
+        if (DFN[Root] != UINT_MAX) continue;
+        Visit(Root);
+        while (!CallStack.empty()) {
+            unsigned V = CallStack.back();
+            if (EdgeCursor[V] < OutEdges.size() && OutEdges[EdgeCursor[V]].first == V) {
+                unsigned W = OutEdges[EdgeCursor[V]++].second;
+                if (DFN[W] == UINT_MAX) Visit(W);
+                else if (Components[W] == UINT_MAX) Low[V] = std::min(Low[V], DFN[W]);
+                continue;
+            }
+            CallStack.pop_back();
+            OutEdges.resize(EdgeBegin[V]);
+            if (!CallStack.empty()) Low[CallStack.back()] = std::min(Low[CallStack.back()], Low[V]);
+            if (Low[V] != DFN[V]) continue;
+            unsigned W;
+            do {
+                W = SCCStack.back();
+                SCCStack.pop_back();
+                Components[W] = NumComponents;
+            } while (W != V);
+            ++NumComponents;
+        }
+    }
+
+    // the condensed graph
+    std::vector<std::vector<unsigned>> Members(NumComponents);
+    for (unsigned V = 0; V < NumVertices; ++V) Members[Components[V]].push_back(V);
+    SuccBegin.reserve(NumComponents + 1);
+    for (unsigned C = 0; C < NumComponents; ++C) {
+        SuccBegin.push_back(Succs.size());
+        for (auto V: Members[C]) {
+            for (auto &Out: Vertices[V]->getOutVertices())
+                for (auto Tar: Out.Nodes)
+                    if (Components[Tar] != C) Succs.push_back(Components[Tar]);
+        }
+        std::sort(Succs.begin() + SuccBegin.back(), Succs.end());
+        Succs.erase(std::unique(Succs.begin() + SuccBegin.back(), Succs.end()), Succs.end());
+    }
+    SuccBegin.push_back(Succs.size());
+    Cache.resize(NumComponents);
+}
+
+const SparseBitVector<> *DyckReachability::cache(unsigned C) {
+    size_t Limit = (size_t) ReachCacheLimit.getValue() * 1024 * 1024;
+    // post-order over the condensed graph, a component is cached after all its successors
+    std::vector<std::pair<unsigned, unsigned>> Stack; // (component, next successor)
+    Stack.emplace_back(C, SuccBegin[C]);
+    while (!Stack.empty()) {
+        auto &Top = Stack.back();
+        unsigned X = Top.first;
+        if (Top.second < SuccBegin[X + 1]) {
+            unsigned Y = Succs[Top.second++];
+            if (!Cache[Y]) Stack.emplace_back(Y, SuccBegin[Y]);
+            continue;
+        }
+        Stack.pop_back();
+        if (Cache[X]) continue; // reached twice via different paths
+        if (CachedBytes >= Limit) return nullptr;
+        auto *Set = new SparseBitVector<>;
+        Set->set(X);
+        for (unsigned K = SuccBegin[X]; K < SuccBegin[X + 1]; ++K) *Set |= *Cache[Succs[K]];
+        Cache[X].reset(Set);
+        CachedBytes += estimateBytes(*Set);
+        ++NumCached;
+    }
+    return Cache[C].get();
+}
+
+void DyckReachability::addReachable(unsigned C, SparseBitVector<> &Reachable) {
+    if (Reachable.test(C)) return;
+    std::lock_guard<std::mutex> Lock(CacheMutex);
+    const SparseBitVector<> *Set = Cache[C].get();
+    if (!Set) Set = cache(C);
+    if (Set) {
+        Reachable |= *Set;
+        return;
+    }
+
+    // the cache is full, traverse the condensed graph and reuse the cached sets on the way
+    ++NumUncachedQueries;
+    std::vector<unsigned> WorkStack;
+    WorkStack.push_back(C);
+    Reachable.set(C);
+    while (!WorkStack.empty()) {
+        unsigned X = WorkStack.back();
+        WorkStack.pop_back();
+        if (Cache[X]) {
+            Reachable |= *Cache[X];
+            continue;
+        }
+        for (unsigned K = SuccBegin[X]; K < SuccBegin[X + 1]; ++K) {
+            unsigned Y = Succs[K];
+            if (Reachable.test(Y)) continue;
+            Reachable.set(Y);
+            WorkStack.push_back(Y);
+        }
+    }
+}
+
+void DyckReachability::printStatistics(raw_ostream &O) const {
+    O << numComponents() << " components, " << NumCached << " reachable sets cached, "
+      << (CachedBytes + 1023) / 1024 << " KB, " << NumUncachedQueries << " uncached queries";
+}
@@ -0,0 +1,98 @@
+/*
+ *  Canary features a fast unification-based alias analysis for C programs
+ *  Copyright (C) 2021 Qingkai Shi <qingkaishi@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DYCKAA_DYCKREACHABILITY_H
+#define DYCKAA_DYCKREACHABILITY_H
+
+#include <llvm/ADT/SparseBitVector.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "DyckAA/DyckGraph.h"
+
+using namespace llvm;
+
+/// Answers the reachability queries on a points-to graph that is no longer modified.
+/// The strongly connected components of the graph are condensed once, and numbered so that
+/// every component has a larger number than its successors (the reverse topological order).
+/// The components reachable from a component are cached as a shared bitset of the numbers,
+/// until the cache exceeds the limit set by -dyckaa-reach-cache-limit.
+/// The queries are thread-safe, and they fill the cache one at a time.
+class DyckReachability {
+private:
+    DyckGraph *DG;
+
+    /// the component of each vertex, indexed by the vertex index
+    std::vector<unsigned> Components;
+
+    /// successors of each component in the condensed graph, in the CSR layout
+    /// @{
+    std::vector<unsigned> SuccBegin;
+    std::vector<unsigned> Succs;
+    /// @}
+
+    /// the components reachable from each component (including itself), null if not cached
+    std::vector<std::unique_ptr<SparseBitVector<>>> Cache;
+
+    /// the estimated memory of the cache
+    size_t CachedBytes = 0;
+
+    /// the lock of the cache and the statistics
+    std::mutex CacheMutex;
+
+    /// statistics
+    /// @{
+    unsigned NumCached = 0;
+    unsigned NumUncachedQueries = 0;
+    /// @}
+
+public:
+    /// Condense the graph, which is compacted first and must not be modified afterwards.
+    explicit DyckReachability(DyckGraph *DG);
+
+    /// The number of the strongly connected components
+    unsigned numComponents() const { return SuccBegin.size() - 1; }
+
+    /// Get the component of a vertex
+    unsigned getComponent(DyckGraphNode *N) const { return Components[N->getIndex()]; }
+
+    /// Add the components reachable from the component \p C (including itself) to \p Reachable.
+    /// \p Reachable must be empty or only contain the results of this function, because its components
+    /// are regarded as visited.
+    void addReachable(unsigned C, SparseBitVector<> &Reachable);
+
+    /// Add the components reachable from the vertex \p N (including its own) to \p Reachable, see above.
+    void addReachable(DyckGraphNode *N, SparseBitVector<> &Reachable) { addReachable(getComponent(N), Reachable); }
+
+    /// Return true if \p N is in a component of \p Reachable
+    bool contains(const SparseBitVector<> &Reachable, DyckGraphNode *N) const {
+        return N && Reachable.test(getComponent(N));
+    }
+
+    /// Print the statistics of the cache in the style of RecursiveTimer
+    void printStatistics(raw_ostream &O) const;
+
+private:
+    /// Compute and cache the reachable components of \p C, and the ones of its descendants.
+    /// Return null if the cache reaches its limit before \p C is cached.
+    const SparseBitVector<> *cache(unsigned C);
+};
+
+#endif //DYCKAA_DYCKREACHABILITY_H
@@ -16,8 +16,15 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <llvm/ADT/DenseMapInfo.h>
+#include <llvm/ADT/MapVector.h>
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/MathExtras.h>
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include "DyckAA/DyckAliasAnalysis.h"
 #include "DyckAA/DyckGraph.h"
 #include "DyckAA/DyckGraphNode.h"
@@ -27,24 +34,67 @@
 #include "Support/RecursiveTimer.h"
 #include "Support/ThreadPool.h"
 
+static cl::opt<bool> SparseStoreLoadMatching("dyckvfg-sparse-matching", cl::init(true), cl::Hidden,
+                                             cl::desc("Match the stores and the loads of a function block by block, "
+                                                      "instead of querying the reachability of each pair"));
+
+static cl::opt<bool> PrintLocalVFGStatistics("print-dyckvfg-local-stats", cl::init(false), cl::Hidden,
+                                             cl::desc("Print the time and the reachability queries of matching "
+                                                      "the stores and the loads in each function"));
+
+static cl::opt<bool> UseHubNodes("dyckvfg-hub-nodes", cl::init(false), cl::Hidden,
+                                 cl::desc("Connect the mod/ref values of a caller and a callee through a node of the "
+                                          "call, instead of connecting each pair of them"));
+
 DyckVFG::DyckVFG(DyckAliasAnalysis *DAA, DyckModRefAnalysis *DMRA, Module *M) {
     // create a VFG for each function
-    std::map<Function *, CFGRef> LocalCFGMap;
+    std::vector<Function *> Functions;
     for (auto &F: *M) {
         if (F.empty()) continue;
-        LocalCFGMap[&F] = nullptr;
+        Functions.push_back(&F);
         buildLocalVFG(F);
     }
 
-    for (auto &F: *M) {
-        if (F.empty()) continue;
-        ThreadPool::get()->enqueue([this, DAA, &F, &LocalCFGMap](){
-            auto LocalCFG = std::make_shared<CFG>(&F);
-            LocalCFGMap.at(&F) = LocalCFG;
-            buildLocalVFG(DAA, LocalCFG.get(), &F);
+    // the value flows through memory are found in parallel, each task only reads the graph and buffers its edges,
+    // because a stored value, e.g., a global or a constant, may be shared by many functions
+    std::vector<CFGRef> LocalCFGs(Functions.size());
+    std::vector<EdgeVecTy> LocalEdges(Functions.size());
+    // the number of reachability queries and the microseconds of each function
+    std::vector<std::pair<unsigned, long>> LocalStats(Functions.size());
+    {
+        RecursiveTimer LocalTimer("Building local VFGs");
+        for (unsigned K = 0; K < Functions.size(); ++K) {
+            ThreadPool::get()->enqueue([this, DAA, K, &Functions, &LocalCFGs, &LocalEdges, &LocalStats]() {
+                auto Begin = std::chrono::steady_clock::now();
+                LocalCFGs[K] = std::make_shared<CFG>(Functions[K]);
+                LocalStats[K].first = buildLocalVFG(DAA, LocalCFGs[K].get(), Functions[K], LocalEdges[K]);
+                auto End = std::chrono::steady_clock::now();
+                LocalStats[K].second = std::chrono::duration_cast<std::chrono::microseconds>(End - Begin).count();
+            });
+        }
+        ThreadPool::get()->wait();
+
+        // the buffered edges are added in the order of the functions, so the graph does not depend on the threads
+        for (auto &Edges: LocalEdges) {
+            for (auto &Edge: Edges) Edge.first->addTarget(Edge.second);
+            EdgeVecTy().swap(Edges);
+        }
+    }
+
+    if (PrintLocalVFGStatistics) {
+        std::vector<unsigned> Sorted(Functions.size());
+        for (unsigned K = 0; K < Functions.size(); ++K) Sorted[K] = K;
+        std::stable_sort(Sorted.begin(), Sorted.end(), [&LocalStats](unsigned A, unsigned B) {
+            return LocalStats[A].second > LocalStats[B].second;
         });
+        for (auto K: Sorted) {
+            outs() << "[DyckVFG] " << Functions[K]->getName() << ": " << LocalStats[K].first
+                   << " reachability queries, " << LocalStats[K].second << "us\n";
+        }
     }
-    ThreadPool::get()->wait();
+
+    std::map<Function *, CFGRef> LocalCFGMap;
+    for (unsigned K = 0; K < Functions.size(); ++K) LocalCFGMap[Functions[K]] = std::move(LocalCFGs[K]);
 
     // connect local VFGs
     auto *DyckCG = DAA->getDyckCallGraph();
@@ -70,6 +120,8 @@ DyckVFG::DyckVFG(DyckAliasAnalysis *DAA, DyckModRefAnalysis *DMRA, Module *M) {
             }
         }
     }
+
+    freeze();
 }
 
 void DyckVFG::buildLocalVFG(Function &F) {
@@ -114,7 +166,7 @@ void DyckVFG::buildLocalVFG(Function &F) {
     }
 }
 
-void DyckVFG::buildLocalVFG(DyckAliasAnalysis *DAA, CFG *CtrlFlow, Function *F) const {
+unsigned DyckVFG::buildLocalVFG(DyckAliasAnalysis *DAA, CFG *CtrlFlow, Function *F, EdgeVecTy &Edges) const {
     // indirect value flow through load/store
     auto *DG = DAA->getDyckGraph();
     std::map<DyckGraphNode *, std::vector<LoadInst *>> LoadMap; // ptr -> load
@@ -130,48 +182,171 @@ void DyckVFG::buildLocalVFG(DyckAliasAnalysis *DAA, CFG *CtrlFlow, Function *F)
             if (DV) StoreMap[DV].push_back(Store);
         }
     }
+
     // match load and store:
     // if alias(load's ptr, store's ptr) and store -> load in CFG, add store's value -> load's value in VFG
+    unsigned NumQueries = 0;
+    if (!SparseStoreLoadMatching) {
+        for (auto &LoadIt: LoadMap) {
+            auto *DyckNode = LoadIt.first;
+            auto &Loads = LoadIt.second;
+            auto StoreIt = StoreMap.find(DyckNode);
+            if (StoreIt == StoreMap.end()) continue;
+            auto &Stores = StoreIt->second;
+            for (auto *Load: Loads) {
+                auto *LdNode = getVFGNode(Load);
+                assert(LdNode);
+                for (auto *Store: Stores) {
+                    ++NumQueries;
+                    if (CtrlFlow->reachable(Store, Load)) {
+                        auto *StNode = getVFGNode(Store->getValueOperand());
+                        assert(StNode);
+                        Edges.emplace_back(StNode, LdNode);
+                    }
+                }
+            }
+        }
+        return NumQueries;
+    }
+
+    // the stores of a class are grouped by their blocks, and the loads of a block share the stores from other
+    // blocks, so that the reachability is queried once per pair of blocks instead of once per pair of instructions
     for (auto &LoadIt: LoadMap) {
-        auto *DyckNode = LoadIt.first;
-        auto &Loads = LoadIt.second;
-        auto StoreIt = StoreMap.find(DyckNode);
+        auto StoreIt = StoreMap.find(LoadIt.first);
         if (StoreIt == StoreMap.end()) continue;
-        auto &Stores = StoreIt->second;
-        for (auto *Load: Loads) {
-            auto *LdNode = getVFGNode(Load);
-            assert(LdNode);
-            for (auto *Store: Stores) {
-                if (CtrlFlow->reachable(Store, Load)) {
-                    auto *StNode = getVFGNode(Store->getValueOperand());
+
+        // the stores are in the order of the instructions, so are the loads and the stores in a block
+        MapVector<BasicBlock *, SmallVector<StoreInst *, 4>> StoreBlocks;
+        for (auto *Store: StoreIt->second) StoreBlocks[Store->getParent()].push_back(Store);
+
+        auto &Loads = LoadIt.second;
+        for (unsigned Begin = 0, End; Begin < Loads.size(); Begin = End) {
+            auto *LoadBlock = Loads[Begin]->getParent();
+            for (End = Begin + 1; End < Loads.size() && Loads[End]->getParent() == LoadBlock;) ++End;
+
+            SmallVector<DyckVFGNode *, 8> Reaching;
+            for (auto &StoreBlockIt: StoreBlocks) {
+                if (StoreBlockIt.first == LoadBlock) continue;
+                ++NumQueries;
+                if (!CtrlFlow->reachable(StoreBlockIt.first, LoadBlock)) continue;
+                for (auto *Store: StoreBlockIt.second) Reaching.push_back(getVFGNode(Store->getValueOperand()));
+            }
+
+            // a store in the same block reaches the load only if it is executed before the load
+            auto LocalStoreIt = StoreBlocks.find(LoadBlock);
+            unsigned NumLocalStores = 0;
+            for (unsigned K = Begin; K < End; ++K) {
+                auto *LdNode = getVFGNode(Loads[K]);
+                assert(LdNode);
+                if (LocalStoreIt != StoreBlocks.end()) {
+                    auto &LocalStores = LocalStoreIt->second;
+                    for (; NumLocalStores < LocalStores.size() &&
+                           CtrlFlow->reachable(LocalStores[NumLocalStores], Loads[K]); ++NumLocalStores)
+                        Reaching.push_back(getVFGNode(LocalStores[NumLocalStores]->getValueOperand()));
+                }
+                for (auto *StNode: Reaching) {
                     assert(StNode);
-                    StNode->addTarget(LdNode);
+                    Edges.emplace_back(StNode, LdNode);
                 }
             }
         }
     }
+    return NumQueries;
 }
 
-DyckVFG::~DyckVFG() {
-    for (auto &It: ValueNodeMap) delete It.second;
+DyckVFG::~DyckVFG() = default;
+
+static inline size_t hashFrozenKey(const Value *V) {
+    return DenseMapInfo<const Value *>::getHashValue(V);
 }
 
 DyckVFGNode *DyckVFG::getVFGNode(Value *V) const {
-    auto It = ValueNodeMap.find(V);
-    if (It == ValueNodeMap.end()) return nullptr;
-    return It->second;
+    if (FrozenIndex.empty()) {
+        auto It = ValueNodeMap.find(V);
+        if (It == ValueNodeMap.end()) return nullptr;
+        return It->second;
+    }
+    unsigned ID = getNodeID(V);
+    return ID == UINT_MAX ? nullptr : Nodes[ID];
+}
+
+unsigned DyckVFG::getNodeID(const Value *V) const {
+    assert(!FrozenIndex.empty() && "The graph has not been frozen!");
+    for (size_t Slot = hashFrozenKey(V) & FrozenMask;; Slot = (Slot + 1) & FrozenMask) {
+        auto &Entry = FrozenIndex[Slot];
+        if (Entry.first == V || !Entry.first) return Entry.second;
+    }
+}
+
+void DyckVFG::printEdgeStatistics(raw_ostream &O) const {
+    size_t Bytes = 0;
+    for (auto *CSR: {&Forward, &Backward})
+        Bytes += (CSR->Offsets.size() + CSR->Nodes.size()) * sizeof(unsigned) + CSR->Labels.size() * sizeof(int);
+    Bytes += FrozenIndex.size() * sizeof(FrozenIndex[0]);
+    O << numEdges() << " edges, " << (Bytes + 1023) / 1024 << " KB";
 }
 
 DyckVFGNode *DyckVFG::getOrCreateVFGNode(Value *V) {
+    assert(FrozenIndex.empty() && "The graph has been frozen!");
     auto It = ValueNodeMap.find(V);
     if (It == ValueNodeMap.end()) {
-        auto *Ret = new DyckVFGNode(V);
+        auto *Ret = new(NodeArena.allocate()) DyckVFGNode(V, Nodes.size());
+        Nodes.push_back(Ret);
         ValueNodeMap[V] = Ret;
         return Ret;
     }
     return It->second;
 }
 
+DyckVFGNode *DyckVFG::createHubNode() {
+    assert(FrozenIndex.empty() && "The graph has been frozen!");
+    auto *Ret = new(NodeArena.allocate()) DyckVFGNode(nullptr, Nodes.size());
+    Nodes.push_back(Ret);
+    return Ret;
+}
+
+void DyckVFG::freeze() {
+    // the edges of a node are sorted by the ids of the other ends, so that the arrays do not depend on the addresses
+    auto Build = [this](CSRTy &CSR, DyckVFGNode::EdgeSetTy DyckVFGNode::*Edges) {
+        size_t NumEdges = 0;
+        for (auto *N: Nodes) NumEdges += (N->*Edges).size();
+        CSR.Offsets.resize(Nodes.size() + 1);
+        CSR.Nodes.resize(NumEdges);
+        CSR.Labels.resize(NumEdges);
+        std::vector<std::pair<unsigned, int>> Sorted;
+        unsigned Offset = 0;
+        for (auto *N: Nodes) {
+            CSR.Offsets[N->ID] = Offset;
+            Sorted.clear();
+            for (auto &Edge: N->*Edges) Sorted.emplace_back(Edge.first->ID, Edge.second);
+            std::sort(Sorted.begin(), Sorted.end());
+            for (auto &Edge: Sorted) {
+                CSR.Nodes[Offset] = Edge.first;
+                CSR.Labels[Offset] = Edge.second;
+                ++Offset;
+            }
+        }
+        CSR.Offsets[Nodes.size()] = Offset;
+    };
+    Build(Forward, &DyckVFGNode::Targets);
+    Build(Backward, &DyckVFGNode::Sources);
+    for (auto *N: Nodes) {
+        DyckVFGNode::EdgeSetTy().swap(N->Targets);
+        DyckVFGNode::EdgeSetTy().swap(N->Sources);
+    }
+
+    // keep the load factor at most 1/2, so that probing sequences are short
+    size_t Capacity = NextPowerOf2(ValueNodeMap.size() * 2);
+    FrozenIndex.assign(Capacity, std::make_pair(nullptr, UINT_MAX));
+    FrozenMask = Capacity - 1;
+    for (auto &It: ValueNodeMap) {
+        size_t Slot = hashFrozenKey(It.first) & FrozenMask;
+        while (FrozenIndex[Slot].first) Slot = (Slot + 1) & FrozenMask;
+        FrozenIndex[Slot] = std::make_pair(It.first, It.second->ID);
+    }
+    std::unordered_map<Value *, DyckVFGNode *>().swap(ValueNodeMap);
+}
+
 static void collectValues(std::set<DyckGraphNode *>::iterator Begin, std::set<DyckGraphNode *>::iterator End,
                           std::set<Value *> &CallerVals, std::set<Value *> &CalleeVals, Call *C, Function *Callee,
                           CFG *Ctrl) {
@@ -222,18 +397,31 @@ void DyckVFG::connect(DyckModRefAnalysis *DMRA, Call *C, Function *Callee, CFG *
     //  2. connect ref values (caller) -> ref values (callee)
     std::set<Value *> RefCallerValues, RefCalleeValues;
     collectValues(DMRA->ref_begin(Callee), DMRA->ref_end(Callee), RefCallerValues, RefCalleeValues, C, Callee, Ctrl);
-    for (auto *CallerVal: RefCallerValues)
-        for (auto *CalleeVal: RefCalleeValues)
-            getOrCreateVFGNode(CallerVal)->addTarget(getOrCreateVFGNode(CalleeVal), C->id());
+    connect(RefCallerValues, RefCalleeValues, C->id());
 
     // connect indirect outputs
     //  1. get mods, get mod values (in caller and callee)
     //  2. connect ref values (callee) -> ref values (caller)
     std::set<Value *> ModCallerValues, ModCalleeValues;
     collectValues(DMRA->mod_begin(Callee), DMRA->mod_end(Callee), ModCallerValues, ModCalleeValues, C, Callee, Ctrl);
-    for (auto *CalleeVal: ModCalleeValues)
-        for (auto *CallerVal: ModCallerValues)
-            getOrCreateVFGNode(CalleeVal)->addTarget(getOrCreateVFGNode(CallerVal), -C->id());
+    connect(ModCalleeValues, ModCallerValues, -C->id());
+}
+
+void DyckVFG::connect(const std::set<Value *> &From, const std::set<Value *> &To, int L) {
+    if (From.empty() || To.empty()) return;
+    if (!UseHubNodes || From.size() * To.size() <= From.size() + To.size()) {
+        for (auto *FromVal: From)
+            for (auto *ToVal: To)
+                getOrCreateVFGNode(FromVal)->addTarget(getOrCreateVFGNode(ToVal), L);
+        return;
+    }
+
+    // the hub stands for the memory at the call site in the callee's context, so that a path from a value in From
+    // to a value in To still has exactly one call (return) edge: for a call, From -(L)-> Hub -(0)-> To; for a
+    // return, From -(0)-> Hub -(L)-> To
+    auto *Hub = createHubNode();
+    for (auto *FromVal: From) getOrCreateVFGNode(FromVal)->addTarget(Hub, L > 0 ? L : 0);
+    for (auto *ToVal: To) Hub->addTarget(getOrCreateVFGNode(ToVal), L > 0 ? 0 : L);
 }
 
 Function *DyckVFGNode::getFunction() const {
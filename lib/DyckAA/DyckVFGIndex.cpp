@@ -0,0 +1,172 @@
+/*
+ *  Canary features a fast unification-based alias analysis for C programs
+ *  Copyright (C) 2021 Qingkai Shi <qingkaishi@gmail.com>
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Affero General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Affero General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Affero General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+// the headers of CSIndex declare names such as BitVector in the global namespace,
+// so they are included before any "using namespace llvm"
+#include "CSIndex/Grail.h"
+#include "CSIndex/Graph.h"
+#include "CSIndex/GraphUtil.h"
+
+#include <algorithm>
+#include <climits>
+#include <functional>
+#include <tuple>
+#include "DyckAA/DyckVFGIndex.h"
+#include "Support/RecursiveTimer.h"
+
+DyckVFGIndex::DyckVFGIndex(DyckVFG *VFG, int Dim) : VFG(VFG) {
+    RecursiveTimer Timer("Building the context-sensitive index of DyckVFG");
+
+    // the summary edges are computed with the assumptions that every target of a call edge has no other incoming
+    // edges, that every target of a return edge has no other incoming edges, and that two vertices have at most one
+    // labeled edge in between. none of them holds in DyckVFG, e.g., a value may flow to a formal parameter via
+    // memory, and a global may be passed at two calls to the same function. besides, a summary edge is added
+    // from each source of a call edge to each target of a matched return edge, which are many for the mod/ref
+    // values of a call. thus, the call edges u_i -(L)-> v are converted to u_i -(0)-> a -(L)-> m -(0)-> v, and
+    // the return edges w -(-L)-> t_j are converted to w -(-L)-> r -(0)-> t_j, where a, m, and r are new vertices,
+    // so that the summary edges of a call are from the a's to the r's.
+    unsigned NumNodes = VFG->numNodes();
+    NumVertices = NumNodes;
+    std::vector<std::tuple<unsigned, unsigned, int>> Edges;
+    std::vector<std::pair<int, unsigned>> Labeled; // (label, node at the other end)
+    auto ForEachLabel = [&Labeled](const std::function<void(unsigned Begin, unsigned End)> &Group) {
+        std::sort(Labeled.begin(), Labeled.end());
+        for (unsigned Begin = 0, End; Begin < Labeled.size(); Begin = End) {
+            for (End = Begin + 1; End < Labeled.size() && Labeled[End].first == Labeled[Begin].first;) ++End;
+            Group(Begin, End);
+        }
+    };
+    for (unsigned ID = 0; ID < NumNodes; ++ID) {
+        Labeled.clear();
+        for (auto Edge: VFG->sources(ID))
+            if (Edge.second > 0) Labeled.emplace_back(Edge.second, Edge.first);
+        ForEachLabel([&](unsigned Begin, unsigned End) {
+            unsigned A = NumVertices++, M = NumVertices++;
+            for (unsigned K = Begin; K < End; ++K) Edges.emplace_back(Labeled[K].second, A, 0);
+            Edges.emplace_back(A, M, Labeled[Begin].first);
+            Edges.emplace_back(M, ID, 0);
+        });
+
+        Labeled.clear();
+        for (auto Edge: VFG->targets(ID)) {
+            if (Edge.second < 0) Labeled.emplace_back(Edge.second, Edge.first);
+            else if (!Edge.second) Edges.emplace_back(ID, Edge.first, 0);
+        }
+        ForEachLabel([&](unsigned Begin, unsigned End) {
+            unsigned R = NumVertices++;
+            Edges.emplace_back(ID, R, Labeled[Begin].first);
+            for (unsigned K = Begin; K < End; ++K) Edges.emplace_back(R, Labeled[K].second, 0);
+        });
+    }
+
+    IG = std::make_unique<Graph>(NumVertices);
+    for (unsigned K = 0; K < NumVertices; ++K) IG->addVertex(K);
+    for (auto &Edge: Edges) {
+        if (std::get<2>(Edge)) IG->addEdge(std::get<0>(Edge), std::get<1>(Edge), std::get<2>(Edge));
+        else IG->addEdge(std::get<0>(Edge), std::get<1>(Edge));
+    }
+    decltype(Edges)().swap(Edges);
+
+    IG->build_summary_edges();
+    NumSummaryEdges = IG->summary_edge_size();
+    IG->to_indexing_graph();
+
+    // GraphUtil::mergeSCC() does not scale to large components, so the components are found by tarjan's algorithm
+    // without recursion, and the condensed graph is built from scratch
+    unsigned NumIGVertices = IG->num_vertices();
+    Components.assign(NumIGVertices, -1);
+    std::vector<int> DFN(NumIGVertices, -1), Low(NumIGVertices);
+    std::vector<int> SCCStack;
+    std::vector<std::pair<int, unsigned>> CallStack; // (vertex, next edge)
+    int NumComponents = 0, Counter = 0;
+    for (int Root = 0; Root < (int) NumIGVertices; ++Root) {
+        if (DFN[Root] != -1) continue;
+        DFN[Root] = Low[Root] = Counter++;
+        SCCStack.push_back(Root);
+        CallStack.emplace_back(Root, 0);
+        while (!CallStack.empty()) {
+            int V = CallStack.back().first;
+            auto &Succs = IG->out_edges(V);
+            if (CallStack.back().second < Succs.size()) {
+                int W = Succs[CallStack.back().second++];
+                if (DFN[W] == -1) {
+                    DFN[W] = Low[W] = Counter++;
+                    SCCStack.push_back(W);
+                    CallStack.emplace_back(W, 0);
+                } else if (Components[W] == -1) {
+                    Low[V] = std::min(Low[V], DFN[W]);
+                }
+                continue;
+            }
+            CallStack.pop_back();
+            if (!CallStack.empty()) Low[CallStack.back().first] = std::min(Low[CallStack.back().first], Low[V]);
+            if (Low[V] != DFN[V]) continue;
+            int W;
+            do {
+                W = SCCStack.back();
+                SCCStack.pop_back();
+                Components[W] = NumComponents;
+            } while (W != V);
+            ++NumComponents;
+        }
+    }
+
+    auto DAG = std::make_unique<Graph>(NumComponents);
+    for (int C = 0; C < NumComponents; ++C) DAG->addVertex(C);
+    std::vector<std::vector<int>> Succs(NumComponents);
+    for (unsigned V = 0; V < NumIGVertices; ++V)
+        for (int W: IG->out_edges(V))
+            if (Components[V] != Components[W]) Succs[Components[V]].push_back(Components[W]);
+    for (int C = 0; C < NumComponents; ++C) {
+        std::sort(Succs[C].begin(), Succs[C].end());
+        Succs[C].erase(std::unique(Succs[C].begin(), Succs[C].end()), Succs[C].end());
+        for (int D: Succs[C]) DAG->addEdge(C, D);
+        std::vector<int>().swap(Succs[C]);
+    }
+    IG = std::move(DAG);
+
+    GraphUtil::topo_leveler(*IG);
+    Index = std::make_unique<Grail>(*IG, Dim, 1, false, 100);
+
+    std::string Stats;
+    raw_string_ostream StatsOS(Stats);
+    printStatistics(StatsOS);
+    RecursiveTimer::print(StatsOS.str());
+}
+
+DyckVFGIndex::~DyckVFGIndex() = default;
+
+bool DyckVFGIndex::reach(Value *From, Value *To) {
+    unsigned FromID = VFG->getNodeID(From);
+    unsigned ToID = VFG->getNodeID(To);
+    if (FromID == UINT_MAX || ToID == UINT_MAX) return From == To;
+    return reach(FromID, ToID);
+}
+
+bool DyckVFGIndex::reach(unsigned From, unsigned To) {
+    // a path starts from the copy without calls and ends at the copy without returns
+    ++NumQueries;
+    Index->reset();
+    return Index->reach(Components[From], Components[To + NumVertices]);
+}
+
+void DyckVFGIndex::printStatistics(raw_ostream &O) const {
+    O << "DyckVFG index: " << NumVertices << " vertices, " << NumSummaryEdges << " summary edges, "
+      << IG->num_vertices() << " condensed vertices, " << NumQueries << " queries";
+}
@@ -29,6 +29,7 @@ DyckValueFlowAnalysis::DyckValueFlowAnalysis() : ModulePass(ID) {
 }
 
 DyckValueFlowAnalysis::~DyckValueFlowAnalysis() {
+    VFGIndex.reset();
     delete VFG;
 }
 
@@ -42,10 +43,23 @@ DyckVFG *DyckValueFlowAnalysis::getDyckVFGraph() const {
     return VFG;
 }
 
+DyckVFGIndex *DyckValueFlowAnalysis::getDyckVFGIndex() {
+    if (!VFGIndex) VFGIndex = std::make_unique<DyckVFGIndex>(VFG);
+    return VFGIndex.get();
+}
+
 bool DyckValueFlowAnalysis::runOnModule(Module &M) {
     RecursiveTimer DyckVFA("Running DyckVFA");
     auto *DyckAA = &getAnalysis<DyckAliasAnalysis>();
     auto *DyckMRA = &getAnalysis<DyckModRefAnalysis>();
     VFG = new DyckVFG(DyckAA, DyckMRA, &M);
+
+    std::string Stats;
+    raw_string_ostream StatsOS(Stats);
+    StatsOS << "DyckVFG arena: ";
+    VFG->printArenaStatistics(StatsOS);
+    StatsOS << "; ";
+    VFG->printEdgeStatistics(StatsOS);
+    RecursiveTimer::print(StatsOS.str());
     return false;
 }
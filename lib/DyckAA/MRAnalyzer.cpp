@@ -19,7 +19,27 @@
 #include <llvm/IR/InstIterator.h>
 #include <llvm/IR/Instruction.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <atomic>
+#include <functional>
+#include "DyckReachability.h"
 #include "MRAnalyzer.h"
+#include "Support/RecursiveTimer.h"
+#include "Support/ThreadPool.h"
+
+/// Return the pointer whose pointee is written by a call like memcpy and memset, or null if there is not one
+static Value *getWrittenPointer(Instruction *I) {
+    if (auto *MI = dyn_cast<MemIntrinsic>(I)) return MI->getRawDest();
+    auto *CI = dyn_cast<CallInst>(I);
+    if (!CI || CI->arg_size() == 0) return nullptr;
+    auto *Callee = CI->getCalledFunction();
+    if (!Callee || !Callee->isDeclaration()) return nullptr;
+    auto FName = Callee->getName();
+    if (FName == "memcpy" || FName == "memmove" || FName == "memset" || FName == "bzero" ||
+        FName == "strcpy" || FName == "strncpy" || FName == "strcat" || FName == "strncat")
+        return CI->getArgOperand(0);
+    return nullptr;
+}
 
 MRAnalyzer::MRAnalyzer(Module *M, DyckGraph *DG, DyckCallGraph *DCG) : M(M), DG(DG), DCG(DCG) {
 }
@@ -27,35 +47,142 @@ MRAnalyzer::MRAnalyzer(Module *M, DyckGraph *DG, DyckCallGraph *DCG) : M(M), DG(
 MRAnalyzer::~MRAnalyzer() = default;
 
 void MRAnalyzer::intraProcedureAnalysis() {
+    RecursiveTimer IntraMR("Running intra-procedural analysis");
+
+    // the points-to graph is shared by all the functions, condense it once for the reachability queries
+    {
+        RecursiveTimer CondenseTimer("Condensing the points-to graph");
+        Reachability = std::make_unique<DyckReachability>(DG);
+    }
+
+    // the entries are created before the functions are analyzed in parallel, each of which only writes its own ones
+    std::vector<Function *> Functions;
+    for (auto It = DCG->nodes_begin(), E = DCG->nodes_end(); It != E; ++It) {
+        auto *F = (*It)->getLLVMFunction();
+        if (!F) continue; // there is one and only one fake node that does not include a function
+        Functions.push_back(F);
+        Func2MR[F];
+        Func2Visibility[F];
+    }
+    for (auto *F: Functions) {
+        ThreadPool::get()->enqueue([this, F]() { runOnFunction(F); });
+    }
+    ThreadPool::get()->wait();
 
+    std::string Stats;
+    raw_string_ostream StatsOS(Stats);
+    StatsOS << "DyckMRA reachability: ";
+    Reachability->printStatistics(StatsOS);
+    RecursiveTimer::print(StatsOS.str());
 }
 
 void MRAnalyzer::interProcedureAnalysis() {
-    // fixme let's impl a simple version where we do not use scc and bottom-up inter-proc analysis
-    for (auto It = DCG->nodes_begin(), E = DCG->nodes_end(); It != E; ++It)
-        runOnFunction(*It);
+    RecursiveTimer InterMR("Running inter-procedural analysis");
+
+    // tarjan's algorithm without recursion over the call graph, which outputs the callees before the callers
+    std::vector<std::vector<Function *>> SCCs;
+    std::map<Function *, unsigned> SCCMap;
+    {
+        std::map<Function *, std::pair<unsigned, unsigned>> DFNLow;
+        std::vector<Function *> SCCStack;
+        std::vector<std::pair<Function *, CallRecordVecTy::iterator>> CallStack;
+        unsigned Counter = 0;
+        auto Visit = [&](Function *F) {
+            DFNLow[F] = std::make_pair(Counter, Counter);
+            ++Counter;
+            SCCStack.push_back(F);
+            CallStack.emplace_back(F, DCG->getFunction(F)->child_edge_begin());
+        };
+        for (auto &F: *M) {
+            if (!DCG->getFunction(&F) || DFNLow.count(&F)) continue;
+            Visit(&F);
+            while (!CallStack.empty()) {
+                auto *Caller = CallStack.back().first;
+                auto &EdgeIt = CallStack.back().second;
+                if (EdgeIt != DCG->getFunction(Caller)->child_edge_end()) {
+                    auto *Callee = (EdgeIt++)->second->getLLVMFunction();
+                    if (!Callee) continue;
+                    auto It = DFNLow.find(Callee);
+                    if (It == DFNLow.end()) Visit(Callee);
+                    else if (!SCCMap.count(Callee))
+                        DFNLow[Caller].second = std::min(DFNLow[Caller].second, It->second.first);
+                    continue;
+                }
+                CallStack.pop_back();
+                auto &CallerDFNLow = DFNLow[Caller];
+                if (!CallStack.empty()) {
+                    auto &ParentLow = DFNLow[CallStack.back().first].second;
+                    ParentLow = std::min(ParentLow, CallerDFNLow.second);
+                }
+                if (CallerDFNLow.first != CallerDFNLow.second) continue;
+                SCCs.emplace_back();
+                Function *Member;
+                do {
+                    Member = SCCStack.back();
+                    SCCStack.pop_back();
+                    SCCMap[Member] = SCCs.size() - 1;
+                    SCCs.back().push_back(Member);
+                } while (Member != Caller);
+            }
+        }
+    }
+
+    // the callers of each component, and the number of the callee components that are not done yet
+    std::vector<std::vector<unsigned>> Callers(SCCs.size());
+    std::vector<std::atomic<unsigned>> NumPendingCallees(SCCs.size());
+    for (unsigned K = 0; K < SCCs.size(); ++K) {
+        std::set<unsigned> Callees;
+        for (auto *F: SCCs[K]) {
+            auto *CGNode = DCG->getFunction(F);
+            for (auto It = CGNode->child_begin(), E = CGNode->child_end(); It != E; ++It) {
+                auto *Callee = (*It)->getLLVMFunction();
+                if (Callee && SCCMap.at(Callee) != K) Callees.insert(SCCMap.at(Callee));
+            }
+        }
+        for (auto Callee: Callees) Callers[Callee].push_back(K);
+        NumPendingCallees[K] = Callees.size();
+    }
+
+    if (ThreadPool::get()->Workers.empty()) {
+        // tarjan's algorithm has already sorted the components
+        for (auto &SCC: SCCs) runOnSCC(SCC);
+        return;
+    }
+
+    // a component is analyzed once all its callees are done
+    std::function<void(unsigned)> Schedule = [this, &SCCs, &Callers, &NumPendingCallees, &Schedule](unsigned K) {
+        ThreadPool::get()->enqueue([this, &SCCs, &Callers, &NumPendingCallees, &Schedule, K]() {
+            runOnSCC(SCCs[K]);
+            for (auto Caller: Callers[K])
+                if (--NumPendingCallees[Caller] == 0) Schedule(Caller);
+        });
+    };
+    // the leaves are collected before any of them is done, otherwise a caller would be scheduled twice
+    std::vector<unsigned> Leaves;
+    for (unsigned K = 0; K < SCCs.size(); ++K)
+        if (NumPendingCallees[K] == 0) Leaves.push_back(K);
+    for (auto K: Leaves) Schedule(K);
+    ThreadPool::get()->wait();
 }
 
-void MRAnalyzer::runOnFunction(DyckCallGraphNode *CGNode) {
-    auto *F = CGNode->getLLVMFunction();
-    if (!F) return; // there is one and only one fake node that does not include a function
+bool MRAnalyzer::isVisible(const Visibility &Vis, DyckGraphNode *N) const {
+    // let us exclude explicit parameters, but not the other nodes in their components
+    return Reachability->contains(Vis.ParReachable, N) && !Vis.ParNodes.count(N);
+}
 
-    auto &MR = Func2MR[F];
+void MRAnalyzer::runOnFunction(Function *F) {
+    auto &MR = Func2MR.at(F);
     std::set<DyckGraphNode *> &Refs = MR.Mods;
     std::set<DyckGraphNode *> &Mods = MR.Refs;
 
-    // compute a set of dyck nodes reachable from parameters and todo returns
-    std::set<DyckGraphNode *> ParReachableNodes;
-    std::set<DyckGraphNode *> RetReachableNodes;
-    for (unsigned K = 0; K < F->arg_size(); ++K) {
-        auto *DGNode = DG->findDyckVertex(F->getArg(K));
-        if (!DGNode) continue;
-        DG->getReachableVertices(DGNode, ParReachableNodes);
-    }
+    // compute the components of dyck nodes reachable from parameters and todo returns
+    auto &Vis = Func2Visibility.at(F);
+    SparseBitVector<> RetReachable;
     for (unsigned K = 0; K < F->arg_size(); ++K) {
         auto *DGNode = DG->findDyckVertex(F->getArg(K));
         if (!DGNode) continue;
-        ParReachableNodes.erase(DGNode); // let us exclude explicit parameters
+        Reachability->addReachable(DGNode, Vis.ParReachable);
+        Vis.ParNodes.insert(DGNode);
     }
 
     // for each instruction,
@@ -67,18 +194,48 @@ void MRAnalyzer::runOnFunction(DyckCallGraphNode *CGNode) {
             auto *RefNode = DG->findDyckVertex(Ref);
             if (!RefNode) continue;
             // check if reachable from parameters
-            if (ParReachableNodes.count(RefNode)) Refs.insert(RefNode);
+            if (isVisible(Vis, RefNode)) Refs.insert(RefNode);
         }
         if (F->onlyReadsMemory()) continue; // a read only function
+        Value *Ptr = nullptr;
         if (auto *SI = dyn_cast<StoreInst>(&I)) {
-            auto *Ptr = SI->getPointerOperand();
-            auto *PtrNode = DG->findDyckVertex(Ptr);
-            if (!PtrNode) continue;
-            auto *ModNode = PtrNode->getOutVertex(DG->getDereferenceEdgeLabel());
-            // check if reachable from parameters and returns
-            if (ParReachableNodes.count(ModNode) || RetReachableNodes.count(ModNode)) Mods.insert(ModNode);
+            Ptr = SI->getPointerOperand();
         } else {
+            // memcpy, memset, etc.
             // todo other instructions that may revise a memory
+            Ptr = getWrittenPointer(&I);
+        }
+        if (!Ptr) continue;
+        auto *PtrNode = DG->findDyckVertex(Ptr);
+        if (!PtrNode) continue;
+        auto *ModNode = PtrNode->getOutVertex(DG->getDereferenceEdgeLabel());
+        // check if reachable from parameters and returns
+        if (isVisible(Vis, ModNode) || Reachability->contains(RetReachable, ModNode)) Mods.insert(ModNode);
+    }
+}
+
+void MRAnalyzer::runOnSCC(const std::vector<Function *> &SCC) {
+    // the callees in other components are done, and the ones in this component are iterated to a fixed point
+    bool Changed = true;
+    while (Changed) {
+        Changed = false;
+        for (auto *F: SCC) {
+            auto &MR = Func2MR.at(F);
+            auto &Vis = Func2Visibility.at(F);
+            bool ReadOnly = F->onlyReadsMemory();
+            auto *CGNode = DCG->getFunction(F);
+            for (auto It = CGNode->child_begin(), E = CGNode->child_end(); It != E; ++It) {
+                auto *Callee = (*It)->getLLVMFunction();
+                if (!Callee || Callee == F) continue;
+                auto &CalleeMR = Func2MR.at(Callee);
+                // the effects on the nodes invisible to the callers of F, e.g., its locals, are not propagated
+                for (auto *N: CalleeMR.Mods)
+                    if (isVisible(Vis, N)) Changed |= MR.Mods.insert(N).second;
+                if (ReadOnly) continue;
+                for (auto *N: CalleeMR.Refs)
+                    if (isVisible(Vis, N)) Changed |= MR.Refs.insert(N).second;
+            }
         }
+        if (SCC.size() == 1) break; // the only function does not get anything new from itself
     }
 }
@@ -19,8 +19,11 @@
 #ifndef DYCKAA_MRANALYZER_H
 #define DYCKAA_MRANALYZER_H
 
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SparseBitVector.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/CommandLine.h>
+#include <memory>
 
 #include "DyckAA/DyckCallGraph.h"
 #include "DyckAA/DyckGraph.h"
@@ -28,6 +31,12 @@
 
 using namespace llvm;
 
+class DyckReachability;
+
+/// Computes the mod/ref summaries bottom-up over the call graph. A function first gets a summary of its own
+/// instructions, and then the summaries of its callees are folded into it, so that the strongly connected
+/// components of the call graph are visited in the reverse topological order. Components whose callees are
+/// done are analyzed in parallel.
 class MRAnalyzer {
 private:
     Module *M;
@@ -35,19 +44,36 @@ private:
     DyckCallGraph *DCG;
     std::map<Function *, ModRef> Func2MR;
 
+    /// the dyck nodes visible to the callers of a function, i.e., the ones reachable from its parameters
+    struct Visibility {
+        SparseBitVector<> ParReachable;
+        SmallPtrSet<DyckGraphNode *, 8> ParNodes;
+    };
+    std::map<Function *, Visibility> Func2Visibility;
+
+    std::unique_ptr<DyckReachability> Reachability;
+
 public:
     MRAnalyzer(Module *, DyckGraph *, DyckCallGraph *);
 
     ~MRAnalyzer();
 
+    /// Compute the summaries of the functions without their callees
     void intraProcedureAnalysis();
 
+    /// Fold the summaries of the callees into their callers
     void interProcedureAnalysis();
 
     void swap(std::map<Function *, ModRef> &Result) { Result.swap(Func2MR); }
 
 private:
-    void runOnFunction(DyckCallGraphNode *);
+    void runOnFunction(Function *);
+
+    /// Fold the summaries of the callees into the functions of \p SCC until nothing changes
+    void runOnSCC(const std::vector<Function *> &SCC);
+
+    /// Return true if \p N is reachable from the parameters of a function, except for the explicit parameters
+    bool isVisible(const Visibility &Vis, DyckGraphNode *N) const;
 };
 
 #endif //DYCKAA_MRANALYZER_H
@@ -16,6 +16,8 @@
  *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/PostOrderIterator.h>
 #include <llvm/IR/CFG.h>
 #include <llvm/IR/Dominators.h>
 #include <llvm/IR/Function.h>
@@ -23,36 +25,38 @@
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Intrinsics.h>
 #include <llvm/IR/Type.h>
+#include <queue>
 #include <set>
 #include "NullPointer/LocalNullCheckAnalysis.h"
 #include "Support/API.h"
 
+static cl::opt<bool> SparseNCA("nca-sparse", cl::init(false), cl::Hidden,
+                               cl::desc("Use the sparse engine for the local null check analysis."));
+
 LocalNullCheckAnalysis::LocalNullCheckAnalysis(NullFlowAnalysis *NFA, Function *F) : F(F), NEA(F), NFA(NFA), DT(*F) {
-    // init nca
-    for (unsigned K = 0; K < F->arg_size(); ++K) {
-        auto *Arg = F->getArg(K);
-        if (!Arg->getType()->isPointerTy()) continue;
-        auto ArgX = NEA.get(Arg);
-        if (NFA->notNull(Arg) || NFA->notNull(ArgX)) continue;
-        unsigned ID = PtrIDMap.size();
-        PtrIDMap[ArgX] = ID;
-    }
-    for (auto &I: instructions(*F)) {
-        for (unsigned K = 0; K < I.getNumOperands(); ++K) {
-            auto Op = I.getOperand(K);
-            if (!Op->getType()->isPointerTy()) continue;
-            auto OpX = NEA.get(Op);
-            if (NFA->notNull(OpX) || NFA->notNull(Op)) continue;
-            auto It = PtrIDMap.find(OpX);
-            if (It != PtrIDMap.end()) continue;
-            unsigned ID = PtrIDMap.size();
-            PtrIDMap[NEA.get(OpX)] = ID;
+    // init nca, the ptrs are tracked whatever nfa knows now, so that a function analyzed after nfa has changed
+    // is tracked as if it had been analyzed before, and init() seeds the ones nfa proves non-null
+    DenseSet<Value *> Visited;
+    auto AddPtr = [this, &Visited](Value *Ptr) {
+        if (!Ptr->getType()->isPointerTy() || !Visited.insert(Ptr).second) return;
+        auto PtrX = NEA.get(Ptr);
+        auto It = PtrIDMap.find(PtrX);
+        if (It == PtrIDMap.end()) It = PtrIDMap.emplace(PtrX, PtrIDMap.size()).first;
+        Ptrs.emplace_back(Ptr, It->second);
+        if (Visited.insert(PtrX).second) Ptrs.emplace_back(PtrX, It->second);
+    };
+    for (auto &Arg: F->args()) AddPtr(&Arg);
+    for (auto &I: instructions(*F))
+        for (auto &Op: I.operands()) AddPtr(Op);
+
+    unsigned NumOperands = 0;
+    for (auto &B: *F) {
+        for (auto &I: B) {
+            InstOperandOffsets[&I] = NumOperands;
+            NumOperands += I.getNumOperands();
         }
     }
-
-    for (auto &B: *F) for (auto &I: B) InstNonNullMap[&I] = 0;
-
-    label();
+    NonNullOperands.resize(NumOperands);
 }
 
 LocalNullCheckAnalysis::~LocalNullCheckAnalysis() = default;
@@ -93,253 +97,434 @@ bool LocalNullCheckAnalysis::mayNull(Value *Ptr, Instruction *Inst) {
         }
     }
     assert(IsOperand && "Ptr must be an operand of Inst!");
-    if (K >= 32) return true; // more than 32 operands in this weird instruction
-    auto It = InstNonNullMap.find(Inst);
-    assert(It != InstNonNullMap.end());
-    return !(It->second & (1 << K));
+    if (SparseNCA) {
+        unsigned ID = getPtrID(Ptr);
+        return ID == UINT_MAX || !nonNullBefore(ID, Inst);
+    }
+    auto It = InstOperandOffsets.find(Inst);
+    assert(It != InstOperandOffsets.end());
+    return !NonNullOperands.test(It->second + K);
 }
 
 void LocalNullCheckAnalysis::run() {
     // outs() << "Running on " << F->getName() << " (# Ptrs: " << PtrIDMap.size() << "; # Blocks: " << F->size() << ")\n";
 
-    // 1. init a map from each instruction to a set of nonnull pointers
-    init();
+    // 1. label the unreachable edges, including those of the ptrs proved non-null by nfa since the last run
+    label();
 
-    // 2. fixed-point algorithm for null check analysis
-    nca();
+    // 2. init the facts on the edges between blocks, or seed the newly non-null ptrs into the last fixed point
+    if (!init()) return;
 
-    // 3. tag possible null pointers at each instruction
-    tag();
+    // 3. fixed-point algorithm for null check analysis
+    // 4. tag possible null pointers at each instruction
+    if (SparseNCA) {
+        ncaSparse();
+        tagSparse();
+    } else {
+        nca();
+        tag();
+    }
 
-    // 4. label unreachable edges
+    // 5. label unreachable edges
     label();
 }
 
-void LocalNullCheckAnalysis::init() {
-    for (auto &I: instructions(*F)) {
-        if (I.isTerminator()) {
-            for (unsigned K = 0; K < I.getNumSuccessors(); ++K) {
-                DataflowFacts[{&I, K}] = BitVector(PtrIDMap.size());
-            }
-        } else {
-            DataflowFacts[{&I, 0}] = BitVector(PtrIDMap.size());
-        }
-    }
-    DataflowFacts[{nullptr, 0}] = BitVector(PtrIDMap.size());
+unsigned LocalNullCheckAnalysis::getPtrID(Value *Ptr) {
+    auto It = PtrIDMap.find(NEA.get(Ptr));
+    return It == PtrIDMap.end() ? UINT_MAX : It->second;
 }
 
-void LocalNullCheckAnalysis::tag() {
-    BitVector ResultOfMerging;
-    std::vector<Edge> IncomingEdges;
-    for (auto &I: instructions(*F)) {
-        auto &B = *I.getParent();
-        IncomingEdges.clear();
-        if (&I == &*B.begin()) {
-            for (auto PIt = pred_begin(&B), PE = pred_end(&B); PIt != PE; ++PIt) {
-                auto Term = (*PIt)->getTerminator();
-                for (unsigned K = 0; K < Term->getNumSuccessors(); ++K) {
-                    if (Term->getSuccessor(K) == I.getParent()) {
-                        IncomingEdges.emplace_back(Term, K);
+void LocalNullCheckAnalysis::summarize() {
+    // number the blocks in reverse post-order, so that a forward pass visits the predecessors first
+    auto AddBlock = [this](BasicBlock *B) {
+        if (!BlockIDMap.try_emplace(B, Blocks.size()).second) return;
+        Blocks.emplace_back();
+        Blocks.back().Block = B;
+    };
+    ReversePostOrderTraversal<Function *> RPOT(F);
+    for (auto *B: RPOT) AddBlock(B);
+    for (auto &B: *F) AddBlock(&B);
+
+    auto AddStep = [this](Instruction *Inst, Value *Target, ArrayRef<Value *> Operands) {
+        unsigned TargetID = getPtrID(Target);
+        if (TargetID == UINT_MAX) return;
+        unsigned Begin = StepOperands.size();
+        for (auto *Op: Operands) {
+            // untracked ptrs are non-null
+            unsigned OpID = getPtrID(Op);
+            if (OpID != UINT_MAX) StepOperands.push_back(OpID);
+        }
+        Steps.push_back({Inst, TargetID, Begin, (unsigned) StepOperands.size()});
+    };
+
+    SmallVector<Value *, 8> Operands;
+    for (unsigned BID = 0; BID < Blocks.size(); ++BID) {
+        auto &Summary = Blocks[BID];
+        auto *B = Summary.Block;
+        Summary.BodyUnreachable = false;
+        Summary.Unreachable = false;
+
+        // the non-terminator instructions, in order, since a step may depend on the ptrs set before
+        Summary.StepBegin = Steps.size();
+        for (auto &I: *B) {
+            if (I.isTerminator()) break;
+            auto *Inst = &I;
+            switch (Inst->getOpcode()) {
+                case Instruction::Load:
+                case Instruction::Store:
+                case Instruction::GetElementPtr:
+                    AddStep(Inst, getPointerOperand(Inst), {});
+                    break;
+                case Instruction::Alloca:
+                    AddStep(Inst, Inst, {});
+                    break;
+                case Instruction::AddrSpaceCast:
+                case Instruction::BitCast:
+                    AddStep(Inst, Inst, {Inst->getOperand(0)});
+                    break;
+                case Instruction::PHI:
+                case Instruction::Select:
+                    if (Inst->getType()->isPointerTy()) {
+                        Operands.clear();
+                        for (unsigned K = 0; K < Inst->getNumOperands(); ++K) {
+                            auto Op = Inst->getOperand(K);
+                            if (Op->getType()->isPointerTy()) Operands.push_back(Op);
+                        }
+                        AddStep(Inst, Inst, Operands);
+                    }
+                    break;
+                case Instruction::Call: {
+                    auto *CI = (CallInst *) Inst;
+                    if (auto *Callee = CI->getCalledFunction()) {
+                        if (Callee->isIntrinsic() && Callee->getIntrinsicID() >= Intrinsic::memcpy
+                            && Callee->getIntrinsicID() <= Intrinsic::memset_element_unordered_atomic) {
+                            for (unsigned K = 0; K < CI->arg_size(); ++K) {
+                                auto Op = CI->getArgOperand(K);
+                                if (!Op->getType()->isPointerTy()) continue;
+                                AddStep(Inst, Op, {});
+                            }
+                        } else if (API::isMemoryAllocate(CI)) AddStep(Inst, Inst, {});
+                    } else {
+                        AddStep(Inst, CI->getCalledOperand(), {});
                     }
                 }
+                    break;
+                default:
+                    break;
             }
-        } else {
-            IncomingEdges.emplace_back(I.getPrevNode(), 0);
         }
-        BitVector *NonNulls;
-        if (IncomingEdges.empty()) {
-            NonNulls = &DataflowFacts.at({nullptr, 0});
-        } else if (IncomingEdges.size() == 1) {
-            NonNulls = &DataflowFacts.at(IncomingEdges[0]);
-        } else {
-            merge(IncomingEdges, ResultOfMerging);
-            NonNulls = &ResultOfMerging;
-        }
-        auto &Orig = InstNonNullMap[&I];
-        for (auto K = 0; K < I.getNumOperands(); ++K) {
-            auto OpK = I.getOperand(K);
-            auto It = PtrIDMap.find(NEA.get(OpK));
-            if (It == PtrIDMap.end()) continue;
-            auto OpKMustNonNull = NonNulls->test(It->second);
-            if (OpKMustNonNull) {
-                Orig = Orig | (1 << K);
-                if (isa<ReturnInst>(&I)) {
-                    NFA->add(F, OpK);
-                } else if (auto *CI = dyn_cast<CallInst>(&I)) {
-                    if (K < CI->getNumArgOperands()) NFA->add(F, CI, K);
-                } else {
-                    // ... omit others
-                }
+        Summary.StepEnd = Steps.size();
+
+        // the terminator, a conditional branch comparing a ptr with null checks the ptr along one edge
+        auto *Term = B->getTerminator();
+        unsigned CheckedID = UINT_MAX, CheckedBrNo = UINT_MAX;
+        if (auto *BrInst = dyn_cast<BranchInst>(Term)) {
+            auto CmpInst = BrInst->isConditional() ? dyn_cast<ICmpInst>(BrInst->getCondition()) : nullptr;
+            if (CmpInst) {
+                auto Op0 = CmpInst->getOperand(0);
+                auto Op1 = CmpInst->getOperand(1);
+                if (CmpInst->getPredicate() == CmpInst::ICMP_EQ) CheckedBrNo = 1;
+                else if (CmpInst->getPredicate() == CmpInst::ICMP_NE) CheckedBrNo = 0;
+                if (isa<ConstantPointerNull>(Op0)) CheckedID = getPtrID(Op1);
+                else if (isa<ConstantPointerNull>(Op1)) CheckedID = getPtrID(Op0);
             }
         }
+        for (unsigned K = 0; K < Term->getNumSuccessors(); ++K) {
+            unsigned SuccID = BlockIDMap.lookup(Term->getSuccessor(K));
+            Summary.Successors.push_back(SuccID);
+            Summary.SuccessorGen.push_back(K == CheckedBrNo ? CheckedID : UINT_MAX);
+            Blocks[SuccID].Incoming.emplace_back(BID, K);
+        }
+        Summary.ExitFacts.resize(Term->getNumSuccessors());
+        Summary.ExitUnreachable.resize(Term->getNumSuccessors());
     }
 }
 
-void LocalNullCheckAnalysis::merge(std::vector<Edge> &IncomingEdges, BitVector &Result) {
-    auto It = IncomingEdges.begin();
-    Result = DataflowFacts.at(*It++);
-    while (It != IncomingEdges.end()) {
-        auto &NextSet = DataflowFacts.at(*It);
-        Result &= NextSet;
-        It++;
+bool LocalNullCheckAnalysis::init() {
+    bool First = Blocks.empty();
+    if (First) {
+        summarize();
+        Seeds.resize(PtrIDMap.size());
     }
-}
+    bool Changed = First;
 
-void LocalNullCheckAnalysis::transfer(Edge E, const BitVector &In, BitVector &Out) {
-    // assume In, evaluate E's fact as Out
-    Out = In;
-
-    auto Set = [this, &Out](Value *Ptr) {
-        size_t PtrID = UINT64_MAX;
-        Ptr = NEA.get(Ptr);
-        auto It = PtrIDMap.find(Ptr);
-        if (It != PtrIDMap.end())
-            PtrID = It->second;
-        if (PtrID < Out.size()) Out.set(PtrID);
-    };
+    // the ptr groups proved non-null by nfa since the last run
+    for (auto &It: Ptrs) {
+        if (Seeds.test(It.second) || !NFA->notNull(It.first)) continue;
+        Seeds.set(It.second);
+        Changed = true;
+    }
 
-    auto Count = [this, &In](Value *Ptr) -> bool {
-        size_t PtrID = UINT64_MAX;
-        Ptr = NEA.get(Ptr);
-        auto It = PtrIDMap.find(Ptr);
-        if (It != PtrIDMap.end())
-            PtrID = It->second;
-        if (PtrID < In.size())
-            return In.test(PtrID);
-        else
-            return true;
-    };
+    // the edges labeled unreachable since the last run
+    NewUnreachableSuccessors.clear();
+    for (auto &Summary: Blocks) {
+        auto *Term = Summary.Block->getTerminator();
+        for (unsigned K = 0; K < Summary.ExitFacts.size(); ++K) {
+            if (First && !SparseNCA) Summary.ExitFacts[K] = BitVector(PtrIDMap.size());
+            bool Unreachable = UnreachableEdges.count({Term, K});
+            if (Unreachable == Summary.ExitUnreachable[K]) continue;
+            Summary.ExitUnreachable[K] = Unreachable;
+            NewUnreachableSuccessors.push_back(Summary.Successors[K]);
+            Changed = true;
+        }
+        // the non-terminator instructions of a block are labeled unreachable together
+        auto *Front = &Summary.Block->front();
+        bool BodyUnreachable = Front != Term && UnreachableEdges.count({Front, 0});
+        Changed |= BodyUnreachable != Summary.BodyUnreachable;
+        Summary.BodyUnreachable = BodyUnreachable;
+    }
+    for (auto &Summary: Blocks) {
+        Summary.Unreachable = Summary.BodyUnreachable || !Summary.Incoming.empty();
+        for (auto &In: Summary.Incoming) Summary.Unreachable &= Blocks[In.first].ExitUnreachable[In.second];
+    }
+    return Changed;
+}
 
-    // analyze each instruction type
-    auto *Inst = E.first;
-    auto BrNo = E.second;
-    switch (Inst->getOpcode()) {
-        case Instruction::Load:
-        case Instruction::Store:
-        case Instruction::GetElementPtr:
-            Set(getPointerOperand(Inst));
-            break;
-        case Instruction::Alloca:
-            Set(Inst);
-            break;
-        case Instruction::AddrSpaceCast:
-        case Instruction::BitCast:
-            if (Count(Inst->getOperand(0))) Set(Inst);
-            break;
-        case Instruction::PHI:
-        case Instruction::Select:
-            if (Inst->getType()->isPointerTy()) {
-                bool AllNonNull = true;
-                for (unsigned K = 0; K < Inst->getNumOperands(); ++K) {
-                    auto Op = Inst->getOperand(K);
-                    if (!Op->getType()->isPointerTy()) continue;
-                    if (!Count(Op)) {
-                        AllNonNull = false;
-                        break;
+void LocalNullCheckAnalysis::tag() {
+    BitVector Fact;
+    for (unsigned BID = 0; BID < Blocks.size(); ++BID) {
+        auto &Summary = Blocks[BID];
+        merge(BID, Fact);
+        if (Summary.Unreachable) Fact.set();
+        unsigned S = Summary.StepBegin;
+        for (auto &I: *Summary.Block) {
+            // Fact is the fact before I
+            unsigned Offset = InstOperandOffsets.lookup(&I);
+            for (unsigned K = 0; K < I.getNumOperands(); ++K) {
+                auto OpK = I.getOperand(K);
+                unsigned OpKID = getPtrID(OpK);
+                if (OpKID == UINT_MAX) continue;
+                auto OpKMustNonNull = Fact.test(OpKID);
+                if (OpKMustNonNull) {
+                    NonNullOperands.set(Offset + K);
+                    if (isa<ReturnInst>(&I)) {
+                        NFA->add(F, OpK);
+                    } else if (auto *CI = dyn_cast<CallInst>(&I)) {
+                        if (K < CI->arg_size()) NFA->add(F, CI, K);
+                    } else {
+                        // ... omit others
                     }
                 }
-                if (AllNonNull) Set(Inst);
-            }
-            break;
-        case Instruction::Call: {
-            auto *CI = (CallInst *) Inst;
-            if (auto *Callee = CI->getCalledFunction()) {
-                if (Callee->isIntrinsic() && Callee->getIntrinsicID() >= Intrinsic::memcpy
-                    && Callee->getIntrinsicID() <= Intrinsic::memset_element_unordered_atomic) {
-                    for (unsigned K = 0; K < CI->getNumArgOperands(); ++K) {
-                        auto Op = CI->getArgOperand(K);
-                        if (!Op->getType()->isPointerTy()) continue;
-                        Set(Op);
-                    }
-                } else if (API::isMemoryAllocate(CI)) Set(Inst);
-            } else {
-                Set(CI->getCalledOperand());
             }
+
+            unsigned E = S;
+            while (E < Summary.StepEnd && Steps[E].Inst == &I) ++E;
+            transfer(S, E, Fact);
+            S = E;
         }
-            break;
-        case Instruction::Br: {
-            auto *BrInst = (BranchInst *) Inst;
-            if (!BrInst->isConditional()) break;
-            auto CmpInst = dyn_cast<ICmpInst>(BrInst->getCondition());
-            if (!CmpInst) break;
-
-            auto Op0 = CmpInst->getOperand(0);
-            auto Op1 = CmpInst->getOperand(1);
-            if (CmpInst->getPredicate() == CmpInst::ICMP_EQ && BrNo == 1
-                || CmpInst->getPredicate() == CmpInst::ICMP_NE && BrNo == 0) {
-                if (isa<ConstantPointerNull>(Op0)) Set(Op1);
-                else if (isa<ConstantPointerNull>(Op1)) Set(Op0);
+    }
+}
+
+void LocalNullCheckAnalysis::merge(unsigned BID, BitVector &Result) {
+    auto &Incoming = Blocks[BID].Incoming;
+    if (Incoming.empty()) {
+        Result = Seeds;
+        return;
+    }
+    // an unreachable edge is never taken, so it does not weaken the fact, and a block without reachable incoming
+    // edges is unreachable, where all ptrs are non-null
+    bool AnyReachable = false;
+    for (auto &In: Incoming) {
+        auto &Pred = Blocks[In.first];
+        if (Pred.ExitUnreachable[In.second]) continue;
+        if (AnyReachable) Result &= Pred.ExitFacts[In.second];
+        else Result = Pred.ExitFacts[In.second];
+        AnyReachable = true;
+    }
+    if (AnyReachable) Result |= Seeds;
+    else Result = BitVector(Seeds.size(), true);
+}
+
+void LocalNullCheckAnalysis::transfer(unsigned Begin, unsigned End, BitVector &Fact) {
+    for (unsigned S = Begin; S < End; ++S) {
+        auto &Step = Steps[S];
+        bool AllNonNull = true;
+        for (unsigned K = Step.OperandBegin; K < Step.OperandEnd; ++K) {
+            if (!Fact.test(StepOperands[K])) {
+                AllNonNull = false;
+                break;
             }
         }
-            break;
-        default:
-            break;
+        if (AllNonNull) Fact.set(Step.TargetID);
     }
 }
 
 void LocalNullCheckAnalysis::nca() {
-    std::vector<Edge> WorkList;
-    for (auto &I: instructions(*F)) {
-        if (I.isTerminator()) {
-            for (unsigned K = 0; K < I.getNumSuccessors(); ++K) WorkList.emplace_back(&I, K);
-        } else {
-            WorkList.emplace_back(&I, 0);
+    // the facts only grow, so the fixed point does not depend on the order, visiting blocks in
+    // reverse post-order makes most blocks see their final inputs at the first visit
+    std::priority_queue<unsigned, std::vector<unsigned>, std::greater<>> WorkList;
+    BitVector InWorkList(Blocks.size(), true);
+    for (unsigned BID = 0; BID < Blocks.size(); ++BID) WorkList.push(BID);
+
+    BitVector Fact;
+    BitVector ExitFact;
+    while (!WorkList.empty()) {
+        auto BID = WorkList.top();
+        WorkList.pop();
+        InWorkList.reset(BID);
+        auto &Summary = Blocks[BID];
+
+        // 1. merge
+        merge(BID, Fact);
+
+        // 2. transfer
+        if (Summary.Unreachable) Fact.set();
+        else transfer(Summary.StepBegin, Summary.StepEnd, Fact);
+
+        // 3. add necessary ones to worklist
+        for (unsigned K = 0; K < Summary.Successors.size(); ++K) {
+            if (Summary.ExitUnreachable[K]) continue;
+            // a fact of the last fixed point still holds when more ptrs are non-null or more edges are unreachable,
+            // so keeping it lets facts only grow when resuming from the last fixed point
+            ExitFact = Fact;
+            ExitFact |= Summary.ExitFacts[K];
+            if (Summary.SuccessorGen[K] != UINT_MAX) ExitFact.set(Summary.SuccessorGen[K]);
+            if (ExitFact == Summary.ExitFacts[K]) continue;
+            Summary.ExitFacts[K].swap(ExitFact);
+            auto SuccID = Summary.Successors[K];
+            if (InWorkList.test(SuccID)) continue;
+            InWorkList.set(SuccID);
+            WorkList.push(SuccID);
         }
     }
-    std::reverse(WorkList.begin(), WorkList.end());
+}
 
-    std::vector<Edge> IncomingEdges;
-    BitVector ResultOfMerging;
-    BitVector ResultOfTransfer;
-    while (!WorkList.empty()) {
-        auto Edge = WorkList.back();
-        WorkList.pop_back();
-        if (UnreachableEdges.count(Edge)) continue;
+void LocalNullCheckAnalysis::summarizeSparse() {
+    StepUsers.resize(PtrIDMap.size());
+    for (unsigned S = 0; S < Steps.size(); ++S)
+        for (unsigned K = Steps[S].OperandBegin; K < Steps[S].OperandEnd; ++K)
+            if (StepUsers[StepOperands[K]].empty() || StepUsers[StepOperands[K]].back() != S)
+                StepUsers[StepOperands[K]].push_back(S);
+
+    // the dominance frontiers, i.e., the joins where a fact from a dominating block may stop holding
+    Frontiers.resize(Blocks.size());
+    for (unsigned BID = 0; BID < Blocks.size(); ++BID) {
+        auto &Incoming = Blocks[BID].Incoming;
+        auto *Node = DT.getNode(Blocks[BID].Block);
+        if (Incoming.size() < 2 || !Node) continue;
+        for (auto &In: Incoming) {
+            auto *Runner = DT.getNode(Blocks[In.first].Block);
+            while (Runner && Runner != Node->getIDom()) {
+                auto &Frontier = Frontiers[BlockIDMap.lookup(Runner->getBlock())];
+                if (Frontier.empty() || Frontier.back() != BID) Frontier.push_back(BID);
+                Runner = Runner->getIDom();
+            }
+        }
+    }
+}
 
-        auto EdgeInst = Edge.first;
-        auto &EdgeFact = DataflowFacts.at(Edge); // this loop iteration re-compute EdgeFact
+bool LocalNullCheckAnalysis::nonNullBefore(unsigned ID, Instruction *Inst) {
+    if (ID >= NonNullPoints.size()) return false;
+    return nonNullAt(ID, Inst->getParent(), Inst->getPrevNode());
+}
 
-        // 1. merge
-        IncomingEdges.clear();
-        if (EdgeInst == &(EdgeInst->getParent()->front())) {
-            auto *B = EdgeInst->getParent();
-            for (auto PIt = pred_begin(B), PE = pred_end(B); PIt != PE; ++PIt) {
-                auto Term = (*PIt)->getTerminator();
-                for (unsigned K = 0; K < Term->getNumSuccessors(); ++K) {
-                    if (Term->getSuccessor(K) == B) {
-                        IncomingEdges.emplace_back(Term, K);
-                    }
-                }
-            }
-        } else {
-            IncomingEdges.emplace_back(EdgeInst->getPrevNode(), 0);
+bool LocalNullCheckAnalysis::nonNullAt(unsigned ID, BasicBlock *B, Instruction *After) {
+    auto &Points = NonNullPoints[ID];
+    auto It = Points.find(B);
+    if (It != Points.end()) {
+        auto *Point = It->second;
+        if (!Point || (After && (Point == After || Point->comesBefore(After)))) return true;
+    }
+    // a point in another block holds in B if its block dominates B, i.e., is on the idom chain of B,
+    // and a block not reachable from the entry is dominated by any block
+    auto *Node = DT.getNode(B);
+    if (!Node) return Points.size() > (It != Points.end() ? 1 : 0);
+    // all ptrs are non-null in a block dominated by an unreachable block
+    for (; Node; Node = Node->getIDom()) {
+        auto *D = Node->getBlock();
+        if (Blocks[BlockIDMap.lookup(D)].Unreachable || (D != B && Points.count(D))) return true;
+    }
+    return false;
+}
+
+void LocalNullCheckAnalysis::ncaSparse() {
+    // the points only grow, so a run resumes from the points of the last run
+    bool First = Frontiers.empty();
+    if (First) {
+        summarizeSparse();
+        NonNullPoints.resize(PtrIDMap.size());
+    }
+
+    // a fact (ID, BID) means the ptr ID gets non-null somewhere in the block BID, which may
+    // make the steps using the ptr and the joins in the dominance frontier of the block non-null
+    std::vector<std::pair<unsigned, unsigned>> WorkList;
+    // a point dominated by another point of the same ptr is redundant
+    auto AddPoint = [this, &WorkList](unsigned ID, unsigned BID, Instruction *After) {
+        auto *B = Blocks[BID].Block;
+        if (nonNullAt(ID, B, After)) return;
+        NonNullPoints[ID][B] = After;
+        WorkList.emplace_back(ID, BID);
+    };
+    auto Evaluate = [this, &AddPoint](unsigned S) {
+        auto &Step = Steps[S];
+        auto *B = Step.Inst->getParent();
+        if (nonNullAt(Step.TargetID, B, Step.Inst)) return;
+        for (unsigned K = Step.OperandBegin; K < Step.OperandEnd; ++K)
+            if (!nonNullBefore(StepOperands[K], Step.Inst)) return;
+        AddPoint(Step.TargetID, BlockIDMap.lookup(B), Step.Inst);
+    };
+    auto EvaluateJoin = [this, &AddPoint](unsigned ID, unsigned JID) {
+        auto &Join = Blocks[JID];
+        if (nonNullBefore(ID, &Join.Block->front())) return;
+        for (auto &In: Join.Incoming) {
+            auto &Pred = Blocks[In.first];
+            if (Pred.ExitUnreachable[In.second] || Pred.SuccessorGen[In.second] == ID) continue;
+            if (!nonNullBefore(ID, Pred.Block->getTerminator())) return;
         }
-        BitVector *NonNulls;
-        if (IncomingEdges.empty()) {
-            NonNulls = &DataflowFacts.at({nullptr, 0});
-        } else if (IncomingEdges.size() == 1) {
-            NonNulls = &DataflowFacts.at(IncomingEdges[0]);
-        } else {
-            merge(IncomingEdges, ResultOfMerging);
-            NonNulls = &ResultOfMerging;
+        AddPoint(ID, JID, nullptr);
+    };
+
+    // a ptr proved non-null by nfa is non-null from the entry, which dominates all the blocks
+    for (auto ID: Seeds.set_bits()) AddPoint(ID, 0, nullptr);
+
+    // a join with a new unreachable incoming edge may be non-null for the ptrs non-null along the other edges,
+    // so may the joins an unreachable block flows to
+    for (auto JID: NewUnreachableSuccessors) {
+        for (unsigned ID = 0; ID < NonNullPoints.size(); ++ID) {
+            if (NonNullPoints[ID].empty()) continue;
+            EvaluateJoin(ID, JID);
+            if (Blocks[JID].Unreachable)
+                for (auto FID: Frontiers[JID]) EvaluateJoin(ID, FID);
         }
+    }
 
-        // 2. transfer
-        ResultOfTransfer.clear();
-        transfer(Edge, *NonNulls, ResultOfTransfer);
+    for (unsigned BID = 0; First && BID < Blocks.size(); ++BID) {
+        auto &Summary = Blocks[BID];
+        for (unsigned S = Summary.StepBegin; S < Summary.StepEnd; ++S)
+            if (Steps[S].OperandBegin == Steps[S].OperandEnd) Evaluate(S);
+        // a check makes the ptr non-null in the successor if the edge is the only way to the successor
+        for (unsigned K = 0; K < Summary.Successors.size(); ++K) {
+            if (Summary.SuccessorGen[K] == UINT_MAX || Summary.ExitUnreachable[K]) continue;
+            auto *Succ = Blocks[Summary.Successors[K]].Block;
+            if (DT.dominates(BasicBlockEdge(Summary.Block, Succ), Succ))
+                AddPoint(Summary.SuccessorGen[K], Summary.Successors[K], nullptr);
+            else EvaluateJoin(Summary.SuccessorGen[K], Summary.Successors[K]);
+        }
+    }
 
-        // 3. add necessary ones to worklist
-        if (ResultOfTransfer != EdgeFact) {
-            EdgeFact.swap(ResultOfTransfer);
-            auto NextInst = EdgeInst->isTerminator() ? &EdgeInst->getSuccessor(Edge.second)->front() :
-                            EdgeInst->getNextNode();
-            if (NextInst->isTerminator()) {
-                for (unsigned K = 0; K < NextInst->getNumSuccessors(); ++K) {
-                    if (UnreachableEdges.count({NextInst, K})) continue;
-                    WorkList.emplace_back(NextInst, K);
-                }
-            } else if (!UnreachableEdges.count({NextInst, 0})) {
-                WorkList.emplace_back(NextInst, 0);
+    while (!WorkList.empty()) {
+        auto ID = WorkList.back().first;
+        auto BID = WorkList.back().second;
+        WorkList.pop_back();
+
+        for (auto S: StepUsers[ID]) Evaluate(S);
+
+        for (auto JID: Frontiers[BID]) EvaluateJoin(ID, JID);
+    }
+}
+
+void LocalNullCheckAnalysis::tagSparse() {
+    // only the non-null operands of calls and returns are useful for nfa
+    for (auto &I: instructions(*F)) {
+        if (!isa<ReturnInst>(&I) && !isa<CallInst>(&I)) continue;
+        for (unsigned K = 0; K < I.getNumOperands(); ++K) {
+            auto OpK = I.getOperand(K);
+            unsigned OpKID = getPtrID(OpK);
+            if (OpKID == UINT_MAX || !nonNullBefore(OpKID, &I)) continue;
+            if (isa<ReturnInst>(&I)) {
+                NFA->add(F, OpK);
+            } else if (K < cast<CallInst>(&I)->arg_size()) {
+                NFA->add(F, cast<CallInst>(&I), K);
             }
         }
     }
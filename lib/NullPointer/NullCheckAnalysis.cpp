@@ -17,13 +17,18 @@
  */
 
 #include <llvm/IR/Module.h>
+#include <algorithm>
 #include "NullPointer/LocalNullCheckAnalysis.h"
 #include "NullPointer/NullCheckAnalysis.h"
 #include "NullPointer/NullFlowAnalysis.h"
 #include "Support/RecursiveTimer.h"
 #include "Support/ThreadPool.h"
 
-static cl::opt<unsigned> Round("nca-round", cl::init(2), cl::Hidden, cl::desc("# rounds"));
+static cl::opt<unsigned> Round("nca-round", cl::init(0), cl::Hidden,
+                               cl::desc("# rounds, 0 means running until a fixed point is reached"));
+
+static cl::opt<bool> DemandDriven("nca-demand", cl::init(false), cl::Hidden,
+                                  cl::desc("Analyze a function only when a pointer in it is queried."));
 
 char NullCheckAnalysis::ID = 0;
 static RegisterPass<NullCheckAnalysis> X("nca", "soundly checking if a pointer may be nullptr.");
@@ -43,18 +48,22 @@ bool NullCheckAnalysis::runOnModule(Module &M) {
     RecursiveTimer TR("Running NullCheckAnalysis");
 
     // get the null flow analysis
-    auto *NFA = &getAnalysis<NullFlowAnalysis>();
+    NFA = &getAnalysis<NullFlowAnalysis>();
+    if (DemandDriven) return false;
 
     // allocate space for each function for thread safety
     std::set<Function *> Funcs;
     for (auto &F: M) if (!F.empty()) { AnalysisMap[&F] = nullptr; Funcs.insert(&F); }
 
-    unsigned Count = 1;
+    // a round re-analyzes the functions with new non-null values, which resume from their last fixed points
+    unsigned Count = 0;
+    bool Changed;
     do {
-        RecursiveTimer Iteration("NCA Iteration " + std::to_string(Count));
+        RecursiveTimer Iteration("NCA Iteration " + std::to_string(++Count));
+        RecursiveTimer::print(std::to_string(Funcs.size()) + " functions analyzed");
         for (auto &F: M) {
             if (!Funcs.count(&F)) continue;
-            ThreadPool::get()->enqueue([this, NFA, &F]() {
+            ThreadPool::get()->enqueue([this, &F]() {
                 auto *&LNCA = AnalysisMap.at(&F);
                 if (!LNCA) LNCA = new LocalNullCheckAnalysis(NFA, &F);
                 LNCA->run();
@@ -62,14 +71,69 @@ bool NullCheckAnalysis::runOnModule(Module &M) {
         }
         ThreadPool::get()->wait(); // wait for all tasks to finish
         Funcs.clear();
-    } while (Count++ < Round.getValue() && NFA->recompute(Funcs));
+        Changed = (Round.getValue() == 0 || Count < Round.getValue()) && NFA->recompute(Funcs);
+        if (Changed) RecursiveTimer::print(std::to_string(Funcs.size()) + " functions have new non-null values");
+    } while (Changed);
 
     return false;
 }
 
 bool NullCheckAnalysis::mayNull(Value *Ptr, Instruction *Inst) {
+    if (DemandDriven) {
+        std::lock_guard<std::mutex> Lock(DemandMutex);
+        return getOrAnalyze(Inst->getFunction())->mayNull(Ptr, Inst);
+    }
     auto It = AnalysisMap.find(Inst->getFunction());
     if (It != AnalysisMap.end())
         return It->second->mayNull(Ptr, Inst);
     else return true;
 }
+
+LocalNullCheckAnalysis *NullCheckAnalysis::getOrAnalyze(Function *F) {
+    auto It = AnalysisMap.find(F);
+    if (It != AnalysisMap.end() && Queried.count(F)) return It->second;
+
+    // an analyzed function resumes from its last fixed point
+    auto Run = [this](Function *G) {
+        auto *&LNCA = AnalysisMap[G];
+        if (!LNCA) LNCA = new LocalNullCheckAnalysis(NFA, G);
+        LNCA->run();
+        Dirty.erase(G);
+    };
+    // the analyzed functions with new non-null values are resumed when they are needed again,
+    // and the fixed points of the queried functions may depend on them
+    auto Recompute = [this]() {
+        std::set<Function *> Funcs;
+        bool Changed = NFA->recompute(Funcs);
+        for (auto *G: Funcs) {
+            if (!AnalysisMap.count(G)) continue;
+            Dirty.insert(G);
+            Queried.clear();
+        }
+        return Changed;
+    };
+
+    // the checks in the functions whose values flow into F, directly or not, may make the pointers of F non-null,
+    // so all of them are analyzed, the farthest ones first, and their results are kept for later queries
+    std::vector<Function *> Closure(1, F);
+    std::set<Function *> Visited{F};
+    for (unsigned K = 0; K < Closure.size(); ++K) {
+        auto SIt = SourceMap.find(Closure[K]);
+        if (SIt == SourceMap.end()) {
+            SIt = SourceMap.emplace(Closure[K], std::set<Function *>()).first;
+            NFA->getSourceFunctions(Closure[K], SIt->second);
+        }
+        for (auto *SrcF: SIt->second)
+            if (!SrcF->empty() && Visited.insert(SrcF).second) Closure.push_back(SrcF);
+    }
+
+    // rounds as in the whole-module mode, restricted to the closure, until none of it has new non-null values
+    for (unsigned Count = 1;; ++Count) {
+        for (auto CIt = Closure.rbegin(); CIt != Closure.rend(); ++CIt)
+            if (!AnalysisMap.count(*CIt) || Dirty.count(*CIt)) Run(*CIt);
+        if ((Round.getValue() != 0 && Count >= Round.getValue()) || !Recompute()) break;
+        if (std::none_of(Closure.begin(), Closure.end(), [this](Function *G) { return Dirty.count(G); })) break;
+    }
+    Queried.insert(F);
+    return AnalysisMap.at(F);
+}
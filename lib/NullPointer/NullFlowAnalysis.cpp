@@ -23,8 +23,9 @@
 #include "Support/API.h"
 #include "Support/RecursiveTimer.h"
 
-static cl::opt<int> IncrementalLimits("nfa-limit", cl::init(10), cl::Hidden,
-                                      cl::desc("Determine how many non-null edges we consider a round."));
+static cl::opt<int> IncrementalLimits("nfa-limit", cl::init(-1), cl::Hidden,
+                                      cl::desc("Determine how many non-null edges we consider a round, "
+                                               "-1 means no limit."));
 
 char NullFlowAnalysis::ID = 0;
 static RegisterPass<NullFlowAnalysis> X("nfa", "null value flow");
@@ -54,103 +55,137 @@ bool NullFlowAnalysis::runOnModule(Module &M) {
             return API::isMemoryAllocate(CI);
         return !DAA->mayNull(V);
     };
-    std::set<DyckVFGNode *> MayNullNodes;
+    BitVector MayNullNodes(VFG->numNodes());
+    std::vector<unsigned> DFSStack;
+    auto AddMayNull = [this, &MayNullNodes, &DFSStack](Value *V) {
+        unsigned ID = VFG->getNodeID(V);
+        if (ID == UINT_MAX || MayNullNodes.test(ID)) return;
+        MayNullNodes.set(ID);
+        DFSStack.push_back(ID);
+    };
     for (auto &F: M) {
         if (!F.empty()) NewNonNullEdges[&F];
         for (auto &I: instructions(&F)) {
-            if (I.getType()->isPointerTy() && !MustNotNull(&I)) {
-                if (auto INode = VFG->getVFGNode(&I)) {
-                    MayNullNodes.insert(INode);
-                }
-            }
+            if (I.getType()->isPointerTy() && !MustNotNull(&I)) AddMayNull(&I);
             for (unsigned K = 0; K < I.getNumOperands(); ++K) {
                 auto *Op = I.getOperand(K);
-                if (Op->getType()->isPointerTy() && !MustNotNull(Op)) {
-                    if (auto OpNode = VFG->getVFGNode(Op)) {
-                        MayNullNodes.insert(OpNode);
-                    }
-                }
+                if (Op->getType()->isPointerTy() && !MustNotNull(Op)) AddMayNull(Op);
             }
         }
     }
 
     // dfs to get all may-null nodes (currently context-insensitive)
-    std::vector<DyckVFGNode *> DFSStack(MayNullNodes.size());
-    unsigned K = 0;
-    for (auto *N: MayNullNodes) DFSStack[K++] = N;
-    MayNullNodes.clear();
-    std::set<DyckVFGNode *> &Visited = MayNullNodes;
     while (!DFSStack.empty()) {
-        auto *Top = DFSStack.back();
+        auto Top = DFSStack.back();
         DFSStack.pop_back();
-        if (Visited.count(Top)) continue;
-        Visited.insert(Top);
-        for (auto &T: *Top) if (!Visited.count(T.first)) DFSStack.push_back(T.first);
+        for (auto T: VFG->targets(Top)) {
+            if (MayNullNodes.test(T.first)) continue;
+            MayNullNodes.set(T.first);
+            DFSStack.push_back(T.first);
+        }
     }
 
-    // get initial non null nodes
-    set_intersection(Visited.begin(), Visited.end(), VFG->node_begin(), VFG->node_end(),
-                     inserter(NonNullNodes, NonNullNodes.begin()));
+    // get initial non null nodes, i.e., the nodes no may-null values flow to
+    NonNullNodes = MayNullNodes;
+    NonNullNodes.flip();
+
+    // count the distinct may-null sources of each node, the edges of a pair of nodes differ only in labels,
+    // and a node flowing to itself cannot make itself null
+    NumMayNullSources.assign(VFG->numNodes(), 0);
+    for (unsigned N = 0; N < VFG->numNodes(); ++N) {
+        unsigned Last = UINT_MAX;
+        for (auto In: VFG->sources(N)) {
+            if (In.first == Last || In.first == N) continue;
+            Last = In.first;
+            if (!NonNullNodes.test(In.first)) ++NumMayNullSources[N];
+        }
+    }
     return false;
 }
 
 bool NullFlowAnalysis::recompute(std::set<Function *> &NewNonNullFunctions) {
-    std::set<DyckVFGNode *> PossibleNonNullNodes;
+    // a node whose may-null sources are all gone becomes non-null, and then it is no longer a may-null source
+    std::vector<unsigned> WorkList;
+    auto Discharge = [this, &WorkList](unsigned Tgt) {
+        assert(NumMayNullSources[Tgt] > 0);
+        if (--NumMayNullSources[Tgt] || NonNullNodes.test(Tgt)) return;
+        NonNullNodes.set(Tgt);
+        WorkList.push_back(Tgt);
+    };
+
+    // the targets of a non-null node are discharged before any new edge is considered, so that a new edge
+    // from a non-null node never discharges its target twice, nor does it stop the node from discharging it
+    auto Propagate = [this, &WorkList, &Discharge, &NewNonNullFunctions]() {
+        while (!WorkList.empty()) {
+            auto N = WorkList.back();
+            WorkList.pop_back();
+            if (auto *NF = VFG->getNode(N)->getFunction()) NewNonNullFunctions.insert(NF);
+            unsigned Last = UINT_MAX;
+            for (auto T: VFG->targets(N)) {
+                if (T.first == Last || T.first == N) continue;
+                Last = T.first;
+                // a non-null edge has discharged the target already
+                if (!NonNullEdges.count(std::make_pair(N, T.first))) Discharge(T.first);
+            }
+        }
+    };
+
+    unsigned OrigNonNullSize = NonNullNodes.count();
     unsigned K = 0, Limits = IncrementalLimits < 0 ? UINT32_MAX : IncrementalLimits;
     for (auto &NIt: NewNonNullEdges) {
         auto EIt = NIt.second.begin();
         while (EIt != NIt.second.end()) {
             if (++K > Limits) break;
-            auto *Src = EIt->first;
-            auto *Tgt = EIt->second;
-            assert(Src && Tgt);
-            if (!NonNullNodes.count(Tgt)) PossibleNonNullNodes.insert(Tgt);
-            NonNullEdges.emplace(Src, Tgt);
-            EIt = NIt.second.erase(EIt);
-        }
-    }
-    if (PossibleNonNullNodes.empty()) return false;
-
-    unsigned OrigNonNullSize = NonNullNodes.size();
-    std::vector<DyckVFGNode *> WorkList(PossibleNonNullNodes.size());
-    K = 0;
-    for (auto *N: PossibleNonNullNodes) WorkList[K++] = N;
-    while (!WorkList.empty()) {
-        auto *N = WorkList.back();
-        WorkList.pop_back();
-        if (!NonNullNodes.count(N)) {
-            // check if all incoming edges of N are nonnull edges
-            // if yes, N is nonnull, add N to NonNullNodes, add N's (non-null) targets to WorkList
-            // if no, continue
-            bool AllInNonNull = true;
-            for (auto IIt = N->in_begin(), IE = N->in_end(); IIt != IE; ++IIt) {
-                auto *In = IIt->first;
-                if (!NonNullNodes.count(N) && !NonNullEdges.count(std::make_pair(In, N))) {
-                    AllInNonNull = false;
-                    break;
-                }
+            auto Src = EIt->first;
+            auto Tgt = EIt->second;
+            if (Src != Tgt && VFG->hasEdge(Src, Tgt) && NonNullEdges.insert(*EIt).second && !NonNullNodes.test(Src)) {
+                Discharge(Tgt);
+                Propagate();
             }
-            if (!AllInNonNull) continue;
-            NonNullNodes.insert(N);
-            if (auto *NF = N->getFunction()) NewNonNullFunctions.insert(NF);
+            EIt = NIt.second.erase(EIt);
         }
-        for (auto &T: *N) WorkList.push_back(T.first);
     }
-    return OrigNonNullSize != NonNullNodes.size();
+    return OrigNonNullSize != NonNullNodes.count();
 }
 
 bool NullFlowAnalysis::notNull(Value *V) const {
     assert(V);
-    auto *N = VFG->getVFGNode(V);
-    if (!N) return true;
-    return NonNullNodes.count(N);
+    unsigned ID = VFG->getNodeID(V);
+    if (ID == UINT_MAX) return true;
+    return NonNullNodes.test(ID);
+}
+
+void NullFlowAnalysis::getSourceFunctions(Function *F, std::set<Function *> &Sources) const {
+    std::vector<unsigned> Hubs;
+    auto AddSources = [this, F, &Sources, &Hubs](unsigned ID) {
+        for (auto In: VFG->sources(ID)) {
+            auto *Src = VFG->getNode(In.first);
+            if (!Src->getValue()) Hubs.push_back(In.first);
+            else if (auto *SrcF = Src->getFunction())
+                if (SrcF != F) Sources.insert(SrcF);
+        }
+    };
+    auto AddValue = [this, &AddSources](Value *V) {
+        if (!V->getType()->isPointerTy()) return;
+        unsigned ID = VFG->getNodeID(V);
+        if (ID != UINT_MAX) AddSources(ID);
+    };
+    for (auto &Arg: F->args()) AddValue(&Arg);
+    for (auto &I: instructions(F)) AddValue(&I);
+
+    // a hub is owned by no function, so look through it, hubs are never connected to each other
+    std::sort(Hubs.begin(), Hubs.end());
+    Hubs.erase(std::unique(Hubs.begin(), Hubs.end()), Hubs.end());
+    auto HubIDs = std::move(Hubs);
+    Hubs.clear();
+    for (auto Hub: HubIDs) AddSources(Hub);
 }
 
 void NullFlowAnalysis::add(Function *F, Value *V1, Value *V2) {
-    auto *V1N = VFG->getVFGNode(V1);
-    if(!V1N) return;
-    auto *V2N = VFG->getVFGNode(V2);
-    if (!V2N) return;
+    unsigned V1N = VFG->getNodeID(V1);
+    if (V1N == UINT_MAX) return;
+    unsigned V2N = VFG->getNodeID(V2);
+    if (V2N == UINT_MAX) return;
     NewNonNullEdges.at(F).emplace(V1N, V2N);
 }
 
@@ -177,9 +212,9 @@ void NullFlowAnalysis::add(Function *F, CallInst *CI, unsigned int K) {
 
 void NullFlowAnalysis::add(Function *F, Value *Ret) {
     if (!Ret) return;
-    auto *RetN = VFG->getVFGNode(Ret);
-    if (!RetN) return;
+    unsigned RetN = VFG->getNodeID(Ret);
+    if (RetN == UINT_MAX) return;
     auto &Set = NewNonNullEdges.at(F);
-    for (auto &TargetIt: *RetN)
+    for (auto TargetIt: VFG->targets(RetN))
         Set.emplace(RetN, TargetIt.first);
 }
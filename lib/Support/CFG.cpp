@@ -18,35 +18,187 @@
 
 #include "Support/CFG.h"
 #include <llvm/IR/CFG.h>
+#include <llvm/Support/CommandLine.h>
+#include <algorithm>
+#include <climits>
 
-CFG::CFG(Function *F) : AnalyzedVec(F->size(), false) {
-  ReachableVecPtr = new ReachableVec[F->size()];
-  int Idx = 0;
+static cl::opt<unsigned> ReachCacheLimit(
+    "cfg-reach-cache-limit", cl::init(4096), cl::Hidden,
+    cl::desc("The memory (KB) of the cached reachable blocks of a function"));
+
+CFG::CFG(Function *F) {
   for (auto &B : *F) {
-    ID2BB.push_back(&B);
-    BB2ID[&B] = Idx;
-    ReachableVecPtr[Idx].resize(F->size(), false);
-    ++Idx;
+    unsigned Ordinal = 0;
+    for (auto &I : B)
+      Ordinals[&I] = Ordinal++;
+  }
+
+  // tarjan's algorithm without recursion, which numbers a component after
+  // all its successors
+  DenseMap<BasicBlock *, std::pair<unsigned, unsigned>> DFNLow;
+  std::vector<BasicBlock *> SCCStack;
+  std::vector<std::pair<BasicBlock *, succ_iterator>> CallStack;
+  unsigned Counter = 0, NumComponents = 0;
+  auto Visit = [&](BasicBlock *BB) {
+    DFNLow[BB] = std::make_pair(Counter, Counter);
+    ++Counter;
+    SCCStack.push_back(BB);
+    CallStack.emplace_back(BB, succ_begin(BB));
+  };
+  for (auto &Root : *F) {
+    if (DFNLow.count(&Root))
+      continue;
+    Visit(&Root);
+    while (!CallStack.empty()) {
+      auto *BB = CallStack.back().first;
+      auto &SuccIt = CallStack.back().second;
+      if (SuccIt != succ_end(BB)) {
+        auto *Succ = *SuccIt++;
+        auto It = DFNLow.find(Succ);
+        if (It == DFNLow.end())
+          Visit(Succ);
+        else if (!BlockComponents.count(Succ))
+          DFNLow[BB].second = std::min(DFNLow[BB].second, It->second.first);
+        continue;
+      }
+      CallStack.pop_back();
+      auto BBDFNLow = DFNLow[BB];
+      if (!CallStack.empty()) {
+        auto &ParentLow = DFNLow[CallStack.back().first].second;
+        ParentLow = std::min(ParentLow, BBDFNLow.second);
+      }
+      if (BBDFNLow.first != BBDFNLow.second)
+        continue;
+      BasicBlock *Member;
+      do {
+        Member = SCCStack.back();
+        SCCStack.pop_back();
+        BlockComponents[Member] = NumComponents;
+      } while (Member != BB);
+      ++NumComponents;
+    }
   }
+
+  // the condensed graph
+  std::vector<std::vector<BasicBlock *>> Members(NumComponents);
+  for (auto &B : *F)
+    Members[BlockComponents[&B]].push_back(&B);
+  for (unsigned C = 0; C < NumComponents; ++C) {
+    SuccBegin.push_back(Succs.size());
+    for (auto *BB : Members[C]) {
+      for (auto *Succ : successors(BB)) {
+        unsigned SuccC = BlockComponents[Succ];
+        if (SuccC != C)
+          Succs.push_back(SuccC);
+      }
+    }
+    std::sort(Succs.begin() + SuccBegin.back(), Succs.end());
+    Succs.erase(std::unique(Succs.begin() + SuccBegin.back(), Succs.end()),
+                Succs.end());
+  }
+  SuccBegin.push_back(Succs.size());
+
+  // the interval labels, the traversals visit the successors in different
+  // orders so that their labels exclude different components
+  for (unsigned T = 0; T < NumTraversals; ++T) {
+    auto &TLabels = Labels[T];
+    TLabels.assign(NumComponents, std::make_pair(UINT_MAX, UINT_MAX));
+    unsigned Rank = 0;
+    std::vector<std::pair<unsigned, unsigned>> Stack; // (component, successors visited)
+    for (unsigned K = 0; K < NumComponents; ++K) {
+      unsigned Root = T == 0 ? NumComponents - 1 - K : K;
+      if (TLabels[Root].first != UINT_MAX)
+        continue;
+      TLabels[Root].first = 0; // on the stack
+      Stack.emplace_back(Root, 0);
+      while (!Stack.empty()) {
+        unsigned C = Stack.back().first;
+        unsigned NumSuccs = SuccBegin[C + 1] - SuccBegin[C];
+        if (Stack.back().second < NumSuccs) {
+          unsigned Next = Stack.back().second++;
+          unsigned Succ =
+              Succs[T == 0 ? SuccBegin[C] + Next : SuccBegin[C + 1] - 1 - Next];
+          if (TLabels[Succ].first == UINT_MAX) {
+            TLabels[Succ].first = 0;
+            Stack.emplace_back(Succ, 0);
+          }
+          continue;
+        }
+        Stack.pop_back();
+        unsigned Low = ++Rank;
+        for (unsigned K = SuccBegin[C]; K < SuccBegin[C + 1]; ++K)
+          Low = std::min(Low, TLabels[Succs[K]].first);
+        TLabels[C] = std::make_pair(Low, Rank);
+      }
+    }
+  }
+
+  size_t Bytes = (NumComponents + 7) / 8 + sizeof(BitVector);
+  MaxCached = std::max<size_t>(1, (size_t)ReachCacheLimit * 1024 / Bytes);
 }
 
-CFG::~CFG() { delete[] ReachableVecPtr; }
+CFG::~CFG() = default;
+
+bool CFG::mayReach(unsigned From, unsigned To) const {
+  // successors have smaller numbers
+  if (From < To)
+    return false;
+  for (unsigned T = 0; T < NumTraversals; ++T) {
+    auto &FromLabel = Labels[T][From];
+    auto &ToLabel = Labels[T][To];
+    if (ToLabel.first < FromLabel.first || ToLabel.second > FromLabel.second)
+      return false;
+  }
+  return true;
+}
+
+const BitVector &CFG::getReachable(unsigned Component) {
+  auto It = ReachableCache.find(Component);
+  if (It != ReachableCache.end()) {
+    LRUList.splice(LRUList.begin(), LRUList, It->second.second);
+    return It->second.first;
+  }
+
+  if (ReachableCache.size() >= MaxCached) {
+    ReachableCache.erase(LRUList.back());
+    LRUList.pop_back();
+  }
+  LRUList.push_front(Component);
+  auto &Entry = ReachableCache[Component];
+  Entry.second = LRUList.begin();
+  BitVector &Reachable = Entry.first;
+  Reachable.resize(numComponents());
+  std::vector<unsigned> WorkStack;
+  WorkStack.push_back(Component);
+  Reachable.set(Component);
+  while (!WorkStack.empty()) {
+    unsigned C = WorkStack.back();
+    WorkStack.pop_back();
+    for (unsigned K = SuccBegin[C]; K < SuccBegin[C + 1]; ++K) {
+      unsigned Succ = Succs[K];
+      if (Reachable.test(Succ))
+        continue;
+      Reachable.set(Succ);
+      WorkStack.push_back(Succ);
+    }
+  }
+  return Reachable;
+}
 
 bool CFG::reachable(BasicBlock *From, BasicBlock *To) {
   assert(From && To);
   if (From == To)
     return true;
 
-  assert(BB2ID.count(To) && BB2ID.count(From));
-  const unsigned DstBlockID = BB2ID.at(To);
-  // If we haven't AnalyzedVect the destination node, run the analysis now
-  if (!AnalyzedVec[DstBlockID]) {
-    analyze(To);
-    AnalyzedVec[DstBlockID] = true;
-  }
-
-  // return the result from the cache
-  return ReachableVecPtr[DstBlockID][BB2ID.at(From)];
+  assert(BlockComponents.count(To) && BlockComponents.count(From));
+  unsigned FromC = BlockComponents.lookup(From);
+  unsigned ToC = BlockComponents.lookup(To);
+  // two blocks in a loop reach each other
+  if (FromC == ToC)
+    return true;
+  if (!mayReach(FromC, ToC))
+    return false;
+  return getReachable(FromC).test(ToC);
 }
 
 bool CFG::reachable(Instruction *From, Instruction *To) {
@@ -56,36 +208,7 @@ bool CFG::reachable(Instruction *From, Instruction *To) {
 
   auto *FromB = From->getParent();
   auto *ToB = To->getParent();
-  if (FromB == ToB) {
-    while (From) {
-      From = From->getNextNode();
-      if (From == To)
-        return true;
-    }
-    return false;
-  } else {
-    return reachable(FromB, ToB);
-  }
+  if (FromB == ToB)
+    return Ordinals.lookup(From) < Ordinals.lookup(To);
+  return reachable(FromB, ToB);
 }
-
-void CFG::analyze(BasicBlock *ToBB) {
-  BitVector VisitedVec(AnalyzedVec.size());
-  ReachableVec &ToReachability = ReachableVecPtr[BB2ID[ToBB]];
-  std::vector<BasicBlock *> Worklist;
-  Worklist.push_back(ToBB);
-  bool FirstRun = true;
-  while (!Worklist.empty()) {
-    auto *BB = Worklist.back();
-    Worklist.pop_back();
-    unsigned BBID = BB2ID[BB];
-    if (VisitedVec[BBID])
-      continue;
-    VisitedVec[BBID] = true;
-    if (!FirstRun)
-      ToReachability[BBID] = true;
-    else
-      FirstRun = false;
-    for (auto *Pred : predecessors(BB))
-      Worklist.push_back(Pred);
-  }
-}
\ No newline at end of file
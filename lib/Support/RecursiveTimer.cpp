@@ -48,4 +48,8 @@ RecursiveTimer::~RecursiveTimer() {
          << "!\n";
 }
 
+void RecursiveTimer::print(const std::string &Message) {
+  outs() << Tab(DepthOfTimeRecorder) << Message << "\n";
+}
+
 char RecursiveTimerPass::ID = 0;
\ No newline at end of file
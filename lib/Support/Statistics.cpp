@@ -49,7 +49,7 @@ void Statistics::run(Module &M) {
       } else if (auto *CI = dyn_cast<CallInst>(&I)) {
         if (auto *Callee = CI->getCalledFunction()) {
           if (Callee->empty()) {
-            for (unsigned K = 0; K < CI->getNumArgOperands(); ++K) {
+            for (unsigned K = 0; K < CI->arg_size(); ++K) {
               if (CI->getArgOperand(K)->getType()->isPointerTy()) {
                 ++NumDerefInstructions;
                 printf ("Instruction: %s\n", I.getOpcodeName());
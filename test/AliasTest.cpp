@@ -1,7 +1,23 @@
 #include "gtest/gtest.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/AsmParser/Parser.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/InitializePasses.h>
+#include <llvm/Support/SourceMgr.h>
 #include <map>
 #include <climits>
 #include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "DyckAA/DyckAliasAnalysis.h"
+#include "DyckAA/DyckGraph.h"
+
+using namespace llvm;
 
 // Returns n! (the factorial of n).  For negative n, n! is defined to be 1.
 int Factorial(int n) {
@@ -45,4 +61,78 @@ TEST(IsPrimeTest, Negative) {
 	EXPECT_FALSE(IsPrime(INT_MIN));
 }
 
+// %a is loaded from where @g is stored, so it aliases @g, while %b is a separate object.
+const char *AliasModule = "@g = global i32 0\n"
+                          "define void @f(i32** %pp) {\n"
+                          "entry:\n"
+                          "  store i32* @g, i32** %pp\n"
+                          "  %a = load i32*, i32** %pp\n"
+                          "  %b = alloca i32\n"
+                          "  store i32 0, i32* %b\n"
+                          "  ret void\n"
+                          "}\n";
+
+/// The answers of mayAlias and of mayAliasBatch for the same queries; the batch results are appended to one
+/// existing entry, which must be kept.
+struct AliasResults {
+	std::vector<bool> Single;
+	SmallVector<bool, 8> Batch;
+	bool UnknownIndexed = true;
+};
+
+/// Queries the values of AliasModule, plus a constant that is not in the module and thus has no frozen index.
+struct AliasChecker : public ModulePass {
+	static char ID;
+	AliasResults &Results;
+
+	explicit AliasChecker(AliasResults &Results) : ModulePass(ID), Results(Results) {}
+
+	void getAnalysisUsage(AnalysisUsage &AU) const override {
+		AU.setPreservesAll();
+		AU.addRequired<DyckAliasAnalysis>();
+	}
+
+	bool runOnModule(Module &M) override {
+		auto *DAA = &getAnalysis<DyckAliasAnalysis>();
+		std::map<std::string, Value *> Values;
+		Values["g"] = M.getGlobalVariable("g");
+		for (auto &I: instructions(M.getFunction("f")))
+			if (I.hasName()) Values[I.getName().str()] = &I;
+		Value *Unknown = ConstantInt::get(Type::getInt64Ty(M.getContext()), 12345);
+		Results.UnknownIndexed = DAA->getDyckGraph()->getFrozenIndex(Unknown) != UINT_MAX;
+
+		std::vector<std::pair<Value *, Value *>> Queries = {
+			{Values.at("a"), Values.at("g")}, {Values.at("b"), Values.at("g")}, {Values.at("a"), Values.at("b")},
+			{Unknown, Unknown}, {Unknown, Values.at("g")}, {Values.at("g"), Unknown},
+		};
+		for (auto &Query: Queries) Results.Single.push_back(DAA->mayAlias(Query.first, Query.second));
+		Results.Batch.push_back(false);
+		DAA->mayAliasBatch(Queries, Results.Batch);
+		return false;
+	}
+};
+
+char AliasChecker::ID = 0;
+
+TEST(DyckAATest, MayAliasBatch) {
+	initializeCore(*PassRegistry::getPassRegistry());
+	initializeAnalysis(*PassRegistry::getPassRegistry());
+
+	LLVMContext Ctx;
+	SMDiagnostic Err;
+	auto M = parseAssemblyString(AliasModule, Err, Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	AliasResults Results;
+	legacy::PassManager PM;
+	PM.add(new AliasChecker(Results));
+	PM.run(*M);
+	EXPECT_FALSE(Results.UnknownIndexed);
+	std::vector<bool> Expected = {true, false, false, true, false, false};
+	EXPECT_EQ(Expected, Results.Single);
+	ASSERT_EQ(Expected.size() + 1, Results.Batch.size());
+	EXPECT_FALSE(Results.Batch[0]);
+	for (unsigned K = 0; K < Expected.size(); ++K) EXPECT_EQ(Expected[K], Results.Batch[K + 1]);
+}
+
 }
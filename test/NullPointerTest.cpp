@@ -0,0 +1,544 @@
+#include "gtest/gtest.h"
+#include <llvm/AsmParser/Parser.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/InitializePasses.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/SourceMgr.h>
+#include <climits>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "DyckAA/DyckVFG.h"
+#include "DyckAA/DyckValueFlowAnalysis.h"
+#include "NullPointer/LocalNullCheckAnalysis.h"
+#include "NullPointer/NullCheckAnalysis.h"
+#include "NullPointer/NullFlowAnalysis.h"
+
+using namespace llvm;
+
+namespace {
+
+/// name -> value, for the arguments and the named instructions of \p M
+std::map<std::string, Value *> getNamedValues(Module &M) {
+	std::map<std::string, Value *> Values;
+	for (auto &F: M) {
+		for (auto &Arg: F.args()) Values[Arg.getName().str()] = &Arg;
+		for (auto &I: instructions(F))
+			if (I.hasName()) Values[I.getName().str()] = &I;
+	}
+	return Values;
+}
+
+std::unique_ptr<Module> parseModule(const char *IR, LLVMContext &Ctx) {
+	initializeCore(*PassRegistry::getPassRegistry());
+	initializeAnalysis(*PassRegistry::getPassRegistry());
+	SMDiagnostic Err;
+	return parseAssemblyString(IR, Err, Ctx);
+}
+
+// %x may be null, and it is the only source of %n, which is the only source of %t.
+const char *ChainModule = "@g = global i32* null\n"
+                          "define void @init() {\n"
+                          "entry:\n"
+                          "  store i32* null, i32** @g\n"
+                          "  ret void\n"
+                          "}\n"
+                          "define void @f() {\n"
+                          "entry:\n"
+                          "  %x = load i32*, i32** @g\n"
+                          "  %n = bitcast i32* %x to i8*\n"
+                          "  %t = bitcast i8* %n to i32*\n"
+                          "  ret void\n"
+                          "}\n";
+
+struct ChainResults {
+	bool Ordered = false;
+	bool MayNullBefore = false;
+	bool Changed = false;
+	std::map<std::string, bool> NotNull;
+};
+
+/// Declares x->n and n->t non-null in one round. The edges of a function are applied in the order of their ids,
+/// so n becomes non-null before the edge from n is seen, and n must still discharge t.
+struct ChainChecker : public ModulePass {
+	static char ID;
+	ChainResults &Results;
+
+	explicit ChainChecker(ChainResults &Results) : ModulePass(ID), Results(Results) {}
+
+	void getAnalysisUsage(AnalysisUsage &AU) const override {
+		AU.setPreservesAll();
+		AU.addRequired<DyckValueFlowAnalysis>();
+		AU.addRequired<NullFlowAnalysis>();
+	}
+
+	bool runOnModule(Module &M) override {
+		auto *VFG = getAnalysis<DyckValueFlowAnalysis>().getDyckVFGraph();
+		auto *NFA = &getAnalysis<NullFlowAnalysis>();
+		auto Values = getNamedValues(M);
+		auto *X = Values.at("x"), *N = Values.at("n"), *T = Values.at("t");
+		Results.Ordered = VFG->getNodeID(X) < VFG->getNodeID(N) && VFG->getNodeID(N) != UINT_MAX;
+		Results.MayNullBefore = !NFA->notNull(N) && !NFA->notNull(T);
+
+		auto *F = M.getFunction("f");
+		NFA->add(F, X, N);
+		NFA->add(F, N, T);
+		std::set<Function *> NewNonNullFunctions;
+		Results.Changed = NFA->recompute(NewNonNullFunctions);
+		for (auto *Name: {"x", "n", "t"}) Results.NotNull[Name] = NFA->notNull(Values.at(Name));
+		return false;
+	}
+};
+
+char ChainChecker::ID = 0;
+
+TEST(NullFlowTest, QueuedNodeDischargesNewEdge) {
+	LLVMContext Ctx;
+	auto M = parseModule(ChainModule, Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	ChainResults Results;
+	legacy::PassManager PM;
+	PM.add(new ChainChecker(Results));
+	PM.run(*M);
+	ASSERT_TRUE(Results.Ordered);
+	ASSERT_TRUE(Results.MayNullBefore);
+	EXPECT_TRUE(Results.Changed);
+	EXPECT_FALSE(Results.NotNull["x"]);
+	EXPECT_TRUE(Results.NotNull["n"]);
+	EXPECT_TRUE(Results.NotNull["t"]);
+}
+
+/// Sets a registered option and returns its previous value, so that a test can restore it.
+template<typename T> T setOption(const char *Name, T Val) {
+	auto *Opt = static_cast<cl::opt<T> *>(cl::getRegisteredOptions().lookup(Name));
+	if (!Opt) {
+		ADD_FAILURE() << "unknown option " << Name;
+		return Val;
+	}
+	T Old = Opt->getValue();
+	Opt->setValue(Val);
+	return Old;
+}
+
+/// The answers of NullCheckAnalysis::mayNull.
+struct NullCheckResults {
+	/// the answers for all pointer operands, in the order of the instructions in the module
+	std::vector<bool> All;
+	/// named instruction -> operand number -> the answer, for its pointer operands
+	std::map<std::string, std::map<unsigned, bool>> Named;
+};
+
+/// Records the answers for the functions of Order, in that order, or for all functions if Order is empty. Each answer
+/// is recorded when it is first queried, so a demand-driven run is compared as a client sees it.
+struct NullCheckCollector : public ModulePass {
+	static char ID;
+	NullCheckResults &Results;
+	std::vector<std::string> Order;
+
+	NullCheckCollector(NullCheckResults &Results, std::vector<std::string> Order)
+		: ModulePass(ID), Results(Results), Order(std::move(Order)) {}
+
+	void getAnalysisUsage(AnalysisUsage &AU) const override {
+		AU.setPreservesAll();
+		AU.addRequired<NullCheckAnalysis>();
+	}
+
+	bool runOnModule(Module &M) override {
+		auto *NCA = &getAnalysis<NullCheckAnalysis>();
+		auto Query = [this, NCA](Function *F) {
+			for (auto &I: instructions(F)) {
+				for (unsigned K = 0; K < I.getNumOperands(); ++K) {
+					auto *Op = I.getOperand(K);
+					if (!Op->getType()->isPointerTy()) continue;
+					bool MayNull = NCA->mayNull(Op, &I);
+					Results.All.push_back(MayNull);
+					if (I.hasName()) Results.Named[I.getName().str()][K] = MayNull;
+				}
+			}
+		};
+		if (Order.empty())
+			for (auto &F: M) Query(&F);
+		else
+			for (auto &Name: Order) Query(M.getFunction(Name));
+		return false;
+	}
+};
+
+char NullCheckCollector::ID = 0;
+
+NullCheckResults runNullCheckAnalysis(Module &M, std::vector<std::string> Order = {}) {
+	NullCheckResults Results;
+	legacy::PassManager PM;
+	PM.add(new NullCheckCollector(Results, std::move(Order)));
+	PM.run(M);
+	return Results;
+}
+
+// %p is checked on one branch only and dereferenced at the join, %q is dereferenced in a loop.
+const char *LocalModule = "@gp = global i32* null\n"
+                          "define void @init() {\n"
+                          "entry:\n"
+                          "  store i32* null, i32** @gp\n"
+                          "  ret void\n"
+                          "}\n"
+                          "define i32 @local(i32 %n) {\n"
+                          "entry:\n"
+                          "  %p = load i32*, i32** @gp\n"
+                          "  %q = load i32*, i32** @gp\n"
+                          "  %c = icmp eq i32* %p, null\n"
+                          "  br i1 %c, label %isnull, label %nonnull\n"
+                          "isnull:\n"
+                          "  br label %join\n"
+                          "nonnull:\n"
+                          "  %a = load i32, i32* %p\n"
+                          "  br label %join\n"
+                          "join:\n"
+                          "  %b = load i32, i32* %p\n"
+                          "  br label %loop\n"
+                          "loop:\n"
+                          "  %i = phi i32 [ 0, %join ], [ %i1, %loop ]\n"
+                          "  %v = load i32, i32* %q\n"
+                          "  %w = load i32, i32* %p\n"
+                          "  %i1 = add i32 %i, 1\n"
+                          "  %e = icmp slt i32 %i1, %n\n"
+                          "  br i1 %e, label %loop, label %exit\n"
+                          "exit:\n"
+                          "  %x = load i32, i32* %q\n"
+                          "  ret i32 %x\n"
+                          "}\n";
+
+TEST(NullCheckTest, BranchJoinAndLoop) {
+	LLVMContext Ctx;
+	auto M = parseModule(LocalModule, Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	auto Results = runNullCheckAnalysis(*M);
+	EXPECT_TRUE(Results.Named["c"][0]);
+	// the check holds on its branch, but not after the join
+	EXPECT_FALSE(Results.Named["a"][0]);
+	EXPECT_TRUE(Results.Named["b"][0]);
+	// the dereference at the join holds in the loop
+	EXPECT_FALSE(Results.Named["w"][0]);
+	// the dereference in the loop does not hold at the loop head, which is also reached from outside
+	EXPECT_TRUE(Results.Named["v"][0]);
+	EXPECT_FALSE(Results.Named["x"][0]);
+}
+
+// %r is carried around a loop, and %p is dereferenced before a check that is thus never taken. The call to @id makes
+// @loop run a second round, in which the edge of the check is known to be unreachable.
+const char *LoopModule = "@gp = global i32* null\n"
+                         "define void @init() {\n"
+                         "entry:\n"
+                         "  store i32* null, i32** @gp\n"
+                         "  ret void\n"
+                         "}\n"
+                         "define i32* @id(i32* %x) {\n"
+                         "entry:\n"
+                         "  ret i32* %x\n"
+                         "}\n"
+                         "define void @loop(i32 %n) {\n"
+                         "entry:\n"
+                         "  %p = load i32*, i32** @gp\n"
+                         "  %q = load i32*, i32** @gp\n"
+                         "  %a = load i32, i32* %p\n"
+                         "  %id = call i32* @id(i32* %p)\n"
+                         "  %c = icmp eq i32* %p, null\n"
+                         "  br i1 %c, label %isnull, label %nonnull\n"
+                         "isnull:\n"
+                         "  br label %join\n"
+                         "nonnull:\n"
+                         "  %b = load i32, i32* %q\n"
+                         "  br label %join\n"
+                         "join:\n"
+                         "  %d = load i32, i32* %q\n"
+                         "  br label %loop\n"
+                         "loop:\n"
+                         "  %r = phi i32* [ %p, %join ], [ %s, %loop ]\n"
+                         "  %i = phi i32 [ 0, %join ], [ %i1, %loop ]\n"
+                         "  %v = load i32, i32* %r\n"
+                         "  %w = load i32, i32* %p\n"
+                         "  %s = getelementptr i32, i32* %r, i64 1\n"
+                         "  %i1 = add i32 %i, 1\n"
+                         "  %e = icmp slt i32 %i1, %n\n"
+                         "  br i1 %e, label %loop, label %exit\n"
+                         "exit:\n"
+                         "  %x = load i32, i32* %r\n"
+                         "  ret void\n"
+                         "}\n";
+
+TEST(NullCheckTest, SparseAgreesWithDense) {
+	LLVMContext Ctx;
+	auto M = parseModule(LoopModule, Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	NullCheckResults Results[2];
+	bool Sparse = setOption("nca-sparse", false);
+	for (unsigned K = 0; K < 2; ++K) {
+		setOption("nca-sparse", K == 1);
+		Results[K] = runNullCheckAnalysis(*M);
+	}
+	setOption("nca-sparse", Sparse);
+
+	// the sparse engine never reports a may-null operand the dense one does not
+	ASSERT_EQ(Results[0].All.size(), Results[1].All.size());
+	for (unsigned K = 0; K < Results[0].All.size(); ++K)
+		EXPECT_TRUE(Results[0].All[K] || !Results[1].All[K]) << "operand " << K;
+
+	for (auto &R: Results) {
+		EXPECT_TRUE(R.Named["a"][0]);
+		EXPECT_FALSE(R.Named["id"][0]);
+		EXPECT_TRUE(R.Named["b"][0]);
+		// a dereference before the loop holds in the loop, the loop-carried ptr does not hold at the loop head
+		EXPECT_FALSE(R.Named["w"][0]);
+		EXPECT_TRUE(R.Named["v"][0]);
+		EXPECT_FALSE(R.Named["x"][0]);
+		// the branch of the check is unreachable, so it does not weaken the fact at the join
+		EXPECT_FALSE(R.Named["d"][0]);
+	}
+}
+
+// The checked %p is the 35th operand of a vararg call, beyond the 32 operands a mask of an instruction used to hold.
+std::string buildWideCallModule() {
+	std::string IR = "@gp = global i32* null\n"
+	                 "declare i32 @log(i32*, ...)\n"
+	                 "define void @init() {\n"
+	                 "entry:\n"
+	                 "  store i32* null, i32** @gp\n"
+	                 "  ret void\n"
+	                 "}\n"
+	                 "define void @wide() {\n"
+	                 "entry:\n"
+	                 "  %p = load i32*, i32** @gp\n"
+	                 "  %c = icmp eq i32* %p, null\n"
+	                 "  br i1 %c, label %out, label %use\n"
+	                 "use:\n"
+	                 "  %l = call i32 (i32*, ...) @log(";
+	for (unsigned K = 0; K < 34; ++K) IR += "i32* null, ";
+	IR += "i32* %p)\n"
+	      "  br label %out\n"
+	      "out:\n"
+	      "  ret void\n"
+	      "}\n";
+	return IR;
+}
+
+TEST(NullCheckTest, WideCall) {
+	LLVMContext Ctx;
+	auto IR = buildWideCallModule();
+	auto M = parseModule(IR.c_str(), Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	bool Sparse = setOption("nca-sparse", false);
+	for (unsigned K = 0; K < 2; ++K) {
+		setOption("nca-sparse", K == 1);
+		auto Results = runNullCheckAnalysis(*M);
+		ASSERT_EQ(1u, Results.Named["l"].count(34));
+		EXPECT_FALSE(Results.Named["l"][34]) << (K ? "sparse" : "dense");
+	}
+	setOption("nca-sparse", Sparse);
+}
+
+// The check in @h makes %a non-null, and so %b, which makes %r non-null in @g. @h is a source of @f but not of @g, so
+// a query of @g alone must analyze the sources of its sources. %e is in the group of %b, whose representative %d
+// follows %b, but %e has no value-flow source, so only @g can tell NFA that %e, and so %z, is non-null, even if @g is
+// first analyzed after %b is non-null.
+const char *DemandModule = "@gp = global i32* null\n"
+                           "define void @init() {\n"
+                           "entry:\n"
+                           "  store i32* null, i32** @gp\n"
+                           "  ret void\n"
+                           "}\n"
+                           "define void @h() {\n"
+                           "entry:\n"
+                           "  %p = load i32*, i32** @gp\n"
+                           "  %c = icmp eq i32* %p, null\n"
+                           "  br i1 %c, label %out, label %call\n"
+                           "call:\n"
+                           "  call void @f(i32* %p)\n"
+                           "  br label %out\n"
+                           "out:\n"
+                           "  ret void\n"
+                           "}\n"
+                           "define void @f(i32* %a) {\n"
+                           "entry:\n"
+                           "  call void @g(i32* %a)\n"
+                           "  ret void\n"
+                           "}\n"
+                           "define void @g(i32* %b) {\n"
+                           "entry:\n"
+                           "  %d = bitcast i32* %b to i8*\n"
+                           "  %e = getelementptr i32, i32* %b, i64 1\n"
+                           "  call void @use(i32* %e)\n"
+                           "  %q = load i32*, i32** @gp\n"
+                           "  %c = icmp eq i32* %q, null\n"
+                           "  br i1 %c, label %out, label %use\n"
+                           "use:\n"
+                           "  %k = icmp ult i32* %b, %q\n"
+                           "  %r = select i1 %k, i32* %b, i32* %q\n"
+                           "  %v = load i32, i32* %r\n"
+                           "  br label %out\n"
+                           "out:\n"
+                           "  ret void\n"
+                           "}\n"
+                           "define void @use(i32* %z) {\n"
+                           "entry:\n"
+                           "  br label %load\n"
+                           "load:\n"
+                           "  %x = load i32, i32* %z\n"
+                           "  ret void\n"
+                           "}\n";
+
+TEST(NullCheckTest, DemandDrivenOrder) {
+	LLVMContext Ctx;
+	auto M = parseModule(DemandModule, Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	std::vector<std::vector<std::string>> Orders = {{"f", "g"}, {"g", "f"}, {"g"}, {"f", "use"}};
+	bool Demand = setOption("nca-demand", false);
+	std::vector<NullCheckResults> Expected;
+	for (auto &Order: Orders) Expected.push_back(runNullCheckAnalysis(*M, Order));
+	setOption("nca-demand", true);
+	std::vector<NullCheckResults> Results;
+	for (auto &Order: Orders) Results.push_back(runNullCheckAnalysis(*M, Order));
+	setOption("nca-demand", Demand);
+
+	EXPECT_FALSE(Expected[0].Named["v"][0]);
+	EXPECT_FALSE(Expected[3].Named["x"][0]);
+	for (unsigned K = 0; K < Orders.size(); ++K) {
+		std::string Queries = Orders[K][0];
+		for (unsigned J = 1; J < Orders[K].size(); ++J) Queries += ", " + Orders[K][J];
+		EXPECT_EQ(Expected[K].All, Results[K].All) << Queries;
+		EXPECT_FALSE(Results[K].Named["v"][0]) << Queries;
+	}
+}
+
+// Like DemandModule, but @g also checks %b, so the null branch becomes unreachable once %b is non-null, and %t is
+// non-null at the join along the other branch only.
+const char *ResumeModule = "@gp = global i32* null\n"
+                           "define void @init() {\n"
+                           "entry:\n"
+                           "  store i32* null, i32** @gp\n"
+                           "  ret void\n"
+                           "}\n"
+                           "define void @h() {\n"
+                           "entry:\n"
+                           "  %p = load i32*, i32** @gp\n"
+                           "  %c = icmp eq i32* %p, null\n"
+                           "  br i1 %c, label %out, label %call\n"
+                           "call:\n"
+                           "  call void @g(i32* %p)\n"
+                           "  br label %out\n"
+                           "out:\n"
+                           "  ret void\n"
+                           "}\n"
+                           "define void @g(i32* %b) {\n"
+                           "entry:\n"
+                           "  %q = load i32*, i32** @gp\n"
+                           "  %t = load i32*, i32** @gp\n"
+                           "  %c = icmp eq i32* %q, null\n"
+                           "  br i1 %c, label %out, label %use\n"
+                           "use:\n"
+                           "  %k = icmp ult i32* %b, %q\n"
+                           "  %r = select i1 %k, i32* %b, i32* %q\n"
+                           "  %v = load i32, i32* %r\n"
+                           "  %d = icmp eq i32* %b, null\n"
+                           "  br i1 %d, label %isnull, label %nonnull\n"
+                           "isnull:\n"
+                           "  br label %join\n"
+                           "nonnull:\n"
+                           "  %u = load i32, i32* %t\n"
+                           "  br label %join\n"
+                           "join:\n"
+                           "  %w = load i32, i32* %t\n"
+                           "  br label %out\n"
+                           "out:\n"
+                           "  ret void\n"
+                           "}\n";
+
+/// The answers for the pointer operands of @g, before and after NFA proves %b non-null.
+struct ResumeResults {
+	bool NonNullBefore = true;
+	bool NonNullAfter = false;
+	std::vector<bool> Before;
+	std::vector<bool> Resumed;
+	std::vector<bool> Fresh;
+	std::map<std::string, bool> Named;
+};
+
+/// Runs the analysis of @g, then the analysis of @h, whose check makes %b non-null, and compares resuming the
+/// analysis of @g with analyzing @g from scratch.
+struct ResumeChecker : public ModulePass {
+	static char ID;
+	ResumeResults &Results;
+
+	explicit ResumeChecker(ResumeResults &Results) : ModulePass(ID), Results(Results) {}
+
+	void getAnalysisUsage(AnalysisUsage &AU) const override {
+		AU.setPreservesAll();
+		AU.addRequired<NullFlowAnalysis>();
+	}
+
+	bool runOnModule(Module &M) override {
+		auto *NFA = &getAnalysis<NullFlowAnalysis>();
+		auto *G = M.getFunction("g");
+		auto Query = [G](LocalNullCheckAnalysis &LNCA, std::vector<bool> &Answers) {
+			for (auto &I: instructions(G))
+				for (unsigned K = 0; K < I.getNumOperands(); ++K)
+					if (I.getOperand(K)->getType()->isPointerTy()) Answers.push_back(LNCA.mayNull(I.getOperand(K), &I));
+		};
+
+		Results.NonNullBefore = NFA->notNull(G->getArg(0));
+		LocalNullCheckAnalysis Resumed(NFA, G);
+		Resumed.run();
+		Query(Resumed, Results.Before);
+
+		LocalNullCheckAnalysis H(NFA, M.getFunction("h"));
+		H.run();
+		std::set<Function *> Funcs;
+		NFA->recompute(Funcs);
+		Results.NonNullAfter = NFA->notNull(G->getArg(0));
+
+		Resumed.run();
+		Query(Resumed, Results.Resumed);
+		LocalNullCheckAnalysis Fresh(NFA, G);
+		Fresh.run();
+		Query(Fresh, Results.Fresh);
+		for (auto &I: instructions(G))
+			if (I.hasName() && isa<LoadInst>(I)) Results.Named[I.getName().str()] = Fresh.mayNull(I.getOperand(0), &I);
+		return false;
+	}
+};
+
+char ResumeChecker::ID = 0;
+
+TEST(NullCheckTest, ResumeEqualsFromScratch) {
+	LLVMContext Ctx;
+	auto M = parseModule(ResumeModule, Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	bool Sparse = setOption("nca-sparse", false);
+	for (unsigned K = 0; K < 2; ++K) {
+		setOption("nca-sparse", K == 1);
+		ResumeResults Results;
+		legacy::PassManager PM;
+		PM.add(new ResumeChecker(Results));
+		PM.run(*M);
+		const char *Engine = K ? "sparse" : "dense";
+		ASSERT_FALSE(Results.NonNullBefore) << Engine;
+		ASSERT_TRUE(Results.NonNullAfter) << Engine;
+		EXPECT_NE(Results.Before, Results.Resumed) << Engine;
+		EXPECT_EQ(Results.Fresh, Results.Resumed) << Engine;
+		// the seed %b makes the select non-null, and the branch where %b is null is never taken
+		EXPECT_FALSE(Results.Named["v"]) << Engine;
+		EXPECT_FALSE(Results.Named["w"]) << Engine;
+	}
+	setOption("nca-sparse", Sparse);
+}
+
+} // namespace
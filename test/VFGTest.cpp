@@ -0,0 +1,267 @@
+#include "gtest/gtest.h"
+#include <llvm/AsmParser/Parser.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/InitializePasses.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/SourceMgr.h>
+#include <climits>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include "DyckAA/DyckVFG.h"
+#include "DyckAA/DyckValueFlowAnalysis.h"
+
+using namespace llvm;
+
+namespace {
+
+// Every function stores null into its own memory and loads it back, so the null node of the VFG gets a target
+// from each of them. With more than one worker, the functions are analyzed in parallel, which should be
+// clean under ThreadSanitizer (configure with -DENABLE_TSAN=ON).
+const unsigned NumFunctions = 64;
+
+std::string buildModule() {
+	std::string IR = "@g = global i32* null\n";
+	for (unsigned K = 0; K < NumFunctions; ++K) {
+		auto Name = "f" + std::to_string(K);
+		IR += "define void @" + Name + "(i32** %p) {\n"
+		      "entry:\n"
+		      "  store i32* null, i32** %p\n"
+		      "  %v = load i32*, i32** %p\n"
+		      "  store i32* %v, i32** @g\n"
+		      "  ret void\n"
+		      "}\n";
+	}
+	return IR;
+}
+
+struct VFGChecker : public ModulePass {
+	static char ID;
+	unsigned NumNullTargets = 0;
+	unsigned NumLoadSources = 0;
+
+	VFGChecker() : ModulePass(ID) {}
+
+	void getAnalysisUsage(AnalysisUsage &AU) const override {
+		AU.setPreservesAll();
+		AU.addRequired<DyckValueFlowAnalysis>();
+	}
+
+	bool runOnModule(Module &M) override {
+		auto *VFG = getAnalysis<DyckValueFlowAnalysis>().getDyckVFGraph();
+		auto *Null = ConstantPointerNull::get(Type::getInt32PtrTy(M.getContext()));
+		unsigned NullNode = VFG->getNodeID(Null);
+		if (NullNode == UINT_MAX) return false;
+		for (auto Edge: VFG->targets(NullNode)) {
+			auto *Load = dyn_cast<LoadInst>(VFG->getNode(Edge.first)->getValue());
+			if (Load && Edge.second == 0) ++NumNullTargets;
+		}
+		for (auto &F: M) {
+			for (auto &I: instructions(F)) {
+				unsigned LoadNode = isa<LoadInst>(I) ? VFG->getNodeID(&I) : UINT_MAX;
+				if (LoadNode == UINT_MAX) continue;
+				for (auto Edge: VFG->sources(LoadNode))
+					if (Edge.first == NullNode) ++NumLoadSources;
+			}
+		}
+		return false;
+	}
+};
+
+char VFGChecker::ID = 0;
+
+// The callee reads and writes the memory of its argument through three values, and the caller has three values of
+// the same memory before the call, so the mod/ref values of the call are connected through hub nodes.
+const char *HubModule = "define void @callee(i32** %p) {\n"
+                        "entry:\n"
+                        "  %x = load i32*, i32** %p\n"
+                        "  %x1 = bitcast i32* %x to i8*\n"
+                        "  %x2 = bitcast i32* %x to i64*\n"
+                        "  store i32* %x, i32** %p\n"
+                        "  ret void\n"
+                        "}\n"
+                        "define void @caller(i32** %q, i32* %v) {\n"
+                        "entry:\n"
+                        "  %v1 = bitcast i32* %v to i8*\n"
+                        "  %v2 = bitcast i32* %v to i64*\n"
+                        "  store i32* %v, i32** %q\n"
+                        "  call void @callee(i32** %q)\n"
+                        "  ret void\n"
+                        "}\n";
+
+/// The value flows between values, where a path through a hub node counts as one edge. The labels are kept
+/// as their signs, because the ids of the calls differ from run to run.
+struct HubStatistics {
+	std::set<std::tuple<Value *, Value *, int>> Edges;
+	unsigned NumEdges = 0;
+	unsigned NumHubs = 0;
+};
+
+struct HubChecker : public ModulePass {
+	static char ID;
+	HubStatistics &Stats;
+
+	explicit HubChecker(HubStatistics &Stats) : ModulePass(ID), Stats(Stats) {}
+
+	void getAnalysisUsage(AnalysisUsage &AU) const override {
+		AU.setPreservesAll();
+		AU.addRequired<DyckValueFlowAnalysis>();
+	}
+
+	bool runOnModule(Module &M) override {
+		auto *VFG = getAnalysis<DyckValueFlowAnalysis>().getDyckVFGraph();
+		Stats.NumEdges = VFG->numEdges();
+		auto Sign = [](int L) { return L > 0 ? 1 : (L < 0 ? -1 : 0); };
+		for (unsigned N = 0; N < VFG->numNodes(); ++N) {
+			auto *From = VFG->getNode(N)->getValue();
+			if (!From) {
+				++Stats.NumHubs;
+				continue;
+			}
+			for (auto Edge: VFG->targets(N)) {
+				auto *To = VFG->getNode(Edge.first)->getValue();
+				if (To) {
+					Stats.Edges.emplace(From, To, Sign(Edge.second));
+					continue;
+				}
+				for (auto HubEdge: VFG->targets(Edge.first))
+					Stats.Edges.emplace(From, VFG->getNode(HubEdge.first)->getValue(),
+					                    Sign(Edge.second + HubEdge.second));
+			}
+		}
+		return false;
+	}
+};
+
+char HubChecker::ID = 0;
+
+// The identity function is called twice, so a context-sensitive query does not let %p flow to %b.
+const char *IdentityModule = "define i32* @id(i32* %x) {\n"
+                             "entry:\n"
+                             "  ret i32* %x\n"
+                             "}\n"
+                             "define void @main(i32* %p, i32* %q) {\n"
+                             "entry:\n"
+                             "  %a = call i32* @id(i32* %p)\n"
+                             "  %b = call i32* @id(i32* %q)\n"
+                             "  ret void\n"
+                             "}\n";
+
+struct IndexChecker : public ModulePass {
+	static char ID;
+	std::map<std::pair<std::string, std::string>, bool> &Results;
+
+	explicit IndexChecker(std::map<std::pair<std::string, std::string>, bool> &Results)
+		: ModulePass(ID), Results(Results) {}
+
+	void getAnalysisUsage(AnalysisUsage &AU) const override {
+		AU.setPreservesAll();
+		AU.addRequired<DyckValueFlowAnalysis>();
+	}
+
+	bool runOnModule(Module &M) override {
+		auto *Index = getAnalysis<DyckValueFlowAnalysis>().getDyckVFGIndex();
+		std::map<std::string, Value *> Values;
+		for (auto &F: M) {
+			for (auto &Arg: F.args()) Values[Arg.getName().str()] = &Arg;
+			for (auto &I: instructions(F))
+				if (I.hasName()) Values[I.getName().str()] = &I;
+		}
+		for (auto &It: Results) It.second = Index->reach(Values.at(It.first.first), Values.at(It.first.second));
+		return false;
+	}
+};
+
+char IndexChecker::ID = 0;
+
+/// Sets a registered option and returns its previous value, so that a test can restore it.
+template<typename T> T setOption(const char *Name, T Val) {
+	auto *Opt = static_cast<cl::opt<T> *>(cl::getRegisteredOptions().lookup(Name));
+	if (!Opt) {
+		ADD_FAILURE() << "unknown option " << Name;
+		return Val;
+	}
+	T Old = Opt->getValue();
+	Opt->setValue(Val);
+	return Old;
+}
+
+TEST(DyckVFGTest, ParallelLocalValueFlows) {
+	// the pool reads -nworkers when it is first used, i.e., by this test if it runs first; restore the option
+	// so that later tests see the value they would see on their own
+	unsigned NumWorkers = setOption("nworkers", 4u);
+	initializeCore(*PassRegistry::getPassRegistry());
+	initializeAnalysis(*PassRegistry::getPassRegistry());
+
+	LLVMContext Ctx;
+	SMDiagnostic Err;
+	auto M = parseAssemblyString(buildModule(), Err, Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	auto *Checker = new VFGChecker;
+	legacy::PassManager PM;
+	PM.add(Checker);
+	PM.run(*M);
+	setOption("nworkers", NumWorkers);
+	EXPECT_EQ(NumFunctions, Checker->NumNullTargets);
+	EXPECT_EQ(NumFunctions, Checker->NumLoadSources);
+}
+
+TEST(DyckVFGTest, HubNodesKeepValueFlows) {
+	initializeCore(*PassRegistry::getPassRegistry());
+	initializeAnalysis(*PassRegistry::getPassRegistry());
+
+	LLVMContext Ctx;
+	SMDiagnostic Err;
+	auto M = parseAssemblyString(HubModule, Err, Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	HubStatistics Stats[2];
+	bool UseHubs = setOption("dyckvfg-hub-nodes", false);
+	for (unsigned K = 0; K < 2; ++K) {
+		setOption("dyckvfg-hub-nodes", K == 1);
+		legacy::PassManager PM;
+		PM.add(new HubChecker(Stats[K]));
+		PM.run(*M);
+	}
+	setOption("dyckvfg-hub-nodes", UseHubs);
+	EXPECT_EQ(0u, Stats[0].NumHubs);
+	EXPECT_EQ(2u, Stats[1].NumHubs);
+	EXPECT_LT(Stats[1].NumEdges, Stats[0].NumEdges);
+	EXPECT_EQ(Stats[0].Edges, Stats[1].Edges);
+}
+
+TEST(DyckVFGTest, ContextSensitiveIndex) {
+	initializeCore(*PassRegistry::getPassRegistry());
+	initializeAnalysis(*PassRegistry::getPassRegistry());
+
+	LLVMContext Ctx;
+	SMDiagnostic Err;
+	auto M = parseAssemblyString(IdentityModule, Err, Ctx);
+	ASSERT_TRUE(M != nullptr);
+
+	std::map<std::pair<std::string, std::string>, bool> Results;
+	for (auto *From: {"p", "q", "x"})
+		for (auto *To: {"a", "b", "x"}) Results[{From, To}] = false;
+	legacy::PassManager PM;
+	PM.add(new IndexChecker(Results));
+	PM.run(*M);
+
+	EXPECT_TRUE((Results[{"p", "a"}]));
+	EXPECT_FALSE((Results[{"p", "b"}]));
+	EXPECT_FALSE((Results[{"q", "a"}]));
+	EXPECT_TRUE((Results[{"q", "b"}]));
+	// unmatched calls at the end and unmatched returns at the beginning
+	EXPECT_TRUE((Results[{"p", "x"}]));
+	EXPECT_TRUE((Results[{"x", "a"}]));
+	EXPECT_TRUE((Results[{"x", "b"}]));
+	EXPECT_TRUE((Results[{"x", "x"}]));
+}
+
+}
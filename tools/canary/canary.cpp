@@ -25,9 +25,11 @@
 #include <llvm/IRReader/IRReader.h>
 #include <llvm/InitializePasses.h>
 #include <llvm/Support/Debug.h>
+#include <llvm/Support/FileSystem.h>
 #include <llvm/Support/InitLLVM.h>
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Signals.h>
+#include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/ToolOutputFile.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Utils.h>
@@ -115,7 +117,7 @@ int main(int argc, char **argv) {
     std::unique_ptr<ToolOutputFile> Out;
     if (!OutputFilename.getValue().empty()) {
         std::error_code EC;
-        Out = std::make_unique<ToolOutputFile>(OutputFilename, EC, sys::fs::F_None);
+        Out = std::make_unique<ToolOutputFile>(OutputFilename, EC, sys::fs::OF_None);
         if (EC) {
             errs() << EC.message() << '\n';
             return 1;